@@ -0,0 +1,315 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "activity.h"
+#include "block.h"
+#include "cntrl.h"
+#include "config_file.h"
+#include "smp.h"
+#include "utils.h"
+
+#define DISKSTATS_PATH		"/proc/diskstats"
+
+/* see DISK_NAME_LEN of the kernel */
+#define DISK_NAME_SIZE		32
+
+/**
+ * @brief Slot driven by the activity engine.
+ */
+struct activity_slot {
+	char name[DISK_NAME_SIZE];
+	struct block_device *device;
+	/* sum of completed reads and writes and of time spent doing I/Os */
+	uint64_t count;
+	int sampled;
+	enum activity_state state;
+	int pending;
+};
+
+static struct activity_slot *slots;
+static int slots_len;
+static char *stats_buf;
+static size_t stats_size;
+static int stats_fd = -1;
+static uint64_t next_tick;
+static int throttled;
+
+static int _slot_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct activity_slot *)a)->name,
+		      ((const struct activity_slot *)b)->name);
+}
+
+static struct activity_slot *_find_slot(struct activity_slot *table, int len,
+					const char *name, size_t name_len)
+{
+	struct activity_slot key;
+
+	if (!table || name_len >= sizeof(key.name))
+		return NULL;
+	memcpy(key.name, name, name_len);
+	key.name[name_len] = '\0';
+	return bsearch(&key, table, len, sizeof(*table), _slot_cmp);
+}
+
+static int _supported(struct block_device *device)
+{
+	return device->cntrl && device->cntrl->cntrl_type == CNTRL_TYPE_SCSI &&
+	       device->host && device->host->ibpi_state_buffer &&
+	       dev_directly_attached(device->sysfs_path);
+}
+
+/**
+ * Gives Activity LED of the device which is no longer driven by the engine
+ * back to the hardware.
+ */
+static void _release(struct block_device *device)
+{
+	if (device->activity == ACTIVITY_HW)
+		return;
+	device->activity = ACTIVITY_HW;
+	if (_supported(device) && scsi_smp_set_activity(device) == 0)
+		block_flush_msg(device);
+}
+
+void activity_update(const struct list *block_list)
+{
+	struct activity_slot *table, *slot, *old;
+	struct block_device *device;
+	const char *name;
+	int len = 0;
+
+	if (!conf.activity_interval)
+		return;
+	list_for_each(block_list, device)
+		len++;
+	table = calloc(len ? len : 1, sizeof(*table));
+	if (!table)
+		return;
+	len = 0;
+	list_for_each(block_list, device) {
+		name = strrchr(device->sysfs_path, '/');
+		/* detached devices are not driven, see _send_msg() of ledmon */
+		if (!name++ || !_supported(device) ||
+		    strlen(name) >= DISK_NAME_SIZE ||
+		    device->timestamp != timestamp ||
+		    device->ibpi == IBPI_PATTERN_REMOVED) {
+			_release(device);
+			continue;
+		}
+		slot = &table[len++];
+		str_cpy(slot->name, name, sizeof(slot->name));
+		slot->device = device;
+		old = _find_slot(slots, slots_len, name, strlen(name));
+		if (old) {
+			slot->count = old->count;
+			slot->sampled = old->sampled;
+			slot->state = old->state;
+		}
+	}
+	qsort(table, len, sizeof(*table), _slot_cmp);
+	if (len != slots_len)
+		log_debug("activity: %d slots driven by software.", len);
+	free(slots);
+	slots = table;
+	slots_len = len;
+	if (!next_tick)
+		next_tick = get_monotonic_us();
+}
+
+uint64_t activity_next(void)
+{
+	return slots_len ? next_tick : 0;
+}
+
+/**
+ * Reads whole /proc/diskstats, usually with a single read() call.
+ */
+static int _read_stats(void)
+{
+	size_t len = 0;
+	ssize_t n;
+	char *buf;
+
+	if (stats_fd < 0) {
+		stats_fd = open(DISKSTATS_PATH, O_RDONLY | O_CLOEXEC);
+		if (stats_fd < 0)
+			return -1;
+	}
+	do {
+		if (len + 1 >= stats_size) {
+			buf = realloc(stats_buf, stats_size ? stats_size * 2 :
+				      BUFSIZ * 4);
+			if (!buf)
+				return -1;
+			stats_buf = buf;
+			stats_size = stats_size ? stats_size * 2 : BUFSIZ * 4;
+		}
+		n = pread(stats_fd, stats_buf + len, stats_size - len - 1, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return -1;
+		len += n;
+	} while (n > 0 && len + 1 >= stats_size);
+	stats_buf[len] = '\0';
+	return 0;
+}
+
+/**
+ * Computes state of slots from I/O counters. Each line of /proc/diskstats is
+ * "major minor name" followed by counters, see Documentation/iostats.txt.
+ */
+static void _sample(void)
+{
+	struct activity_slot *slot;
+	uint64_t v[11], count;
+	char *line, *p, *name;
+	int i;
+
+	for (line = stats_buf; *line; line = *p ? p + 1 : p) {
+		strtoul(line, &p, 10);
+		strtoul(p, &p, 10);
+		while (*p == ' ')
+			p++;
+		name = p;
+		while (*p && *p != ' ' && *p != '\n')
+			p++;
+		slot = _find_slot(slots, slots_len, name, p - name);
+		if (slot) {
+			for (i = 1; i < 11; i++)
+				v[i] = strtoull(p, &p, 10);
+			/* completed reads, completed writes, time doing I/Os */
+			count = v[1] + v[5] + v[10];
+			if (slot->sampled)
+				slot->state = count != slot->count ?
+					      ACTIVITY_ON : ACTIVITY_OFF;
+			slot->count = count;
+			slot->sampled = 1;
+		}
+		p = strchrnul(p, '\n');
+	}
+}
+
+/**
+ * Updates slots whose state has changed and sends buffer of each host once.
+ */
+static void _show(void)
+{
+	struct activity_slot *slot;
+	struct block_device *device;
+	int i, changed = 0;
+
+	for (i = 0; i < slots_len; i++) {
+		slot = &slots[i];
+		device = slot->device;
+		if (!slot->sampled || slot->state == device->activity)
+			continue;
+		device->activity = slot->state;
+		if (scsi_smp_set_activity(device) == 0) {
+			slot->pending = 1;
+			changed++;
+		} else {
+			/* sent again on the next tick */
+			device->activity = ACTIVITY_HW;
+		}
+	}
+	if (!changed)
+		return;
+	for (i = 0; i < slots_len; i++) {
+		slot = &slots[i];
+		if (!slot->pending)
+			continue;
+		slot->pending = 0;
+		if (block_flush_msg(slot->device)) {
+			log_debug("activity: unable to update %s.",
+				  slot->device->sysfs_path);
+			/* sent again on the next tick */
+			slot->device->activity = ACTIVITY_HW;
+		}
+	}
+}
+
+void activity_tick(void)
+{
+	struct timespec start, end;
+	uint64_t now = get_monotonic_us(), cost, delay;
+
+	if (!slots_len || now < next_tick)
+		return;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	if (_read_stats() == 0) {
+		_sample();
+		_show();
+	} else {
+		log_debug("activity: unable to read %s: %s", DISKSTATS_PATH,
+			  strerror(errno));
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	cost = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+	       (end.tv_nsec - start.tv_nsec) / 1000;
+
+	/* the engine never takes more than its budget of CPU time */
+	delay = (uint64_t)conf.activity_interval * 1000;
+	if (cost * 100 / conf.activity_cpu_budget > delay) {
+		delay = cost * 100 / conf.activity_cpu_budget;
+		if (!throttled)
+			log_info("activity: tick takes %" PRIu64 " us of CPU, interval extended to %" PRIu64 " ms.",
+				 cost, delay / 1000);
+		throttled = 1;
+	} else {
+		throttled = 0;
+	}
+	next_tick = now + delay;
+}
+
+void activity_fini(void)
+{
+	int i;
+
+	for (i = 0; i < slots_len; i++) {
+		slots[i].state = ACTIVITY_HW;
+		slots[i].sampled = 1;
+	}
+	_show();
+	free(slots);
+	slots = NULL;
+	slots_len = 0;
+	free(stats_buf);
+	stats_buf = NULL;
+	stats_size = 0;
+	if (stats_fd >= 0)
+		close(stats_fd);
+	stats_fd = -1;
+	next_tick = 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _ACTIVITY_H_INCLUDED_
+#define _ACTIVITY_H_INCLUDED_
+
+#include <stdint.h>
+
+#include "list.h"
+
+/*
+ * Activity engine drives Activity LEDs of slots whose hardware cannot do it,
+ * see ACTIVITY_INTERVAL in ledmon.conf(5). On each tick /proc/diskstats is
+ * read once for all devices and a slot is active if any I/O has completed or
+ * the device has been busy since the previous tick. Only slots whose state has
+ * changed are updated and the buffer of each controller host is sent once per
+ * tick. The tick is delayed whenever it has taken more CPU time than the
+ * configured budget allows.
+ *
+ * Only slots of directly attached SAS and SATA drives controlled over SMP
+ * are supported.
+ */
+
+/**
+ * @brief Sets slots driven by the engine.
+ *
+ * The function is called after each scan, the devices have to stay valid
+ * until the next call. Counters of devices seen in the previous call are
+ * kept. The function does nothing if the engine is disabled.
+ *
+ * @param[in]    block_list      - list of block devices of ledmon.
+ *
+ * @return The function does not return a value.
+ */
+void activity_update(const struct list *block_list);
+
+/**
+ * @brief Gets time of the next tick.
+ *
+ * @return Time in microseconds of monotonic clock or 0 if the engine is
+ *         disabled or has no slots.
+ */
+uint64_t activity_next(void);
+
+/**
+ * @brief Updates Activity LEDs if the tick is due.
+ *
+ * @return The function does not return a value.
+ */
+void activity_tick(void);
+
+/**
+ * @brief Returns Activity LEDs to the hardware and stops the engine.
+ *
+ * @return The function does not return a value.
+ */
+void activity_fini(void);
+
+#endif				/* _ACTIVITY_H_INCLUDED_ */
@@ -31,13 +31,16 @@
 
 #include "ahci.h"
 #include "config.h"
+#include "plan.h"
+#include "probes.h"
 #include "utils.h"
+#include "xfer.h"
 
 /**
- * Time interval in nano seconds to wait before enclosure management message
- * is being sent to AHCI controller.
+ * Time interval in micro seconds between enclosure management messages sent
+ * to AHCI controller.
  */
-#define EM_MSG_WAIT       1500000	/* 0.0015 seconds */
+#define EM_MSG_WAIT       1500	/* 0.0015 seconds */
 
 /**
  * This array maps IBPI pattern to value recognized by AHCI driver. The driver
@@ -64,6 +67,51 @@ static const unsigned int ibpi2sgpio[] = {
 #endif
 };
 
+/**
+ * Gets the control number of the pattern with indications shown together,
+ * locate and failure are separate LEDs.
+ */
+static unsigned int _get_sgpio(enum ibpi_pattern ibpi, unsigned int mask)
+{
+	unsigned int value = ibpi2sgpio[ibpi];
+	enum ibpi_pattern i;
+
+	for (i = IBPI_PATTERN_NORMAL; i <= IBPI_PATTERN_LOCATE_OFF; i++) {
+		if (mask & IBPI_MASK(i))
+			value |= ibpi2sgpio[i];
+	}
+	return value;
+}
+
+/**
+ * Gets locate and failure LEDs of the port set by another process, e.g. by
+ * ledctl while ledmon is running. They are kept unless this process has
+ * turned them on itself or locate_off is requested. The first message sent
+ * by this process sets the LEDs as requested.
+ */
+static unsigned int _get_other_leds(struct block_device *device,
+				    const char *path, enum ibpi_pattern ibpi)
+{
+	unsigned int keep = ibpi2sgpio[IBPI_PATTERN_LOCATE] |
+			    ibpi2sgpio[IBPI_PATTERN_FAILED_DRIVE];
+	unsigned int own, value;
+	char *text;
+
+	if (device->ibpi_prev < IBPI_PATTERN_NORMAL ||
+	    device->ibpi_prev > IBPI_PATTERN_LOCATE_OFF)
+		return 0;
+	text = get_text(path, "em_message");
+	if (!text)
+		return 0;
+	value = strtoul(text, NULL, 16);
+	free(text);
+
+	own = _get_sgpio(device->ibpi_prev, device->ibpi_mask_prev);
+	if (ibpi == IBPI_PATTERN_LOCATE_OFF)
+		keep &= ~ibpi2sgpio[IBPI_PATTERN_LOCATE];
+	return value & ~own & keep;
+}
+
 /*
  * The function sends a LED control message to AHCI controller. It uses
  * SGPIO to control the LEDs. See ahci.h for details.
@@ -73,26 +121,68 @@ int ahci_sgpio_write(struct block_device *device, enum ibpi_pattern ibpi)
 	char temp[WRITE_BUFFER_SIZE];
 	char path[PATH_MAX];
 	char *sysfs_path = device->cntrl_path;
-	const struct timespec waittime = {
-		.tv_sec = 0,
-		.tv_nsec = EM_MSG_WAIT
-	};
+	const char *gate;
+	uint64_t busy_until, start;
+	ssize_t status;
 
 	/* write only if state has changed */
-	if (ibpi == device->ibpi_prev)
-		return 1;
+	if (!block_state_changed(device, ibpi)) {
+		xfer_done(device);
+		return 0;
+	}
 
 	if (sysfs_path == NULL)
 		__set_errno_and_return(EINVAL);
 	if ((ibpi < IBPI_PATTERN_NORMAL) || (ibpi > IBPI_PATTERN_LOCATE_OFF))
 		__set_errno_and_return(ERANGE);
 
-	sprintf(temp, "%u", ibpi2sgpio[ibpi]);
+	sprintf(temp, "%u", _get_sgpio(ibpi, block_indications(device, ibpi)) |
+			    _get_other_leds(device, sysfs_path, ibpi));
 
 	snprintf(path, sizeof(path), "%s/em_message", sysfs_path);
 
-	nanosleep(&waittime, NULL);
-	return buf_write(path, temp) > 0;
+	/* wait until the controller has processed the previous message */
+	gate = device->cntrl ? device->cntrl->sysfs_path : sysfs_path;
+	if (!xfer_gate_acquire(gate, device->sysfs_path, 0, NULL,
+			       &busy_until)) {
+		xfer_wait(device, 1, busy_until);
+		return 0;
+	}
+
+	if (plan_xfer("em_message", path, strlen(temp), 1)) {
+		status = strlen(temp);
+	} else {
+		start = get_monotonic_us();
+		PROBE2(xfer_start, "em_message", path);
+		status = buf_write(path, temp);
+		PROBE3(xfer_end, "em_message", path, status);
+		plan_stat("em_message", start);
+	}
+	xfer_gate_release(gate, EM_MSG_WAIT);
+	xfer_done(device);
+	if (status <= 0)
+		return -1;
+	return 0;
+}
+
+int ahci_sgpio_get_leds(struct block_device *device)
+{
+	unsigned int value;
+	char *text;
+	int leds = 0;
+
+	if (!device->cntrl_path)
+		return -1;
+	text = get_text(device->cntrl_path, "em_message");
+	if (!text)
+		return -1;
+	value = strtoul(text, NULL, 16);
+	free(text);
+	if (value & ibpi2sgpio[IBPI_PATTERN_LOCATE])
+		leds |= IBPI_MASK(IBPI_PATTERN_LOCATE);
+	if (value & ibpi2sgpio[IBPI_PATTERN_FAILED_DRIVE])
+		leds |= IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE);
+	return leds;
 }
 
 #define SCSI_HOST "/scsi_host"
@@ -46,9 +46,19 @@ char *ahci_get_port_path(const char *path);
  * @param[in]      ibpi           IBPI pattern to visualize on LEDs associated
  *                                with the given slot.
  *
- * @return Number of bytes send to controller, -1 means error occurred and
+ * @return 0 if successful, -1 means error occurred and
  *         errno has additional error information.
  */
 int ahci_sgpio_write(struct block_device *path, enum ibpi_pattern ibpi);
 
+/**
+ * @brief Gets Locate and Failure LEDs of the port from em_message.
+ *
+ * @param[in]      device         Block device connected to the port.
+ *
+ * @return IBPI_MASK() of the patterns whose LEDs are on, or -1 if the LEDs
+ *         cannot be read.
+ */
+int ahci_sgpio_get_leds(struct block_device *device);
+
 #endif				/* _AHCI_H_INCLUDED_ */
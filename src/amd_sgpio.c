@@ -39,7 +39,10 @@
 #include "config.h"
 #include "ibpi.h"
 #include "list.h"
+#include "plan.h"
+#include "probes.h"
 #include "utils.h"
+#include "xfer.h"
 #include "amd_sgpio.h"
 
 #define REG_FMT_2	"%23s: %-4x%23s: %-4x\n"
@@ -47,6 +50,19 @@
 
 #define HOST_CAP_EMS	(1 << 6)
 
+/**
+ * Time in microseconds the hardware needs to see the register change and
+ * read it. Without the wait multiple writes can result in an EBUSY return
+ * because hardware has not cleared the EM_CTL_TM (Transmit Message) bit.
+ */
+#define SGPIO_REG_WAIT	1000
+
+/**
+ * The SGPIO cache is shared by all controllers so a single transaction is
+ * in flight at a time.
+ */
+#define SGPIO_GATE	"amd_sgpio"
+
 #define DECLARE_SGPIO(type, name, shift, mask)				\
 	uint32_t	_##type##_##name##_shift = shift;		\
 	uint64_t	_##type##_##name##_mask = mask << shift;	\
@@ -295,6 +311,10 @@ static int _send_sgpio_register(const char *em_buffer_path, void *reg,
 	int count;
 	int saved_errno;
 	int retries = 3;
+	uint64_t start;
+
+	if (plan_xfer("amd_sgpio", em_buffer_path, reg_len, 1))
+		return 0;
 
 	do {
 		int fd = open(em_buffer_path, O_WRONLY);
@@ -305,20 +325,17 @@ static int _send_sgpio_register(const char *em_buffer_path, void *reg,
 			return -1;
 		}
 
+		start = get_monotonic_us();
+		PROBE2(xfer_start, "amd_sgpio", em_buffer_path);
 		count = write(fd, reg, reg_len);
 		saved_errno = errno;
 		close(fd);
-
-		/* Insert small sleep to ensure hardware has enough time to
-		 * see the register change and read it. Without the sleep
-		 * multiple writes can result in an EBUSY return because
-		 * hardware has not cleared the EM_CTL_TM (Transmit Message)
-		 * bit.
-		 */
-		usleep(1000);
+		PROBE3(xfer_end, "amd_sgpio", em_buffer_path, count);
+		plan_stat("amd_sgpio", start);
 
 		if (count == reg_len || saved_errno != EBUSY)
 			break;
+		usleep(SGPIO_REG_WAIT);
 	} while (--retries != 0);
 
 	if (count != reg_len) {
@@ -433,6 +450,8 @@ static void _dump_cfg_register(struct config_register *cfg_reg)
 	log_info("CFG Register: %08x %08x %08x %08x %08x",
 		 reg[0], reg[1], reg[2], reg[3], reg[4]);
 
+	if (!log_enabled(LOG_LEVEL_DEBUG))
+		return;
 	_dump_sgpio_hdr(&cfg_reg->hdr);
 	_dump_sgpio_req(&cfg_reg->req);
 	_dump_sgpio_cfg(&cfg_reg->cfg);
@@ -454,7 +473,8 @@ static int _write_cfg_register(const char *em_buffer_path,
 	_init_sgpio_cfg(&cfg_reg.cfg, 1, cache->blink_gen_a, cache->blink_gen_b,
 			2, 1, 0, 0);
 
-	_dump_cfg_register(&cfg_reg);
+	if (log_enabled(LOG_LEVEL_INFO))
+		_dump_cfg_register(&cfg_reg);
 	return _send_sgpio_register(em_buffer_path, &cfg_reg, sizeof(cfg_reg));
 }
 
@@ -478,6 +498,8 @@ static void _dump_tx_register(struct transmit_register *tx_reg)
 	log_info("TX Register:  %08x %08x %08x %08x", reg[0], reg[1],
 		 reg[2], reg[3]);
 
+	if (!log_enabled(LOG_LEVEL_DEBUG))
+		return;
 	_dump_sgpio_hdr(&tx_reg->hdr);
 	_dump_sgpio_req(&tx_reg->req);
 	_dump_sgpio_tx(&tx_reg->tx);
@@ -489,7 +511,8 @@ static int _write_tx_register(const char *em_buffer_path,
 	_init_sgpio_hdr(&tx_reg->hdr, 0, sizeof(*tx_reg));
 	_init_sgpio_req(&tx_reg->req, 0x40, 0x82, SGPIO_REQ_REG_TYPE_TX, 0, 1);
 
-	_dump_tx_register(tx_reg);
+	if (log_enabled(LOG_LEVEL_INFO))
+		_dump_tx_register(tx_reg);
 	return _send_sgpio_register(em_buffer_path, tx_reg, sizeof(*tx_reg));
 }
 
@@ -545,6 +568,8 @@ static void _dump_amd_register(struct amd_register *amd_reg)
 	log_info("AMD Register: %08x %08x %08x %08x", reg[0], reg[1],
 		 reg[2], reg[3]);
 
+	if (!log_enabled(LOG_LEVEL_DEBUG))
+		return;
 	_dump_sgpio_hdr(&amd_reg->hdr);
 	_dump_sgpio_req(&amd_reg->req);
 	_dump_sgpio_amd(&amd_reg->amd);
@@ -559,7 +584,8 @@ static int _write_amd_register(const char *em_buffer_path,
 	_init_sgpio_req(&amd_reg.req, 0x40, 0x82, SGPIO_REQ_REG_TYPE_AMD, 0, 1);
 	_init_sgpio_amd(&amd_reg.amd, drive->initiator, 0, 1, 1);
 
-	_dump_amd_register(&amd_reg);
+	if (log_enabled(LOG_LEVEL_INFO))
+		_dump_amd_register(&amd_reg);
 	return _send_sgpio_register(em_buffer_path, &amd_reg, sizeof(amd_reg));
 }
 
@@ -660,13 +686,31 @@ static int _get_amd_drive(const char *start_path, struct amd_drive *drive)
 	return 0;
 }
 
-static int _set_ibpi(struct block_device *device, enum ibpi_pattern ibpi)
-{
-	int rc;
+/**
+ * Steps of the transaction setting IBPI pattern of a drive.
+ */
+enum sgpio_step {
+	SGPIO_STEP_AMD = 0,
+	SGPIO_STEP_CFG,
+	SGPIO_STEP_TX,
+};
+
+/**
+ * Context of the transaction in flight. The SGPIO cache stays locked until
+ * the transaction is complete.
+ */
+struct sgpio_xfer {
+	int started;
+	enum ibpi_pattern ibpi;
 	struct amd_drive drive;
-	struct transmit_register tx_reg;
-	struct cache_entry *cache;
 	struct cache_entry cache_dup;
+};
+
+static int _start_ibpi(struct block_device *device, struct sgpio_xfer *xfer,
+		       enum ibpi_pattern ibpi)
+{
+	struct cache_entry *cache;
+	int rc;
 
 	log_info("\n");
 	log_info("Setting %s...", ibpi2str(ibpi));
@@ -681,36 +725,108 @@ static int _set_ibpi(struct block_device *device, enum ibpi_pattern ibpi)
 	 * we can calculate the correct bits to set in the register for
 	 * that drive.
 	 */
-	rc = _get_amd_drive(device->sysfs_path, &drive);
+	rc = _get_amd_drive(device->sysfs_path, &xfer->drive);
 	if (rc)
 		return rc;
 
-	cache = _get_cache(&drive);
+	cache = _get_cache(&xfer->drive);
 	if (!cache)
 		return -EINVAL;
 
 	/* Save copy of cache entry */
-	memcpy(&cache_dup, cache, sizeof(cache_dup));
+	memcpy(&xfer->cache_dup, cache, sizeof(xfer->cache_dup));
+	xfer->ibpi = ibpi;
+	xfer->started = 1;
 
-	rc = _write_amd_register(device->cntrl_path, &drive);
-	if (rc)
-		goto _set_ibpi_error;
+	return _write_amd_register(device->cntrl_path, &xfer->drive);
+}
 
-	rc = _write_cfg_register(device->cntrl_path, cache, ibpi);
-	if (rc)
-		goto _set_ibpi_error;
+/**
+ * Rolls back the cache entry of a transaction which has been abandoned and
+ * releases the cache lock taken when the transaction has started.
+ */
+static void _abandon_ibpi(void *ctx)
+{
+	struct sgpio_xfer *xfer = ctx;
+	struct cache_entry *cache;
 
-	memset(&tx_reg, 0, sizeof(tx_reg));
-	_set_tx_drive_leds(&tx_reg, cache, drive.drive_bay, ibpi);
-	rc = _write_tx_register(device->cntrl_path, &tx_reg);
+	if (!xfer->started)
+		return;
+	cache = _get_cache(&xfer->drive);
+	if (cache)
+		memcpy(cache, &xfer->cache_dup, sizeof(*cache));
+	_put_cache();
+}
 
-_set_ibpi_error:
-	if (rc) {
-		/* Restore saved cache entry */
-		memcpy(cache, &cache_dup, sizeof(*cache));
+static int _set_ibpi(struct block_device *device, enum ibpi_pattern ibpi)
+{
+	int rc;
+	struct sgpio_xfer *xfer;
+	struct transmit_register tx_reg;
+	struct cache_entry *cache;
+	uint64_t busy_until;
+
+	xfer = xfer_gate_acquire(SGPIO_GATE, device->sysfs_path, sizeof(*xfer),
+				 _abandon_ibpi, &busy_until);
+	if (!xfer) {
+		xfer_wait(device, SGPIO_STEP_AMD, busy_until);
+		return 0;
 	}
 
-	_put_cache();
+	/* The transaction has been taken over, start from the beginning. */
+	if (!xfer->started)
+		device->xfer_step = SGPIO_STEP_AMD;
+
+	switch (device->xfer_step) {
+	case SGPIO_STEP_CFG:
+		cache = _get_cache(&xfer->drive);
+		if (!cache) {
+			rc = -EINVAL;
+			break;
+		}
+		rc = _write_cfg_register(device->cntrl_path, cache, xfer->ibpi);
+		if (rc == 0) {
+			xfer_wait(device, SGPIO_STEP_TX,
+				  get_monotonic_us() + SGPIO_REG_WAIT);
+			return 0;
+		}
+		break;
+	case SGPIO_STEP_TX:
+		cache = _get_cache(&xfer->drive);
+		if (!cache) {
+			rc = -EINVAL;
+			break;
+		}
+		memset(&tx_reg, 0, sizeof(tx_reg));
+		_set_tx_drive_leds(&tx_reg, cache, xfer->drive.drive_bay,
+				   xfer->ibpi);
+		rc = _write_tx_register(device->cntrl_path, &tx_reg);
+		break;
+	default:
+		rc = _start_ibpi(device, xfer, ibpi);
+		if (rc == 0) {
+			xfer_wait(device, SGPIO_STEP_CFG,
+				  get_monotonic_us() + SGPIO_REG_WAIT);
+			return 0;
+		}
+		break;
+	}
+
+	if ((rc || plan_active()) && xfer->started) {
+		/* Restore saved cache entry, nothing is written in plan mode */
+		cache = _get_cache(&xfer->drive);
+		if (cache)
+			memcpy(cache, &xfer->cache_dup, sizeof(*cache));
+	}
+
+	if (xfer->started)
+		_put_cache();
+	xfer_gate_release(SGPIO_GATE, SGPIO_REG_WAIT);
+	xfer_done(device);
+
+	/* The pattern has changed while the transaction was in flight. */
+	if (rc == 0 && xfer->ibpi != ibpi)
+		return _set_ibpi(device, ibpi);
 	return rc;
 }
 
@@ -728,15 +844,20 @@ static int _amd_sgpio_init_one(const char *path, struct amd_drive *drive,
 		  drive->ata_port + 3);
 	log_debug("\tbuffer: %s", strstr(path, "/ata"));
 
+	/* Initialization is done once at discovery, so it is synchronous. */
 	rc = _write_amd_register(path, drive);
+	usleep(SGPIO_REG_WAIT);
 	if (rc)
 		return rc;
 
 	rc = _write_cfg_register(path, cache, IBPI_PATTERN_NONE);
+	usleep(SGPIO_REG_WAIT);
 	if (rc)
 		return rc;
 
-	return _write_tx_register(path, &tx_reg);
+	rc = _write_tx_register(path, &tx_reg);
+	usleep(SGPIO_REG_WAIT);
+	return rc;
 }
 
 static int _amd_sgpio_init(const char *path)
@@ -765,15 +886,15 @@ static int _amd_sgpio_init(const char *path)
 	memcpy(&cache_dup, cache, sizeof(cache_dup));
 
 	rc = _amd_sgpio_init_one(em_path, &drive, cache);
-	if (rc) {
+	if (rc)
 		log_error("SGPIO register init failed for bank %d, %s",
 			  drive.initiator, em_path);
 
-		/* Restore saved cache entry */
+	/* Restore saved cache entry, nothing has been written in plan mode */
+	if (rc || plan_active())
 		memcpy(cache, &cache_dup, sizeof(*cache));
-
+	if (rc)
 		goto _init_amd_sgpio_err;
-	}
 
 	_put_cache();
 
@@ -803,13 +924,13 @@ static int _amd_sgpio_init(const char *path)
 	memcpy(&cache_dup, cache, sizeof(cache_dup));
 
 	rc = _amd_sgpio_init_one(em_path, &drive, cache);
-	if (rc) {
+	if (rc)
 		log_error("SGPIO register init failed for bank %d, %s",
 			  drive.initiator, em_path);
 
-		/* Restore saved cache entry */
+	/* Restore saved cache entry, nothing has been written in plan mode */
+	if (rc || plan_active())
 		memcpy(cache, &cache_dup, sizeof(*cache));
-	}
 
 _init_amd_sgpio_err:
 	_put_cache();
@@ -882,9 +1003,9 @@ int amd_sgpio_em_enabled(const char *path)
 
 int amd_sgpio_write(struct block_device *device, enum ibpi_pattern ibpi)
 {
-	/* write only if state has changed */
-	if (ibpi == device->ibpi_prev)
-		return 1;
+	/* write only if state has changed or transaction is in flight */
+	if (!block_state_changed(device, ibpi) && !xfer_pending(device))
+		return 0;
 
 	if ((ibpi < IBPI_PATTERN_NORMAL) || (ibpi > IBPI_PATTERN_LOCATE_OFF))
 		__set_errno_and_return(ERANGE);
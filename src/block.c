@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #if _HAVE_DMALLOC_H
@@ -36,6 +37,7 @@
 #include "config.h"
 #include "dellssd.h"
 #include "pci_slot.h"
+#include "probes.h"
 #include "raid.h"
 #include "scsi.h"
 #include "slave.h"
@@ -44,6 +46,7 @@
 #include "sysfs.h"
 #include "utils.h"
 #include "vmdssd.h"
+#include "xfer.h"
 #include "amd_sgpio.h"
 
 /* Global timestamp value. It shell be used to update a timestamp field of block
@@ -102,7 +105,7 @@ static send_message_t _get_send_fn(struct cntrl_device *cntrl, const char *path)
 
 static int do_not_flush(struct block_device *device __attribute__ ((unused)))
 {
-	return 1;
+	return 0;
 }
 
 static flush_message_t _get_flush_fn(struct cntrl_device *cntrl, const char *path)
@@ -210,17 +213,17 @@ struct block_device *block_device_init(const struct list *cntrl_list, const char
 	char link[PATH_MAX];
 	char *host = NULL;
 	struct block_device *device = NULL;
-	struct pci_slot *pci_slot = NULL;
 	send_message_t send_fn = NULL;
 	flush_message_t flush_fn = NULL;
 	int host_id = -1;
 	char *host_name;
 
 	if (realpath(path, link)) {
-		pci_slot = vmdssd_find_pci_slot(link);
 		cntrl = block_get_controller(cntrl_list, link);
 		if (cntrl != NULL) {
-			if (cntrl->cntrl_type == CNTRL_TYPE_VMD && !pci_slot)
+			/* only drives behind VMD need a PCI hot-plug slot */
+			if (cntrl->cntrl_type == CNTRL_TYPE_VMD &&
+			    !vmdssd_find_pci_slot(link))
 				return NULL;
 			host = _get_host(link, cntrl);
 			if (host == NULL)
@@ -319,6 +322,13 @@ struct block_device *block_device_duplicate(struct block_device *block)
 			else
 				result->ibpi = IBPI_PATTERN_ONESHOT_NORMAL;
 			result->ibpi_prev = block->ibpi_prev;
+			result->ibpi_mask = block->ibpi_mask;
+			result->ibpi_mask_prev = block->ibpi_mask_prev;
+			result->send_attempts = block->send_attempts;
+			result->retry_time = block->retry_time;
+			result->xfer_step = block->xfer_step;
+			result->xfer_time = block->xfer_time;
+			result->activity = block->activity;
 			result->send_fn = block->send_fn;
 			result->flush_fn = block->flush_fn;
 			result->timestamp = block->timestamp;
@@ -335,6 +345,33 @@ struct block_device *block_device_duplicate(struct block_device *block)
 	return result;
 }
 
+/*
+ * Restores a block device structure. See block.h for details.
+ */
+struct block_device *block_device_restore(struct cntrl_device *cntrl,
+					  const char *path,
+					  const char *cntrl_path)
+{
+	struct block_device *device;
+	send_message_t send_fn;
+
+	send_fn = _get_send_fn(cntrl, path);
+	if (send_fn == NULL)
+		return NULL;
+	device = calloc(1, sizeof(*device));
+	if (device) {
+		device->sysfs_path = str_dup(path);
+		device->cntrl_path = str_dup(cntrl_path);
+		device->ibpi = IBPI_PATTERN_UNKNOWN;
+		device->ibpi_prev = IBPI_PATTERN_NONE;
+		device->send_fn = send_fn;
+		device->flush_fn = _get_flush_fn(cntrl, path);
+		device->host_id = -1;
+		device->encl_index = -1;
+	}
+	return device;
+}
+
 int block_compare(const struct block_device *bd_old,
 		  const struct block_device *bd_new)
 {
@@ -364,9 +401,13 @@ int block_compare(const struct block_device *bd_old,
 		/* Host and phy is not enough. They might be DA or EA. */
 		if (dev_directly_attached(bd_old->sysfs_path) &&
 		    dev_directly_attached(bd_new->sysfs_path)) {
-			/* Just compare host & phy */
-			i = (bd_old->host_id == bd_new->host_id) &&
-			    (bd_old->phy_index == bd_new->phy_index);
+			/* Just compare host & phy, path if phy is unknown */
+			if (bd_old->phy_index < 0 || bd_new->phy_index < 0)
+				i = !strcmp(bd_old->sysfs_path,
+					    bd_new->sysfs_path);
+			else
+				i = (bd_old->host_id == bd_new->host_id) &&
+				    (bd_old->phy_index == bd_new->phy_index);
 			break;
 		}
 		if (!dev_directly_attached(bd_old->sysfs_path) &&
@@ -402,3 +443,110 @@ int block_compare(const struct block_device *bd_old,
 	}
 	return i;
 }
+
+static enum cntrl_type _get_cntrl_type(struct block_device *device)
+{
+	return device->cntrl ? device->cntrl->cntrl_type : CNTRL_TYPE_UNKNOWN;
+}
+
+/* SES codes do not fit into the mask and they are never indications */
+static unsigned int _ibpi_mask(enum ibpi_pattern ibpi)
+{
+	return ibpi <= IBPI_PATTERN_REMOVED ? IBPI_MASK(ibpi) : 0;
+}
+
+void block_add_indication(struct block_device *device, enum ibpi_pattern ibpi)
+{
+	device->ibpi_mask |= _ibpi_mask(ibpi) & IBPI_INDICATIONS;
+	if (device->ibpi < ibpi)
+		device->ibpi = ibpi;
+}
+
+unsigned int block_indications(const struct block_device *device,
+			       enum ibpi_pattern ibpi)
+{
+	if (ibpi != device->ibpi)
+		return 0;
+	return device->ibpi_mask & IBPI_INDICATIONS & ~_ibpi_mask(ibpi);
+}
+
+int block_state_changed(const struct block_device *device,
+			enum ibpi_pattern ibpi)
+{
+	return ibpi != device->ibpi_prev ||
+	       block_indications(device, ibpi) != device->ibpi_mask_prev;
+}
+
+int block_send_msg(struct block_device *device, enum ibpi_pattern ibpi)
+{
+	int status;
+
+	PROBE3(send_start, _get_cntrl_type(device), device->sysfs_path, ibpi);
+	status = device->send_fn(device, ibpi);
+	PROBE3(send_end, _get_cntrl_type(device), device->sysfs_path, status);
+	return status;
+}
+
+/**
+ * @brief Sleeps until the pending step of the device is due.
+ */
+static void _xfer_sleep(struct block_device *device)
+{
+	struct timespec ts;
+	uint64_t now = get_monotonic_us();
+
+	if (device->xfer_time > now) {
+		ts.tv_sec = (device->xfer_time - now) / 1000000;
+		ts.tv_nsec = ((device->xfer_time - now) % 1000000) * 1000;
+		nanosleep(&ts, NULL);
+	}
+}
+
+int block_send_msg_sync(struct block_device *device, enum ibpi_pattern ibpi)
+{
+	int status;
+
+	status = block_send_msg(device, ibpi);
+	while (status == 0 && xfer_pending(device)) {
+		_xfer_sleep(device);
+		status = block_send_msg(device, ibpi);
+	}
+	if (status)
+		xfer_done(device);
+	return status;
+}
+
+int block_flush_msg(struct block_device *device)
+{
+	int status;
+
+	PROBE2(flush_start, _get_cntrl_type(device), device->sysfs_path);
+	status = device->flush_fn(device);
+	PROBE3(flush_end, _get_cntrl_type(device), device->sysfs_path, status);
+	return status;
+}
+
+int block_flush_msg_sync(struct block_device *device)
+{
+	int status;
+
+	status = block_flush_msg(device);
+	while (status == 0 && xfer_flushing(device)) {
+		_xfer_sleep(device);
+		status = block_flush_msg(device);
+	}
+	if (status)
+		xfer_done(device);
+	return status;
+}
+
+int block_get_leds(struct block_device *device)
+{
+	if (device->send_fn == ahci_sgpio_write)
+		return ahci_sgpio_get_leds(device);
+	if (device->send_fn == scsi_ses_write)
+		return scsi_ses_get_leds(device);
+	if (device->send_fn == scsi_smp_fill_buffer)
+		return scsi_smp_get_leds(device);
+	return -1;
+}
@@ -22,6 +22,7 @@
 
 #include "cntrl.h"
 #include "ibpi.h"
+#include "stdint.h"
 #include "time.h"
 #include "list.h"
 #include "raid.h"
@@ -38,7 +39,8 @@ struct block_device;
  *                                @see block_device::cntrl_path.
  * @param[in]    ibpi             an IBPI pattern (state) to visualize.
  *
- * @return 1 if successful, otherwise the function returns 0.
+ * @return 0 if successful (or there was nothing to send), otherwise the
+ *         function returns a non-zero value.
  */
 typedef int (*send_message_t) (struct block_device *device,
 			       enum ibpi_pattern ibpi);
@@ -48,10 +50,23 @@ typedef int (*send_message_t) (struct block_device *device,
  *
  * @param[in]    device           pointer to a block device
  *
- * @return 1 if successful, otherwise the function returns 0.
+ * @return 0 if successful (or there was nothing to flush), otherwise the
+ *         function returns a non-zero value.
  */
 typedef int (*flush_message_t) (struct block_device *device);
 
+/**
+ * @brief State of Activity LED of a slot.
+ *
+ * The LED is driven by the hardware unless the activity engine of ledmon
+ * drives it, see activity.h.
+ */
+enum activity_state {
+	ACTIVITY_HW = 0,
+	ACTIVITY_OFF,
+	ACTIVITY_ON,
+};
+
 /**
  * @brief Describes a block device.
  *
@@ -95,10 +110,57 @@ struct block_device {
 	enum ibpi_pattern ibpi;
 
 /**
- * The previous state of block device.
+ * The previous state of block device. This is the last IBPI pattern which has
+ * been successfully sent to and flushed by the controller.
  */
 	enum ibpi_pattern ibpi_prev;
 
+/**
+ * The indications of the device and the indications last applied together
+ * with the previous IBPI pattern, see block_indications(). Bits are
+ * IBPI_MASK() of patterns within IBPI_INDICATIONS, see ibpi.h.
+ */
+	unsigned int ibpi_mask;
+	unsigned int ibpi_mask_prev;
+
+/**
+ * Set if the enclosure slot of the device reports the drive is not installed
+ * or broken. The device stays failed until the slot reports the drive again.
+ */
+	int slot_failed;
+
+/**
+ * The number of consecutive failed attempts to visualize the current IBPI
+ * pattern. It is cleared as soon as the pattern is successfully applied.
+ */
+	int send_attempts;
+
+/**
+ * The time (in milliseconds of monotonic clock) of the next attempt to
+ * visualize the current IBPI pattern or 0 if there is no pending retry.
+ */
+	uint64_t retry_time;
+
+/**
+ * The time (in milliseconds of monotonic clock) the buffered message of the
+ * device is flushed at or 0 if flushing is not deferred, see cadence.h.
+ */
+	uint64_t flush_time;
+
+/**
+ * The backend specific step of multi-step hardware transaction to continue
+ * with and the time (in microseconds of monotonic clock) it may continue.
+ * The time is 0 if there is no transaction in progress, see xfer.h.
+ */
+	int xfer_step;
+	uint64_t xfer_time;
+
+/**
+ * The state of Activity LED shown by the slot. It is ACTIVITY_HW unless the
+ * activity engine drives the LED.
+ */
+	enum activity_state activity;
+
 /**
  * The time stamp used to determine if the given block device still exist or
  * it failed and the device is no longer available. Every time IBPI pattern
@@ -117,7 +179,8 @@ struct block_device {
 
 /**
  * The index of phy utilized by directly attached to controller block device.
- * It is meaningful if device is controlled by isci driver.
+ * It is meaningful if device is controlled by isci driver. It is -1 if
+ * the port of the device is not found in the port to phy map.
  */
 	int phy_index;
 
@@ -178,6 +241,26 @@ void block_device_fini(struct block_device *device);
  */
 struct block_device *block_device_duplicate(struct block_device *device);
 
+/**
+ * @brief Restores a block device saved by previous run of ledmon.
+ *
+ * The function allocates a block device structure for a device which may not
+ * exist anymore. The controller is used to select the backend only, the device
+ * is attached to its controller, host and enclosure when it is revalidated.
+ * The time-stamp is cleared, so the device is detached unless it is found by
+ * the scan.
+ *
+ * @param[in]      cntrl          controller the device has been attached to.
+ * @param[in]      path           saved path to block device in sysfs tree.
+ * @param[in]      cntrl_path     saved canonical path to the slot.
+ *
+ * @return Pointer to block device structure if successful, otherwise the function
+ *         returns the NULL pointer.
+ */
+struct block_device *block_device_restore(struct cntrl_device *cntrl,
+					  const char *path,
+					  const char *cntrl_path);
+
 /**
  * @brief Determines a storage controller.
  *
@@ -227,4 +310,108 @@ struct _host_type *block_get_host(struct cntrl_device *cntrl, int host_id);
 int block_compare(const struct block_device *bd_old,
 		  const struct block_device *bd_new);
 
+/**
+ * @brief Adds an indication to the block device.
+ *
+ * The pattern of the highest priority becomes the IBPI pattern of the device.
+ * Patterns within IBPI_INDICATIONS are kept in the indication mask as well,
+ * so they are shown together if the controller supports it.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ * @param[in]    ibpi            - IBPI pattern to add.
+ *
+ * @return The function does not return a value.
+ */
+void block_add_indication(struct block_device *device, enum ibpi_pattern ibpi);
+
+/**
+ * @brief Gets indications to show together with the pattern.
+ *
+ * Indications are shown only with the IBPI pattern of the device, other
+ * patterns sent to the device, e.g. locate_off by ledctl, are shown alone.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ * @param[in]    ibpi            - IBPI pattern being sent.
+ *
+ * @return Mask of indications other than the pattern itself.
+ */
+unsigned int block_indications(const struct block_device *device,
+			       enum ibpi_pattern ibpi);
+
+/**
+ * @brief Checks if the pattern differs from the state last applied.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ * @param[in]    ibpi            - IBPI pattern being sent.
+ *
+ * @return 1 if the pattern or its indications have changed, otherwise 0.
+ */
+int block_state_changed(const struct block_device *device,
+			enum ibpi_pattern ibpi);
+
+/**
+ * @brief Sends LED control message.
+ *
+ * The function invokes send function of the block device. Invocations are
+ * traced with send_start and send_end probes.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ * @param[in]    ibpi            - IBPI pattern to visualize.
+ *
+ * @return Value returned by send function of the block device.
+ */
+int block_send_msg(struct block_device *device, enum ibpi_pattern ibpi);
+
+/**
+ * @brief Sends LED control message and waits for the transaction to complete.
+ *
+ * The function repeats block_send_msg() until no step of the transaction is
+ * pending, see xfer.h. It is meant for one-shot tools like ledctl.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ * @param[in]    ibpi            - IBPI pattern to visualize.
+ *
+ * @return Value returned by the last invocation of send function.
+ */
+int block_send_msg_sync(struct block_device *device, enum ibpi_pattern ibpi);
+
+/**
+ * @brief Flushes LED control messages.
+ *
+ * The function invokes flush function of the block device. Invocations are
+ * traced with flush_start and flush_end probes.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ *
+ * @return Value returned by flush function of the block device.
+ */
+int block_flush_msg(struct block_device *device);
+
+/**
+ * @brief Flushes LED control messages and waits for the transaction to
+ *        complete.
+ *
+ * The function repeats block_flush_msg() until no step of the flush is
+ * pending, see xfer.h. It is meant for one-shot tools like ledctl.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ *
+ * @return Value returned by the last invocation of flush function.
+ */
+int block_flush_msg_sync(struct block_device *device);
+
+/**
+ * @brief Gets Locate and Failure LEDs of the slot as they are in hardware.
+ *
+ * Only LEDs which can be read back are reported: page 2 of SES enclosures,
+ * em_message of AHCI ports and GPIO TX registers of SAS controllers. It is
+ * meant for one-shot tools like ledctl.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ *
+ * @return IBPI_MASK() of IBPI_PATTERN_LOCATE and IBPI_PATTERN_FAILED_DRIVE
+ *         if the LED is on, or -1 if the LEDs cannot be read.
+ */
+int block_get_leds(struct block_device *device);
+
 #endif				/* _BLOCK_H_INCLUDED_ */
@@ -0,0 +1,197 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "cadence.h"
+#include "config_file.h"
+#include "list.h"
+#include "utils.h"
+
+/**
+ * @brief Refresh schedule of a single controller.
+ */
+struct cadence {
+	char *path;
+	enum cntrl_type type;
+	uint64_t next;
+	unsigned long cycle;
+	int due;
+};
+
+static struct list cadences;
+static int cadences_ready;
+static unsigned long cycle;
+static uint64_t now;
+
+static void _cadence_free(struct cadence *cadence)
+{
+	free(cadence->path);
+	free(cadence);
+}
+
+/**
+ * Gets value of the controller from list of controller:value entries. An entry
+ * matching the path takes precedence over an entry matching the type. The value
+ * is left unchanged if no entry matches.
+ */
+static void _lookup(const struct list *entries, const char *path,
+		    enum cntrl_type type, int min, int max, int *value)
+{
+	int by_type = 0;
+	size_t len;
+	char *entry;
+	char key[PATH_MAX];
+	int v;
+
+	list_for_each(entries, entry) {
+		if (str_entry(entry, &len, &v, min, max) ||
+		    len >= sizeof(key))
+			continue;
+		if (cntrl_type_lookup(entry, len) == type) {
+			if (!by_type)
+				*value = v;
+			by_type = 1;
+			continue;
+		}
+		str_cpy(key, entry, len + 1);
+		if (match_string(key, path)) {
+			*value = v;
+			return;
+		}
+	}
+}
+
+/**
+ * Gets refresh interval of the controller in milliseconds.
+ */
+static uint64_t _get_interval(const char *path, enum cntrl_type type)
+{
+	int seconds = conf.scan_interval;
+
+	_lookup(&conf.cntrls_interval, path, type, LEDMON_MIN_SLEEP_INTERVAL,
+		LEDMON_MAX_SLEEP_INTERVAL, &seconds);
+	return (uint64_t)seconds * 1000;
+}
+
+void cadence_begin(void)
+{
+	struct cadence *cadence;
+	struct node *node;
+
+	if (!cadences_ready) {
+		list_init(&cadences, (item_free_t)_cadence_free);
+		cadences_ready = 1;
+	}
+	/* forget controllers which have not been seen in the last cycle */
+	list_for_each_node(&cadences, node) {
+		cadence = node->item;
+		if (cadence->cycle != cycle)
+			list_delete(node);
+	}
+	cycle++;
+	now = get_monotonic_ms();
+}
+
+static struct cadence *_cadence_get(const char *path)
+{
+	struct cadence *cadence;
+
+	list_for_each(&cadences, cadence) {
+		if (strcmp(cadence->path, path) == 0)
+			return cadence;
+	}
+	return NULL;
+}
+
+int cadence_due(const char *path, enum cntrl_type type)
+{
+	struct cadence *cadence;
+
+	if (!cadences_ready)
+		return 1;
+	cadence = _cadence_get(path);
+	if (!cadence) {
+		cadence = calloc(1, sizeof(*cadence));
+		if (!cadence)
+			return 1;
+		cadence->path = str_dup(path);
+		cadence->type = type;
+		list_append(&cadences, cadence);
+	}
+	if (cadence->cycle != cycle) {
+		cadence->cycle = cycle;
+		cadence->due = cadence->next <= now;
+		if (cadence->due)
+			cadence->next = now + _get_interval(path, type);
+	}
+	return cadence->due;
+}
+
+void cadence_expire(const char *path)
+{
+	struct cadence *cadence;
+
+	if (!cadences_ready)
+		return;
+	cadence = _cadence_get(path);
+	if (cadence && !(cadence->cycle == cycle && cadence->due)) {
+		log_debug("Refreshing controller %s.", path);
+		cadence->cycle = cycle;
+		cadence->due = 1;
+		cadence->next = now + _get_interval(path, cadence->type);
+	}
+}
+
+uint64_t cadence_flush_delay(const char *path, enum cntrl_type type)
+{
+	int ms = 0;
+
+	_lookup(&conf.cntrls_flush_delay, path, type, 0,
+		LEDMON_MAX_FLUSH_DELAY, &ms);
+	return ms;
+}
+
+uint64_t cadence_next(void)
+{
+	struct cadence *cadence;
+	uint64_t next = 0;
+
+	if (!cadences_ready)
+		return 0;
+	list_for_each(&cadences, cadence) {
+		if (!next || cadence->next < next)
+			next = cadence->next;
+	}
+	return next;
+}
+
+void cadence_fini(void)
+{
+	if (cadences_ready)
+		list_erase(&cadences);
+	cadences_ready = 0;
+}
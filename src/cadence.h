@@ -0,0 +1,99 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _CADENCE_H_INCLUDED_
+#define _CADENCE_H_INCLUDED_
+
+#include <stdint.h>
+
+#include "cntrl.h"
+
+/*
+ * Refresh schedule of controllers.
+ *
+ * RAID and block device states are read on each scan, whereas a controller,
+ * its enclosures and attached block devices (enclosure slots, SMP phys) are
+ * initialized again only when the refresh interval of the controller has
+ * elapsed. The interval is given by CNTRL_INTERVAL entry
+ * matching controller path or controller type, otherwise it is INTERVAL.
+ *
+ * Flushing of LED messages can be delayed per controller as well, so slot
+ * updates which come shortly one after another are sent in one transaction.
+ * The delay is given by CNTRL_FLUSH_DELAY entries.
+ */
+
+/**
+ * @brief Starts a scan cycle.
+ *
+ * Decisions made by cadence_due() stay valid until the next cycle is started.
+ *
+ * @return The function does not return a value.
+ */
+void cadence_begin(void);
+
+/**
+ * @brief Checks if the controller should be refreshed in current cycle.
+ *
+ * The first call in a cycle decides and schedules the next refresh, subsequent
+ * calls return the same answer. A controller seen for the first time is due.
+ *
+ * @param[in]    path            - sysfs path to the controller.
+ * @param[in]    type            - type of the controller.
+ *
+ * @return 1 if the controller is due, otherwise 0.
+ */
+int cadence_due(const char *path, enum cntrl_type type);
+
+/**
+ * @brief Makes the controller due in current cycle.
+ *
+ * It is used if devices of the controller have changed, e.g. an enclosure has
+ * been added or removed.
+ *
+ * @param[in]    path            - sysfs path to the controller.
+ *
+ * @return The function does not return a value.
+ */
+void cadence_expire(const char *path);
+
+/**
+ * @brief Gets flush coalescing delay of the controller.
+ *
+ * @param[in]    path            - sysfs path to the controller.
+ * @param[in]    type            - type of the controller.
+ *
+ * @return Delay in milliseconds, 0 if messages are flushed at once.
+ */
+uint64_t cadence_flush_delay(const char *path, enum cntrl_type type);
+
+/**
+ * @brief Gets time of the nearest refresh.
+ *
+ * @return Time in milliseconds of monotonic clock or 0 if nothing is scheduled.
+ */
+uint64_t cadence_next(void);
+
+/**
+ * @brief Releases the schedule.
+ *
+ * @return The function does not return a value.
+ */
+void cadence_fini(void);
+
+#endif				/* _CADENCE_H_INCLUDED_ */
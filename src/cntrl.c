@@ -18,11 +18,13 @@
  */
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #if _HAVE_DMALLOC_H
 #include <dmalloc.h>
@@ -35,6 +37,7 @@
 #include "smp.h"
 #include "status.h"
 #include "sysfs.h"
+#include "token.h"
 #include "utils.h"
 #include "amd_sgpio.h"
 
@@ -54,71 +57,121 @@ static const char * const ctrl_type_str[] = {
 };
 
 /**
+ * Names of controller types used in configuration and manifest files.
  */
-static int _is_storage_controller(const char *path)
-{
-	uint64_t class = get_uint64(path, 0, "class");
-	return (class & 0xff0000L) == 0x010000L;
-}
+static const struct token cntrl_type_tokens[] = {
+	TOKEN("AHCI", CNTRL_TYPE_AHCI),
+	TOKEN("AMD_SGPIO", CNTRL_TYPE_AMD_SGPIO),
+	TOKEN("DELLSSD", CNTRL_TYPE_DELLSSD),
+	TOKEN("SCSI", CNTRL_TYPE_SCSI),
+	TOKEN("VMD", CNTRL_TYPE_VMD),
+};
 
 /**
+ * Size of PCI configuration space header which is readable without privileges.
  */
-static int _is_isci_cntrl(const char *path)
-{
-	return sysfs_check_driver(path, "isci");
-}
+#define PCI_CONFIG_HEADER_SIZE	64
 
 /**
+ * @brief PCI function identification read at once.
+ *
+ * This is internal structure of 'controller device' module. It holds PCI IDs
+ * and the name of the driver bound to the function.
  */
-static int _is_ahci_cntrl(const char *path)
-{
-	char temp[PATH_MAX], link[PATH_MAX], *t;
-
-	snprintf(temp, sizeof(temp), "%s/driver", path);
-
-	if (realpath(temp, link) == NULL)
-		return 0;
+struct pci_function {
+	uint16_t vendor;
+	uint16_t device;
+	uint16_t subsystem_vendor;
+	uint32_t class;
+	char driver[NAME_MAX + 1];
+};
 
-	t = strrchr(link, '/');
-	if ((t != NULL) && (strcmp(t + 1, "ahci") != 0))
-		return 0;
+/**
+ * @brief Classification rule of controller devices.
+ *
+ * This is internal structure of 'controller device' module. Fields set to
+ * zero or NULL match any function. The check callback is called only if all
+ * other fields match.
+ */
+struct cntrl_rule {
+	uint32_t class;
+	uint32_t class_mask;
+	uint16_t vendor;
+	uint16_t device;
+	uint16_t subsystem_vendor;
+	const char *driver;
+	int (*check)(const char *path);
+	enum cntrl_type type;
+};
 
-	return 1;
+/**
+ */
+static uint16_t _get_le16(const unsigned char *p)
+{
+	return p[0] | p[1] << 8;
 }
 
-static int _is_intel_ahci_cntrl(const char *path)
+/**
+ * @brief Reads PCI IDs and driver name of the function.
+ *
+ * This is internal function of 'controller device' module. IDs are taken from
+ * the header of the binary 'config' attribute. Text attributes are read
+ * only if the header cannot be read.
+ *
+ * @param[in]      path           path to controller device in sysfs tree.
+ * @param[out]     func           IDs and name of the driver.
+ *
+ * @return The function does not return a value.
+ */
+static void _read_pci_function(const char *path, struct pci_function *func)
 {
-	if (!_is_ahci_cntrl(path))
-		return 0;
+	unsigned char hdr[PCI_CONFIG_HEADER_SIZE];
+	char buf[PATH_MAX], link[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	memset(func, 0, sizeof(*func));
+	snprintf(buf, sizeof(buf), "%s/config", path);
+	fd = open(buf, O_RDONLY | O_CLOEXEC);
+	len = fd < 0 ? -1 : pread(fd, hdr, sizeof(hdr), 0);
+	if (fd >= 0)
+		close(fd);
+	if (len == sizeof(hdr)) {
+		func->vendor = _get_le16(hdr + 0x00);
+		func->device = _get_le16(hdr + 0x02);
+		func->class = hdr[0x09] | hdr[0x0a] << 8 | hdr[0x0b] << 16;
+		func->subsystem_vendor = _get_le16(hdr + 0x2c);
+	} else {
+		func->vendor = get_uint64(path, 0, "vendor");
+		func->device = get_uint64(path, 0, "device");
+		func->class = get_uint64(path, 0, "class");
+		func->subsystem_vendor = get_uint64(path, 0, "subsystem_vendor");
+	}
 
-	return get_uint64(path, 0, "vendor") == 0x8086L;
+	snprintf(buf, sizeof(buf), "%s/driver", path);
+	len = readlink(buf, link, sizeof(link) - 1);
+	if (len > 0) {
+		char *name;
+
+		link[len] = '\0';
+		name = strrchr(link, '/');
+		str_cpy(func->driver, name ? name + 1 : link, sizeof(func->driver));
+	}
 }
 
-static int _is_amd_ahci_cntrl(const char *path)
+/**
+ */
+static int _is_isci_cntrl(const char *path)
 {
-	if (!_is_ahci_cntrl(path))
-		return 0;
-
-	return get_uint64(path, 0, "vendor") == 0x1022L;
+	return sysfs_check_driver(path, "isci");
 }
 
 extern int get_dell_server_type(void);
 
-static int _is_dellssd_cntrl(const char *path)
+static int _is_dell_server(const char *path)
 {
-	uint64_t vdr, dev, svdr, cls;
-	int gen = 0;
-
-	vdr = get_uint64(path, 0, "vendor");
-	dev = get_uint64(path, 0, "device");
-	cls = get_uint64(path, 0, "class");
-	svdr = get_uint64(path, 0, "subsystem_vendor");
-	if (cls == 0x10802)
-		gen = get_dell_server_type();
-
-	return ((vdr == 0x1344L && dev == 0x5150L) || /* micron ssd */
-		(gen != 0) ||			      /* Dell Server+NVME */
-	        (svdr == 0x1028 && cls == 0x10802));  /* nvmhci ssd */
+	(void)path;
+	return get_dell_server_type() != 0;
 }
 
 /**
@@ -153,9 +206,46 @@ static int _is_smp_cntrl(const char *path)
 	return result;
 }
 
-static int _is_vmd_cntrl(const char *path)
+/**
+ * @brief Classification of storage controllers.
+ *
+ * This is internal array of 'controller device' module. Rules are matched in
+ * order and the first matching one gives the type of controller. Rules which
+ * need a callback, e.g. to query IPMI or to send SMP request, are placed
+ * after the rules which need only the IDs and the driver name.
+ */
+static const struct cntrl_rule cntrl_rules[] = {
+	{ .driver = "vmd", .type = CNTRL_TYPE_VMD },
+	{ .vendor = 0x1344, .device = 0x5150,		/* micron ssd */
+	  .type = CNTRL_TYPE_DELLSSD },
+	{ .class = 0x010802, .class_mask = 0xffffff,	/* nvmhci ssd */
+	  .subsystem_vendor = 0x1028, .type = CNTRL_TYPE_DELLSSD },
+	{ .driver = "ahci", .vendor = 0x8086, .type = CNTRL_TYPE_AHCI },
+	{ .driver = "ahci", .vendor = 0x1022, .type = CNTRL_TYPE_AMD_SGPIO },
+	{ .driver = "isci", .type = CNTRL_TYPE_SCSI },
+	{ .class = 0x010802, .class_mask = 0xffffff,	/* Dell Server+NVME */
+	  .check = _is_dell_server, .type = CNTRL_TYPE_DELLSSD },
+	{ .check = sysfs_enclosure_attached_to_cntrl, .type = CNTRL_TYPE_SCSI },
+	{ .check = _is_smp_cntrl, .type = CNTRL_TYPE_SCSI },
+};
+
+/**
+ */
+static int _rule_matches(const struct cntrl_rule *rule,
+			 const struct pci_function *func, const char *path)
 {
-	return sysfs_check_driver(path, "vmd");
+	if ((func->class & rule->class_mask) != rule->class)
+		return 0;
+	if (rule->vendor && rule->vendor != func->vendor)
+		return 0;
+	if (rule->device && rule->device != func->device)
+		return 0;
+	if (rule->subsystem_vendor &&
+	    rule->subsystem_vendor != func->subsystem_vendor)
+		return 0;
+	if (rule->driver && strcmp(rule->driver, func->driver) != 0)
+		return 0;
+	return !rule->check || rule->check(path);
 }
 
 /**
@@ -173,35 +263,26 @@ static int _is_vmd_cntrl(const char *path)
  */
 static enum cntrl_type _get_type(const char *path)
 {
-	enum cntrl_type type = CNTRL_TYPE_UNKNOWN;
-
-	if (_is_vmd_cntrl(path)) {
-		type = CNTRL_TYPE_VMD;
-	} else if (_is_dellssd_cntrl(path)) {
-		type = CNTRL_TYPE_DELLSSD;
-	} else if (_is_storage_controller(path)) {
-		if (_is_intel_ahci_cntrl(path))
-			type = CNTRL_TYPE_AHCI;
-		else if (_is_amd_ahci_cntrl(path))
-			type = CNTRL_TYPE_AMD_SGPIO;
-		else if (_is_isci_cntrl(path)
-				|| sysfs_enclosure_attached_to_cntrl(path)
-				|| _is_smp_cntrl(path))
-			type = CNTRL_TYPE_SCSI;
+	struct pci_function func;
+	size_t i;
+
+	_read_pci_function(path, &func);
+	/* functions which are not mass storage controllers are never checked */
+	if ((func.class & 0xff0000) != 0x010000)
+		return CNTRL_TYPE_UNKNOWN;
+	for (i = 0; i < sizeof(cntrl_rules) / sizeof(cntrl_rules[0]); i++) {
+		if (_rule_matches(&cntrl_rules[i], &func, path))
+			return cntrl_rules[i].type;
 	}
-	return type;
+	return CNTRL_TYPE_UNKNOWN;
 }
 
 struct _host_type *alloc_host(int id, struct _host_type *next)
 {
 	struct _host_type *host = NULL;
-	host = malloc(sizeof(struct _host_type));
+	host = calloc(1, sizeof(struct _host_type));
 	if (host) {
 		host->host_id = id;
-		host->ibpi_state_buffer = NULL;
-		memset(host->bitstream, 0, sizeof(host->bitstream));
-		host->flush = 0;
-		host->ports = 0;
 		host->next = next;
 	}
 	return host;
@@ -213,11 +294,75 @@ void free_hosts(struct _host_type *h)
 	while (h) {
 		t = h->next;
 		free(h->ibpi_state_buffer);
+		free(h->sent_state);
+		free(h->phy_flags);
+		free(h->port_phys);
 		free(h);
 		h = t;
 	}
 }
 
+/**
+ * @brief Adds port of the host to the port to phy map.
+ *
+ * The function opens port-H:P directory and takes the first phy-H:N link it
+ * finds there. For a wide port it is the phy with the lowest index.
+ */
+static void _add_port_phy(struct _host_type *host, const char *path,
+			  const char *name)
+{
+	char buf[PATH_MAX];
+	struct _port_phy *map;
+	struct dirent *de;
+	int h, port_id, phy = -1;
+	DIR *d;
+
+	if (sscanf(name, "port-%d:%d", &h, &port_id) != 2)
+		return;
+
+	snprintf(buf, sizeof(buf), "%s/%s", path, name);
+	d = opendir(buf);
+	if (!d)
+		return;
+	while ((de = readdir(d))) {
+		if (strncmp(de->d_name, "phy-", strlen("phy-")) == 0 &&
+		    sscanf(de->d_name, "phy-%d:%d", &h, &phy) == 2)
+			break;
+		phy = -1;
+	}
+	closedir(d);
+	if (phy < 0)
+		return;
+
+	map = realloc(host->port_phys,
+		      (host->port_phys_len + 1) * sizeof(*map));
+	if (!map)
+		return;
+	map[host->port_phys_len].port_id = port_id;
+	map[host->port_phys_len].phy_index = phy;
+	host->port_phys = map;
+	host->port_phys_len++;
+}
+
+void update_port_phys(struct _host_type *host, const char *path)
+{
+	struct dirent *de;
+	DIR *d;
+
+	free(host->port_phys);
+	host->port_phys = NULL;
+	host->port_phys_len = 0;
+
+	d = opendir(path);
+	if (!d)
+		return;
+	while ((de = readdir(d))) {
+		if (strncmp(de->d_name, "port-", strlen("port-")) == 0)
+			_add_port_phy(host, path, de->d_name);
+	}
+	closedir(d);
+}
+
 void _find_host(const char *path, struct _host_type **hosts)
 {
 	const int host_len = sizeof("host") - 1;
@@ -243,9 +388,10 @@ void _find_host(const char *path, struct _host_type **hosts)
 		}
 
 		while ((de = readdir(d))) {
-			if (strncmp(de->d_name, "phy-", strlen("phy-")) == 0) {
+			if (strncmp(de->d_name, "phy-", strlen("phy-")) == 0)
 				th->ports++;
-			}
+			else if (strncmp(de->d_name, "port-", strlen("port-")) == 0)
+				_add_port_phy(th, path, de->d_name);
 		}
 
 		closedir(d);
@@ -421,6 +567,25 @@ void cntrl_device_fini(struct cntrl_device *device)
 	}
 }
 
+enum cntrl_type cntrl_type_lookup(const char *name, size_t len)
+{
+	int type = token_lookup(cntrl_type_tokens,
+				TOKEN_COUNT(cntrl_type_tokens), name, len);
+
+	return type < 0 ? CNTRL_TYPE_UNKNOWN : (enum cntrl_type)type;
+}
+
+const char *cntrl_type_name(enum cntrl_type type)
+{
+	size_t i;
+
+	for (i = 0; i < TOKEN_COUNT(cntrl_type_tokens); i++) {
+		if (cntrl_type_tokens[i].value == (int)type)
+			return cntrl_type_tokens[i].name;
+	}
+	return "UNKNOWN";
+}
+
 void print_cntrl(struct cntrl_device *ctrl_dev)
 {
 		printf("%s (%s)\n", ctrl_dev->sysfs_path,
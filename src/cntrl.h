@@ -20,6 +20,9 @@
 #ifndef _CNTRL_H_INCLUDED_
 #define _CNTRL_H_INCLUDED_
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * This enumeration type lists all supported storage controller types.
  */
@@ -58,6 +61,12 @@ struct cntrl_device {
 		 * ibpi state buffer for directly attached devices
 		 */
 		struct gpio_tx_register_byte *ibpi_state_buffer;
+		/**
+		 * LEDs of each phy as last transmitted and flags of the phys,
+		 * see smp.c
+		 */
+		struct gpio_tx_register_byte *sent_state;
+		unsigned char *phy_flags;
 		/**
 		 * outbound raw byte stream
 		 */
@@ -66,6 +75,17 @@ struct cntrl_device {
 		 * bitstream's flush flag
 		 */
 		int flush;
+		/**
+		 * status of the last bitstream transmission
+		 */
+		int flush_status;
+		/**
+		 * locate or error LEDs have changed since the last
+		 * transmission and monotonic time in milliseconds the LEDs
+		 * have been read from the hba last, see smp.c
+		 */
+		int leds_changed;
+		uint64_t leds_read;
 		/**
 		 * host identifier for different hba instances
 		 */
@@ -74,6 +94,18 @@ struct cntrl_device {
 		 * number of total phy ports
 		 */
 		int ports;
+		/**
+		 * map of host's SAS ports to phy indexes, built once when
+		 * the host is discovered
+		 */
+		struct _port_phy {
+			int port_id;
+			int phy_index;
+		} *port_phys;
+		/**
+		 * number of entries in port_phys map
+		 */
+		int port_phys_len;
 		/**
 		 * pointer to next structure
 		 */
@@ -107,6 +139,57 @@ struct cntrl_device *cntrl_device_init(const char *path);
  */
 void cntrl_device_fini(struct cntrl_device *device);
 
+/**
+ * @brief Allocates a host structure and puts it in front of the given list.
+ *
+ * @param[in]      id             host identifier.
+ * @param[in]      next           list of hosts or NULL.
+ *
+ * @return Pointer to the new head of the list or NULL on allocation failure.
+ */
+struct _host_type *alloc_host(int id, struct _host_type *next);
+
+/**
+ * @brief Releases a list of hosts.
+ *
+ * @param[in]      h              list of hosts.
+ *
+ * @return The function does not return a value.
+ */
+void free_hosts(struct _host_type *h);
+
+/**
+ * @brief Builds the port to phy map of the host again.
+ *
+ * Ports of the host are renumbered when a drive is re-inserted, so the map
+ * built at discovery becomes stale for controllers kept across scans.
+ *
+ * @param[in]      host           host to update.
+ * @param[in]      path           path to the host in sysfs tree.
+ *
+ * @return The function does not return a value.
+ */
+void update_port_phys(struct _host_type *host, const char *path);
+
+/**
+ * @brief Gets controller type by name used in configuration files.
+ *
+ * @param[in]      name           name of the type, e.g. SCSI.
+ * @param[in]      len            length of the name.
+ *
+ * @return Controller type or CNTRL_TYPE_UNKNOWN if the name is not valid.
+ */
+enum cntrl_type cntrl_type_lookup(const char *name, size_t len);
+
+/**
+ * @brief Gets name of controller type used in configuration files.
+ *
+ * @param[in]      type           controller type.
+ *
+ * @return Name of the type.
+ */
+const char *cntrl_type_name(enum cntrl_type type);
+
 /**
  * @brief Prints given controller to stdout.
  *
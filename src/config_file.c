@@ -44,6 +44,33 @@ const char *log_level_map[] = {
 	[LOG_LEVEL_ALL]     = "ALL"
 };
 
+const char *sched_policy_map[] = {
+	[SCHED_POLICY_UNDEF]  = "DEFAULT",
+	[SCHED_POLICY_NORMAL] = "NORMAL",
+	[SCHED_POLICY_BATCH]  = "BATCH",
+	[SCHED_POLICY_IDLE]   = "IDLE"
+};
+
+const char *io_class_map[] = {
+	[IO_CLASS_UNDEF]       = "DEFAULT",
+	[IO_CLASS_REALTIME]    = "REALTIME",
+	[IO_CLASS_BEST_EFFORT] = "BEST-EFFORT",
+	[IO_CLASS_IDLE]        = "IDLE"
+};
+
+static int parse_map(const char **map, size_t size, char *s)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (strcasecmp(map[i], s) == 0)
+			return i;
+	}
+
+	fprintf(stderr, "Unknown value: %s\n", s);
+	return -1;
+}
+
 static int parse_bool(char *s)
 {
 	if (*s && (!strcasecmp(s, "enabled") ||
@@ -113,6 +140,7 @@ static int parse_next(FILE *fd)
 {
 	char buf[BUFSIZ];
 	char *s;
+	int t;
 
 	/* read the next non-blank non-comment line */
 	do {
@@ -174,6 +202,94 @@ static int parse_next(FILE *fd)
 		conf.raid_members_only = parse_bool(s);
 		if (conf.raid_members_only < 0)
 			return -1;
+	} else if (!strncmp(s, "CPU_AFFINITY=", 13)) {
+		s += 13;
+		if (*s) {
+			free(conf.cpu_affinity);
+			conf.cpu_affinity = str_dup(s);
+		}
+	} else if (!strncmp(s, "SCHED_POLICY=", 13)) {
+		s += 13;
+		t = parse_map(sched_policy_map,
+			      sizeof(sched_policy_map)/sizeof(char *), s);
+		if (t < 0)
+			return -1;
+		conf.sched_policy = t;
+	} else if (!strncmp(s, "IO_CLASS=", 9)) {
+		s += 9;
+		t = parse_map(io_class_map, sizeof(io_class_map)/sizeof(char *), s);
+		if (t < 0)
+			return -1;
+		conf.io_class = t;
+	} else if (!strncmp(s, "IO_LEVEL=", 9)) {
+		s += 9;
+		if (sscanf(s, "%d", &conf.io_level) != 1 || conf.io_level < 0 ||
+		    conf.io_level > IO_LEVEL_MAX) {
+			fprintf(stderr, "Invalid I/O priority level: %s\n", s);
+			return -1;
+		}
+	} else if (!strncmp(s, "FEED_SOCKET=", 12)) {
+		s += 12;
+		if (*s) {
+			free(conf.feed_socket);
+			conf.feed_socket = str_dup(s);
+		}
+	} else if (!strncmp(s, "TOPOLOGY_FILE=", 14)) {
+		s += 14;
+		if (*s) {
+			free(conf.topology_file);
+			conf.topology_file = str_dup(s);
+		}
+	} else if (!strncmp(s, "CNTRL_INTERVAL=", 15)) {
+		char *entry;
+
+		s += 15;
+		if (*s)
+			parse_list(&conf.cntrls_interval, s);
+		list_for_each(&conf.cntrls_interval, entry) {
+			size_t len;
+			int seconds;
+
+			if (str_entry(entry, &len, &seconds,
+				      LEDMON_MIN_SLEEP_INTERVAL,
+				      LEDMON_MAX_SLEEP_INTERVAL)) {
+				fprintf(stderr, "Invalid controller interval: %s\n",
+					entry);
+				return -1;
+			}
+		}
+	} else if (!strncmp(s, "CNTRL_FLUSH_DELAY=", 18)) {
+		char *entry;
+
+		s += 18;
+		if (*s)
+			parse_list(&conf.cntrls_flush_delay, s);
+		list_for_each(&conf.cntrls_flush_delay, entry) {
+			size_t len;
+			int ms;
+
+			if (str_entry(entry, &len, &ms, 0,
+				      LEDMON_MAX_FLUSH_DELAY)) {
+				fprintf(stderr, "Invalid controller flush delay: %s\n",
+					entry);
+				return -1;
+			}
+		}
+	} else if (!strncmp(s, "ACTIVITY_INTERVAL=", 18)) {
+		s += 18;
+		if (str_toi(s, &conf.activity_interval, 0,
+			    LEDMON_MAX_ACTIVITY_INTERVAL) ||
+		    (conf.activity_interval &&
+		     conf.activity_interval < LEDMON_MIN_ACTIVITY_INTERVAL)) {
+			fprintf(stderr, "Invalid activity interval: %s\n", s);
+			return -1;
+		}
+	} else if (!strncmp(s, "ACTIVITY_CPU_BUDGET=", 20)) {
+		s += 20;
+		if (str_toi(s, &conf.activity_cpu_budget, 1, 100)) {
+			fprintf(stderr, "Invalid activity CPU budget: %s\n", s);
+			return -1;
+		}
 	} else if (!strncmp(s, "WHITELIST=", 10)) {
 		s += 10;
 		if (*s)
@@ -193,9 +309,14 @@ void ledmon_free_config(void)
 {
 	list_erase(&conf.cntrls_blacklist);
 	list_erase(&conf.cntrls_whitelist);
+	list_erase(&conf.cntrls_interval);
+	list_erase(&conf.cntrls_flush_delay);
 
 	if (conf.log_path)
 		free(conf.log_path);
+	free(conf.feed_socket);
+	free(conf.cpu_affinity);
+	free(conf.topology_file);
 }
 
 /* return real config data or built-in default */
@@ -334,6 +455,16 @@ int main(int argc, char *argv[])
 	printf("BLINK_ON_INIT: %d\n", conf.blink_on_init);
 	printf("REBUILD_BLINK_ON_ALL: %d\n", conf.rebuild_blink_on_all);
 	printf("RAID_MEMBERS_ONLY: %d\n", conf.raid_members_only);
+	printf("FEED_SOCKET: %s\n", conf.feed_socket ? conf.feed_socket : "NONE");
+	printf("CPU_AFFINITY: %s\n",
+	       conf.cpu_affinity ? conf.cpu_affinity : "NONE");
+	printf("SCHED_POLICY: %s\n", sched_policy_map[conf.sched_policy]);
+	printf("IO_CLASS: %s\n", io_class_map[conf.io_class]);
+	printf("IO_LEVEL: %d\n", conf.io_level);
+	printf("ACTIVITY_INTERVAL: %d\n", conf.activity_interval);
+	printf("ACTIVITY_CPU_BUDGET: %d\n", conf.activity_cpu_budget);
+	printf("TOPOLOGY_FILE: %s\n",
+	       conf.topology_file ? conf.topology_file : "NONE");
 
 	if (list_is_empty(&conf.cntrls_whitelist))
 		printf("WHITELIST: NONE\n");
@@ -353,6 +484,24 @@ int main(int argc, char *argv[])
 		printf("\n");
 	}
 
+	if (list_is_empty(&conf.cntrls_interval))
+		printf("CNTRL_INTERVAL: NONE\n");
+	else {
+		printf("CNTRL_INTERVAL: ");
+		list_for_each(&conf.cntrls_interval, s)
+			printf("%s, ", s);
+		printf("\n");
+	}
+
+	if (list_is_empty(&conf.cntrls_flush_delay))
+		printf("CNTRL_FLUSH_DELAY: NONE\n");
+	else {
+		printf("CNTRL_FLUSH_DELAY: ");
+		list_for_each(&conf.cntrls_flush_delay, s)
+			printf("%s, ", s);
+		printf("\n");
+	}
+
 	ledmon_free_config();
 	return EXIT_SUCCESS;
 }
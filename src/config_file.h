@@ -21,6 +21,11 @@
 #define LEDCTL_DEF_LOG_FILE "/var/log/ledctl.log"
 #define LEDMON_DEF_SLEEP_INTERVAL 10
 #define LEDMON_MIN_SLEEP_INTERVAL 5
+#define LEDMON_MAX_SLEEP_INTERVAL (INT32_MAX / 1000)
+#define LEDMON_MAX_FLUSH_DELAY 1000
+#define LEDMON_MIN_ACTIVITY_INTERVAL 10
+#define LEDMON_MAX_ACTIVITY_INTERVAL 1000
+#define LEDMON_DEF_ACTIVITY_CPU_BUDGET 1
 
 enum log_level_enum {
 	LOG_LEVEL_UNDEF = 0,
@@ -32,6 +37,24 @@ enum log_level_enum {
 	LOG_LEVEL_ALL,
 };
 
+enum sched_policy_enum {
+	SCHED_POLICY_UNDEF = 0,
+	SCHED_POLICY_NORMAL,
+	SCHED_POLICY_BATCH,
+	SCHED_POLICY_IDLE,
+};
+
+/* values match IOPRIO_CLASS_* of the kernel */
+enum io_class_enum {
+	IO_CLASS_UNDEF = 0,
+	IO_CLASS_REALTIME,
+	IO_CLASS_BEST_EFFORT,
+	IO_CLASS_IDLE,
+};
+
+#define IO_LEVEL_MAX 7
+#define IO_LEVEL_DEFAULT 4
+
 struct ledmon_conf {
 	/* internal ledmon functions */
 	char *log_path;
@@ -44,13 +67,38 @@ struct ledmon_conf {
 	int rebuild_blink_on_all;
 	int raid_members_only;
 
+	/* path to LED state change feed socket */
+	char *feed_socket;
+
+	/* housekeeping CPUs, scheduling policy and I/O priority */
+	char *cpu_affinity;
+	enum sched_policy_enum sched_policy;
+	enum io_class_enum io_class;
+	int io_level;
+
+	/* activity LED tick in ms (0 if disabled) and its CPU budget in % */
+	int activity_interval;
+	int activity_cpu_budget;
+
+	/* path to topology manifest trusted by the first scan */
+	char *topology_file;
+
 	/* whitelist and blacklist of controllers for blinking */
 	struct list cntrls_whitelist;
 	struct list cntrls_blacklist;
+
+	/* refresh intervals of controllers, entries <type|path>:<seconds> */
+	struct list cntrls_interval;
+
+	/* flush coalescing delays of controllers, entries <type|path>:<ms> */
+	struct list cntrls_flush_delay;
 };
 
 extern struct ledmon_conf conf;
 
+extern const char *sched_policy_map[];
+extern const char *io_class_map[];
+
 int ledmon_read_config(const char *filename);
 int ledmon_write_shared_conf(void);
 int ledmon_remove_shared_conf(void);
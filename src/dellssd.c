@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,6 +40,8 @@
 #include "dellssd.h"
 #include "ibpi.h"
 #include "list.h"
+#include "plan.h"
+#include "probes.h"
 #include "raid.h"
 #include "scsi.h"
 #include "slave.h"
@@ -46,6 +49,7 @@
 #include "status.h"
 #include "sysfs.h"
 #include "utils.h"
+#include "xfer.h"
 
 #define BP_PRESENT       (1L << 0)
 #define BP_ONLINE        (1L << 1)
@@ -83,6 +87,47 @@ static const unsigned int ibpi2ssd[] = {
 #define DELL_OEM_STORAGE_GETDRVMAP_14G      0x37
 #define DELL_OEM_STORAGE_SETDRVSTATUS_14G   0x34
 
+/*
+ * File which keeps the result of Dell server detection. It lives in tmpfs
+ * owned by root, so the platform is probed once per boot and the result
+ * cannot be forged by other users.
+ */
+#define DELL_SERVER_TYPE_CACHE		    LEDMON_RUN_DIR "/dell_server_type"
+#define DMI_ID_PATH			    "/sys/class/dmi/id"
+
+/*
+ * Time in seconds the BMC has to respond to a command.
+ */
+#define IPMI_TIMEOUT			    5
+
+/*
+ * Time in microseconds between checks of a command in flight.
+ */
+#define IPMI_POLL_WAIT			    1000
+
+/**
+ * Steps of IPMI transaction, see xfer.h. The bay and slot of the drive are
+ * read with GETDRVMAP first, then SETDRVSTATUS sets the state of the slot.
+ */
+enum ipmi_step {
+	IPMI_STEP_GETDRVMAP = 1,
+	IPMI_STEP_SETDRVSTATUS,
+};
+
+/**
+ * Command of block device the BMC has not responded to yet.
+ */
+struct ipmi_xfer {
+	char *path;
+	int fd;
+	unsigned int state;
+	uint64_t start;
+	uint64_t deadline;
+};
+
+static struct list ipmi_xfers;
+static int ipmi_xfers_ready;
+
 #define APP_NETFN			    0x06
 #define APP_GET_SYSTEM_INFO		    0x59
 #define DELL_GET_IDRAC_INFO		    0xDD
@@ -115,26 +160,20 @@ static int ipmi_open(void)
 	return -1;
 }
 
-static int
-ipmicmd(int sa, int lun, int netfn, int cmd, int datalen, void *data,
-	int resplen, int *rlen, void *resp)
+/**
+ * @brief Sends IPMI request.
+ *
+ * @return 0 if the request has been sent, otherwise -1.
+ */
+static int ipmi_submit(int fd, int sa, int lun, int netfn, int cmd,
+		       int datalen, void *data)
 {
 	static int msgid;
 	struct ipmi_system_interface_addr saddr;
 	struct ipmi_ipmb_addr iaddr;
-	struct ipmi_addr raddr;
 	struct ipmi_req req;
-	struct ipmi_recv rcv;
-	fd_set rfd;
-	int fd, rc;
-	uint8_t tresp[resplen + 1];
-
-	fd = ipmi_open();
-	if (fd < 0)
-		return -1;
 
 	memset(&req, 0, sizeof(req));
-	memset(&rcv, 0, sizeof(rcv));
 	if (sa == BMC_SA) {
 		memset(&saddr, 0, sizeof(saddr));
 		saddr.addr_type = IPMI_SYSTEM_INTERFACE_ADDR_TYPE;
@@ -158,22 +197,26 @@ ipmicmd(int sa, int lun, int netfn, int cmd, int datalen, void *data,
 	req.msg.cmd = cmd;
 	req.msg.data_len = datalen;
 	req.msg.data = data;
-	rc = ioctl(fd, IPMICTL_SEND_COMMAND, (void *)&req);
-	if (rc != 0) {
+	if (ioctl(fd, IPMICTL_SEND_COMMAND, (void *)&req) != 0) {
 		log_debug("send");
-		goto end;
+		return -1;
 	}
+	return 0;
+}
 
-	/* Wait for Response */
-	FD_ZERO(&rfd);
-	FD_SET(fd, &rfd);
-	rc = select(fd + 1, &rfd, NULL, NULL, NULL);
-	if (rc < 0) {
-		log_debug("select");
-		goto end;
-	}
+/**
+ * @brief Gets IPMI response which is ready to be read.
+ *
+ * @return 0 if the response has been read, otherwise -1.
+ */
+static int ipmi_receive(int fd, int resplen, int *rlen, void *resp)
+{
+	struct ipmi_addr raddr;
+	struct ipmi_recv rcv;
+	uint8_t tresp[resplen + 1];
+	int rc;
 
-	/* Get response */
+	memset(&rcv, 0, sizeof(rcv));
 	rcv.msg.data = tresp;
 	rcv.msg.data_len = resplen + 1;
 	rcv.addr = (void *)&raddr;
@@ -183,28 +226,118 @@ ipmicmd(int sa, int lun, int netfn, int cmd, int datalen, void *data,
 		log_debug("too short..\n");
 	if (rc != 0 && errno != EMSGSIZE) {
 		log_debug("recv %d", errno);
-		goto end;
+		return -1;
 	}
 	if (rcv.msg.data[0])
 		log_debug("IPMI Error: %.2x\n", rcv.msg.data[0]);
-	rc = 0;
 	*rlen = rcv.msg.data_len - 1;
 	memcpy(resp, rcv.msg.data + 1, *rlen);
+	return 0;
+}
+
+/**
+ * @brief Issues IPMI command and waits for the response.
+ *
+ * It is used only to detect the server type, LED commands are issued by
+ * ipmi_setled() without blocking.
+ */
+static int
+ipmicmd(int sa, int lun, int netfn, int cmd, int datalen, void *data,
+	int resplen, int *rlen, void *resp)
+{
+	struct timeval tv;
+	fd_set rfd;
+	int fd, rc;
+	uint64_t start;
+
+	fd = ipmi_open();
+	if (fd < 0)
+		return -1;
+
+	plan_xfer("ipmi", NULL, datalen, 0);
+	start = get_monotonic_us();
+	PROBE2(xfer_start, "ipmi", NULL);
+	rc = ipmi_submit(fd, sa, lun, netfn, cmd, datalen, data);
+	if (rc != 0)
+		goto end;
+
+	/* Wait for Response */
+	FD_ZERO(&rfd);
+	FD_SET(fd, &rfd);
+	tv.tv_sec = IPMI_TIMEOUT;
+	tv.tv_usec = 0;
+	rc = select(fd + 1, &rfd, NULL, NULL, &tv);
+	if (rc <= 0) {
+		log_debug(rc ? "select" : "timeout");
+		rc = -1;
+		goto end;
+	}
+
+	/* Get response */
+	rc = ipmi_receive(fd, resplen, rlen, resp);
  end:
+	PROBE3(xfer_end, "ipmi", NULL, rc);
+	plan_stat("ipmi", start);
 	close(fd);
 	return rc;
 }
 
-int get_dell_server_type()
+static int _load_server_type(void)
+{
+	char buf[BUFFER_MAX];
+	ssize_t len;
+	int fd, gen;
+
+	fd = run_file_open(DELL_SERVER_TYPE_CACHE, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	if (sscanf(buf, "%d", &gen) != 1 || gen < 0)
+		return -1;
+	return gen;
+}
+
+static void _save_server_type(int gen)
+{
+	char buf[BUFFER_MAX], tmp[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	fd = run_file_create(DELL_SERVER_TYPE_CACHE, tmp, sizeof(tmp));
+	if (fd < 0)
+		return;
+	snprintf(buf, sizeof(buf), "%d\n", gen);
+	len = write(fd, buf, strlen(buf));
+	if (close(fd) || len != (ssize_t)strlen(buf) ||
+	    rename(tmp, DELL_SERVER_TYPE_CACHE))
+		unlink(tmp);
+}
+
+/*
+ * Checks the system vendor reported by DMI. Returns 0 if the platform is
+ * not made by Dell, otherwise (or if DMI is not available) returns 1.
+ */
+static int _is_dell_platform(void)
+{
+	char *vendor = get_text(DMI_ID_PATH, "sys_vendor");
+	int result = 1;
+
+	if (vendor) {
+		result = strncmp(vendor, "Dell", strlen("Dell")) == 0;
+		free(vendor);
+	}
+	return result;
+}
+
+static int _query_server_type(void)
 {
-	static int gen;
 	uint8_t data[4], rdata[20];
 	int rc, rlen;
 
-	/* Don't requery if we already know have ID */
-	if (gen)
-		return gen;
-
 	/* Get Dell Generation */
 	memset(data, 0, sizeof(data));
 	memset(rdata, 0, sizeof(rdata));
@@ -216,7 +349,7 @@ int get_dell_server_type()
 		     20, &rlen, rdata);
 	if (rc) {
 		log_debug("Unable to issue IPMI command GetSystemInfo\n");
-		return 0;
+		return -1;
 	}
 	switch (rdata[10]) {
 	case DELL_12G_MONOLITHIC:
@@ -225,8 +358,7 @@ int get_dell_server_type()
 	case DELL_13G_MODULAR:
 	case DELL_14G_MONOLITHIC:
 	case DELL_14G_MODULAR:
-		gen = rdata[10];
-		return gen;
+		return rdata[10];
 	default:
 		log_debug("Unable to determine Dell Server type\n");
 		break;
@@ -234,20 +366,149 @@ int get_dell_server_type()
 	return 0;
 }
 
-static int ipmi_setled(int b, int d, int f, int state)
+/*
+ * Determines the generation of Dell server. The verdict, positive or not, is
+ * cached in the process and in DELL_SERVER_TYPE_CACHE, so the BMC is queried at most
+ * once per boot. Platforms which are not made by Dell according to DMI are
+ * never queried. A failed IPMI command is not cached, because IPMI driver
+ * might not be loaded yet.
+ */
+int get_dell_server_type(void)
 {
-	uint8_t data[20], rdata[20];
-	int rc, rlen, bay = 0xFF, slot = 0xFF, devfn, gen = 0;
+	static int gen = -1;
 
-	/* Check if this is a supported Dell server */
-	gen = get_dell_server_type();
-	if (!gen)
+	if (gen >= 0)
+		return gen;
+
+	gen = _load_server_type();
+	if (gen >= 0)
+		return gen;
+
+	if (!_is_dell_platform()) {
+		gen = 0;
+	} else {
+		int rc = _query_server_type();
+
+		if (rc < 0)
+			return 0;
+		gen = rc;
+	}
+	_save_server_type(gen);
+	return gen;
+}
+
+static void _ipmi_xfer_free(struct ipmi_xfer *xfer)
+{
+	if (xfer->fd >= 0)
+		close(xfer->fd);
+	free(xfer->path);
+	free(xfer);
+}
+
+static struct node *_ipmi_xfer_find(const char *path)
+{
+	struct node *node;
+
+	if (!ipmi_xfers_ready) {
+		list_init(&ipmi_xfers, (item_free_t)_ipmi_xfer_free);
+		ipmi_xfers_ready = 1;
+	}
+	list_for_each_node(&ipmi_xfers, node) {
+		struct ipmi_xfer *xfer = node->item;
+
+		if (strcmp(xfer->path, path) == 0)
+			return node;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Drops the transaction of the device, the response is not waited for.
+ */
+static void _ipmi_xfer_abandon(struct block_device *device)
+{
+	struct node *node = _ipmi_xfer_find(device->sysfs_path);
+
+	if (node)
+		list_delete(node);
+	xfer_done(device);
+}
+
+/**
+ * @brief Sends Dell OEM storage command of the transaction.
+ *
+ * @return 0 if the command is in flight, 1 if it is not issued in plan mode,
+ *         otherwise -1.
+ */
+static int _ipmi_xfer_submit(struct ipmi_xfer *xfer, int datalen, void *data,
+			     int write)
+{
+	if (plan_xfer("ipmi", NULL, datalen, write))
+		return 1;
+	xfer->start = get_monotonic_us();
+	xfer->deadline = xfer->start + (uint64_t)IPMI_TIMEOUT * 1000000;
+	PROBE2(xfer_start, "ipmi", NULL);
+	if (ipmi_submit(xfer->fd, BMC_SA, 0, DELL_OEM_NETFN,
+			DELL_OEM_STORAGE_CMD, datalen, data) == 0)
 		return 0;
-	devfn = (((d & 0x1F) << 3) | (f & 0x7));
+	PROBE3(xfer_end, "ipmi", NULL, -1);
+	plan_stat("ipmi", xfer->start);
+	return -1;
+}
+
+/**
+ * @brief Checks the response to the command in flight without waiting.
+ *
+ * @return -EAGAIN if the BMC has not responded yet, 0 if the response has
+ *         been read, otherwise -1.
+ */
+static int _ipmi_xfer_poll(struct ipmi_xfer *xfer, int resplen, int *rlen,
+			   void *resp)
+{
+	struct pollfd pfd;
+	int rc;
+
+	pfd.fd = xfer->fd;
+	pfd.events = POLLIN;
+	rc = poll(&pfd, 1, 0);
+	if ((rc == 0 && get_monotonic_us() < xfer->deadline) ||
+	    (rc < 0 && errno == EINTR))
+		return -EAGAIN;
+	if (rc <= 0) {
+		log_debug(rc ? "poll" : "timeout");
+		rc = -1;
+	} else {
+		rc = ipmi_receive(xfer->fd, resplen, rlen, resp);
+	}
+	PROBE3(xfer_end, "ipmi", NULL, rc);
+	plan_stat("ipmi", xfer->start);
+	return rc;
+}
+
+/**
+ * @brief Starts the transaction with GETDRVMAP command.
+ *
+ * @return 0 if the command is in flight, otherwise -1.
+ */
+static int _ipmi_getdrvmap(struct block_device *device, int gen, int b,
+			   int devfn, unsigned int state)
+{
+	struct ipmi_xfer *xfer;
+	uint8_t data[20];
+
+	xfer = calloc(1, sizeof(*xfer));
+	if (!xfer)
+		return -1;
+	xfer->path = str_dup(device->sysfs_path);
+	xfer->state = state;
+	xfer->fd = ipmi_open();
+	if (!xfer->path || xfer->fd < 0) {
+		_ipmi_xfer_free(xfer);
+		return -1;
+	}
 
 	/* Get mapping of BDF to bay:slot */
 	memset(data, 0, sizeof(data));
-	memset(rdata, 0, sizeof(rdata));
 	data[0] = 0x01;				/* get         */
 	data[2] = 0x06;				/* length lsb  */
 	data[3] = 0x00;				/* length msb  */
@@ -269,21 +530,31 @@ static int ipmi_setled(int b, int d, int f, int state)
 		data[1] = DELL_OEM_STORAGE_GETDRVMAP_14G;
 		break;
 	}
-	rc = ipmicmd(BMC_SA, 0, DELL_OEM_NETFN, DELL_OEM_STORAGE_CMD, 8, data,
-		     20, &rlen, rdata);
-	if (!rc) {
-		bay = rdata[7];
-		slot = rdata[8];
-	}
-	if (bay == 0xFF || slot == 0xFF) {
-		log_error("Unable to determine bay/slot for device %.2x:%.2x.%x\n",
-			  b, d, f);
-		return 0;
+	if (_ipmi_xfer_submit(xfer, 8, data, 0)) {
+		_ipmi_xfer_free(xfer);
+		return -1;
 	}
+	list_append(&ipmi_xfers, xfer);
+	xfer_wait(device, IPMI_STEP_GETDRVMAP,
+		  get_monotonic_us() + IPMI_POLL_WAIT);
+	return 0;
+}
+
+/**
+ * @brief Continues the transaction with SETDRVSTATUS command.
+ *
+ * @return 0 if the command is in flight, 1 if it is not issued in plan mode,
+ *         otherwise -1.
+ */
+static int _ipmi_setdrvstatus(struct block_device *device,
+			      struct ipmi_xfer *xfer, int gen, int bay,
+			      int slot)
+{
+	uint8_t data[20];
+	int rc;
 
 	/* Set Bay:Slot to Mask */
 	memset(data, 0, sizeof(data));
-	memset(rdata, 0, sizeof(rdata));
 	data[0] = 0x00;					/* set              */
 	data[2] = 0x0e;					/* length lsb       */
 	data[3] = 0x00;					/* length msb       */
@@ -293,8 +564,8 @@ static int ipmi_setled(int b, int d, int f, int state)
 	data[7] = 0x00;					/* length msb       */
 	data[8] = bay;					/* bayid            */
 	data[9] = slot;					/* slotid           */
-	data[10] = state & 0xff;			/* state LSB        */
-	data[11] = state >> 8;				/* state MSB        */
+	data[10] = xfer->state & 0xff;			/* state LSB        */
+	data[11] = xfer->state >> 8;			/* state MSB        */
 	switch (gen) {
 	case DELL_12G_MONOLITHIC:
 	case DELL_12G_MODULAR:
@@ -309,12 +580,89 @@ static int ipmi_setled(int b, int d, int f, int state)
 		data[1] = DELL_OEM_STORAGE_SETDRVSTATUS_14G;
 		break;
 	}
-	rc = ipmicmd(BMC_SA, 0, DELL_OEM_NETFN, DELL_OEM_STORAGE_CMD, 20, data,
-		     20, &rlen, rdata);
-	if (rc) {
+	/* in plan mode the drive map query is issued, but the state is not set */
+	rc = _ipmi_xfer_submit(xfer, 20, data, 1);
+	if (rc == 0)
+		xfer_wait(device, IPMI_STEP_SETDRVSTATUS,
+			  get_monotonic_us() + IPMI_POLL_WAIT);
+	return rc;
+}
+
+/**
+ * @brief Sets state of the slot of the drive.
+ *
+ * The two commands of the transaction are issued as steps, see xfer.h, so
+ * the caller is not blocked while the BMC processes them. A transaction left
+ * by a previous instance of the device is abandoned.
+ */
+static int ipmi_setled(struct block_device *device, int b, int d, int f,
+		       unsigned int state)
+{
+	struct ipmi_xfer *xfer;
+	struct node *node;
+	uint8_t rdata[20];
+	int rc, rlen, bay = 0xFF, slot = 0xFF, gen = 0;
+
+	/* Check if this is a supported Dell server */
+	gen = get_dell_server_type();
+	if (!gen)
+		__set_errno_and_return(ENODEV);
+
+	if (!xfer_pending(device))
+		_ipmi_xfer_abandon(device);
+	node = _ipmi_xfer_find(device->sysfs_path);
+	if (!node) {
+		if (_ipmi_getdrvmap(device, gen, b, ((d & 0x1F) << 3) | (f & 0x7),
+				    state)) {
+			xfer_done(device);
+			__set_errno_and_return(EIO);
+		}
+		return 0;
+	}
+
+	xfer = node->item;
+	memset(rdata, 0, sizeof(rdata));
+	rc = _ipmi_xfer_poll(xfer, 20, &rlen, rdata);
+	if (rc == -EAGAIN) {
+		xfer_wait(device, device->xfer_step,
+			  get_monotonic_us() + IPMI_POLL_WAIT);
+		return 0;
+	}
+
+	if (device->xfer_step == IPMI_STEP_GETDRVMAP) {
+		if (!rc) {
+			bay = rdata[7];
+			slot = rdata[8];
+		}
+		if (bay == 0xFF || slot == 0xFF) {
+			log_error("Unable to determine bay/slot for device %.2x:%.2x.%x\n",
+				  b, d, f);
+			rc = -1;
+		} else {
+			rc = _ipmi_setdrvstatus(device, xfer, gen, bay, slot);
+			if (rc == 0)
+				return 0;
+			if (rc > 0)
+				rc = 0;
+			else
+				log_error("Unable to issue SetDriveState for %.2x:%.2x.%x\n",
+					  b, d, f);
+		}
+	} else if (rc) {
 		log_error("Unable to issue SetDriveState for %.2x:%.2x.%x\n",
-			  b,d,f);
+			  b, d, f);
+	}
+
+	/* The pattern has changed while the transaction was in flight. */
+	if (rc == 0 && xfer->state != state) {
+		list_delete(node);
+		xfer_done(device);
+		return ipmi_setled(device, b, d, f, state);
 	}
+	list_delete(node);
+	xfer_done(device);
+	if (rc)
+		__set_errno_and_return(EIO);
 	return 0;
 }
 
@@ -325,21 +673,31 @@ char *dellssd_get_path(const char *cntrl_path)
 
 int dellssd_write(struct block_device *device, enum ibpi_pattern ibpi)
 {
-	unsigned int mask, bus, dev, fun;
+	unsigned int mask, indications, bus, dev, fun;
+	enum ibpi_pattern i;
 	char *t;
 
 	/* write only if state has changed */
-	if (ibpi == device->ibpi_prev)
-		return 1;
+	if (!block_state_changed(device, ibpi)) {
+		if (xfer_pending(device))
+			_ipmi_xfer_abandon(device);
+		return 0;
+	}
 
 	if ((ibpi < IBPI_PATTERN_NORMAL) || (ibpi > IBPI_PATTERN_LOCATE_OFF))
 		__set_errno_and_return(ERANGE);
 	mask = ibpi2ssd[ibpi];
-	t = strrchr(device->cntrl_path, '/');
-	if (t != NULL) {
-		/* Extract PCI bus:device.function */
-		if (sscanf(t + 1, "%*x:%x:%x.%x", &bus, &dev, &fun) == 3)
-			ipmi_setled(bus, dev, fun, mask);
+	/* backplane shows all indications set in the mask at once */
+	indications = block_indications(device, ibpi);
+	for (i = IBPI_PATTERN_NORMAL; i <= IBPI_PATTERN_LOCATE_OFF; i++) {
+		if (indications & IBPI_MASK(i))
+			mask |= ibpi2ssd[i];
 	}
-	return 0;
+	t = strrchr(device->cntrl_path, '/');
+	if (t == NULL)
+		__set_errno_and_return(EINVAL);
+	/* Extract PCI bus:device.function */
+	if (sscanf(t + 1, "%*x:%x:%x.%x", &bus, &dev, &fun) != 3)
+		__set_errno_and_return(EINVAL);
+	return ipmi_setled(device, bus, dev, fun, mask);
 }
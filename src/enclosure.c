@@ -124,11 +124,14 @@ struct enclosure_device *enclosure_device_init(const char *path)
 
 /*
  * The function returns memory allocated for fields of enclosure structure to
- * the system.
+ * the system. Pages which have not been flushed yet, e.g. within coalescing
+ * window, are released as well and a command in flight is abandoned.
  */
 void enclosure_device_fini(struct enclosure_device *enclosure)
 {
 	if (enclosure) {
+		ses_cmd_free(enclosure->cmd);
+		ses_free(enclosure->ses_pages);
 		free(enclosure->sysfs_path);
 		free(enclosure->dev_path);
 		free(enclosure);
@@ -48,6 +48,22 @@ struct enclosure_device {
 	char *dev_path;
 
 	struct ses_pages *ses_pages;
+
+  /**
+   * SCSI command in flight, see scsi.c.
+   */
+	struct ses_cmd *cmd;
+
+  /**
+   * Status of the last SEND DIAGNOSTIC command sent to the enclosure.
+   */
+	int flush_status;
+
+  /**
+   * Flag whether the pages are read only for status of the slots, so they are
+   * released instead of being sent, see scsi_ses_slot_refresh().
+   */
+	int status_pages;
 };
 
 /**
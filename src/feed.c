@@ -0,0 +1,285 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "feed.h"
+#include "utils.h"
+
+/**
+ * @brief Subscriber of the change feed.
+ *
+ * Records are kept in a ring buffer until the socket accepts them.
+ */
+struct feed_subscriber {
+	int fd;
+	char *queue;
+	size_t head;
+	size_t len;
+	unsigned long dropped;
+	unsigned long dropped_total;
+};
+
+static int feed_fd = -1;
+static char *feed_path;
+static struct feed_subscriber subscribers[FEED_MAX_SUBSCRIBERS];
+
+static void _close_subscriber(struct feed_subscriber *sub)
+{
+	log_info("feed: subscriber %d disconnected, %lu records dropped.",
+		 sub->fd, sub->dropped_total);
+	close(sub->fd);
+	free(sub->queue);
+	memset(sub, 0, sizeof(*sub));
+	sub->fd = -1;
+}
+
+static int _queue_put(struct feed_subscriber *sub, const char *buf, size_t n)
+{
+	size_t tail, chunk;
+
+	if (n > FEED_QUEUE_SIZE - sub->len)
+		return -1;
+	tail = (sub->head + sub->len) % FEED_QUEUE_SIZE;
+	chunk = MIN(n, FEED_QUEUE_SIZE - tail);
+	memcpy(sub->queue + tail, buf, chunk);
+	memcpy(sub->queue, buf + chunk, n - chunk);
+	sub->len += n;
+	return 0;
+}
+
+/**
+ * Sends as much of the queue as the socket accepts without blocking. Returns
+ * -1 if the subscriber has gone.
+ */
+static int _queue_flush(struct feed_subscriber *sub)
+{
+	ssize_t n;
+	size_t chunk;
+
+	while (sub->len) {
+		chunk = MIN(sub->len, FEED_QUEUE_SIZE - sub->head);
+		n = send(sub->fd, sub->queue + sub->head, chunk,
+			 MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n < 0)
+			return (errno == EAGAIN || errno == EWOULDBLOCK ||
+				errno == EINTR) ? 0 : -1;
+		sub->head = (sub->head + n) % FEED_QUEUE_SIZE;
+		sub->len -= n;
+	}
+	sub->head = 0;
+	return 0;
+}
+
+static void _queue_record(struct feed_subscriber *sub, const char *buf,
+			  size_t n)
+{
+	char drop[64];
+	int len;
+
+	if (sub->dropped) {
+		len = snprintf(drop, sizeof(drop), "DROPPED %lu\n",
+			       sub->dropped);
+		if (_queue_put(sub, drop, len) == 0)
+			sub->dropped = 0;
+	}
+	if (sub->dropped || _queue_put(sub, buf, n)) {
+		sub->dropped++;
+		sub->dropped_total++;
+	}
+}
+
+status_t feed_init(const char *path)
+{
+	struct sockaddr_un addr;
+	int i;
+
+	for (i = 0; i < FEED_MAX_SUBSCRIBERS; i++)
+		subscribers[i].fd = -1;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return STATUS_INVALID_PATH;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	str_cpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+	feed_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (feed_fd < 0)
+		return STATUS_FILE_OPEN_ERROR;
+	unlink(path);
+	if (bind(feed_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    chmod(path, 0660) || listen(feed_fd, FEED_MAX_SUBSCRIBERS)) {
+		log_error("feed: unable to create socket %s: %s", path,
+			  strerror(errno));
+		close(feed_fd);
+		feed_fd = -1;
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	feed_path = str_dup(path);
+	log_info("feed: publishing LED state changes on %s.", path);
+	return STATUS_SUCCESS;
+}
+
+void feed_fini(void)
+{
+	int i;
+
+	if (feed_fd < 0)
+		return;
+	for (i = 0; i < FEED_MAX_SUBSCRIBERS; i++) {
+		if (subscribers[i].fd >= 0)
+			_close_subscriber(&subscribers[i]);
+	}
+	close(feed_fd);
+	feed_fd = -1;
+	unlink(feed_path);
+	free(feed_path);
+	feed_path = NULL;
+}
+
+void feed_publish(const char *path, enum ibpi_pattern old,
+		  enum ibpi_pattern new, const char *reason)
+{
+	char buf[PATH_MAX + 128];
+	struct timespec ts;
+	int i, len;
+
+	if (feed_fd < 0)
+		return;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	len = snprintf(buf, sizeof(buf), "%llu\t%s\t%s\t%s\t%s\n",
+		       (unsigned long long)ts.tv_sec * 1000 +
+		       ts.tv_nsec / 1000000, path, ibpi2str(old),
+		       ibpi2str(new), reason);
+	if (len < 0 || len >= (int)sizeof(buf))
+		return;
+
+	for (i = 0; i < FEED_MAX_SUBSCRIBERS; i++) {
+		struct feed_subscriber *sub = &subscribers[i];
+
+		if (sub->fd < 0)
+			continue;
+		_queue_record(sub, buf, len);
+		if (_queue_flush(sub))
+			_close_subscriber(sub);
+	}
+}
+
+int feed_set_fds(fd_set *rdfds, fd_set *wrfds, int max_fd)
+{
+	int i;
+
+	if (feed_fd < 0)
+		return max_fd;
+
+	FD_SET(feed_fd, rdfds);
+	max_fd = MAX(max_fd, feed_fd + 1);
+	for (i = 0; i < FEED_MAX_SUBSCRIBERS; i++) {
+		struct feed_subscriber *sub = &subscribers[i];
+
+		if (sub->fd < 0)
+			continue;
+		FD_SET(sub->fd, rdfds);
+		if (sub->len)
+			FD_SET(sub->fd, wrfds);
+		max_fd = MAX(max_fd, sub->fd + 1);
+	}
+	return max_fd;
+}
+
+static void _accept_subscriber(void)
+{
+	struct feed_subscriber *sub = NULL;
+	int fd, i;
+
+	fd = accept4(feed_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+	for (i = 0; i < FEED_MAX_SUBSCRIBERS; i++) {
+		if (subscribers[i].fd < 0) {
+			sub = &subscribers[i];
+			break;
+		}
+	}
+	if (!sub) {
+		log_warning("feed: too many subscribers, connection refused.");
+		close(fd);
+		return;
+	}
+	sub->queue = malloc(FEED_QUEUE_SIZE);
+	if (!sub->queue) {
+		close(fd);
+		return;
+	}
+	sub->fd = fd;
+	log_info("feed: subscriber %d connected.", fd);
+}
+
+int feed_handle_fds(fd_set *rdfds, fd_set *wrfds)
+{
+	char buf[256];
+	int i, handled = 0;
+	ssize_t n;
+
+	if (feed_fd < 0)
+		return 0;
+
+	for (i = 0; i < FEED_MAX_SUBSCRIBERS; i++) {
+		struct feed_subscriber *sub = &subscribers[i];
+
+		if (sub->fd < 0)
+			continue;
+		if (FD_ISSET(sub->fd, wrfds)) {
+			handled++;
+			if (_queue_flush(sub)) {
+				_close_subscriber(sub);
+				continue;
+			}
+		}
+		if (FD_ISSET(sub->fd, rdfds)) {
+			/* subscribers are not expected to send anything */
+			handled++;
+			n = recv(sub->fd, buf, sizeof(buf), MSG_DONTWAIT);
+			if (n == 0 || (n < 0 && errno != EAGAIN &&
+				       errno != EWOULDBLOCK && errno != EINTR))
+				_close_subscriber(sub);
+		}
+	}
+	if (FD_ISSET(feed_fd, rdfds)) {
+		handled++;
+		_accept_subscriber();
+	}
+	return handled;
+}
@@ -0,0 +1,102 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _FEED_H_INCLUDED_
+#define _FEED_H_INCLUDED_
+
+#include <sys/select.h>
+
+#include "ibpi.h"
+#include "status.h"
+
+/**
+ * Maximum number of subscribers connected at the same time.
+ */
+#define FEED_MAX_SUBSCRIBERS	16
+
+/**
+ * Size of queue of each subscriber given in bytes.
+ */
+#define FEED_QUEUE_SIZE		65536
+
+/**
+ * @brief Creates change feed socket.
+ *
+ * The function creates a listening unix stream socket bound to the given
+ * path. Each subscriber connected to the socket receives one line per change
+ * of LED state:
+ *
+ *   <timestamp_ms> TAB <sysfs_path> TAB <old> TAB <new> TAB <reason> LF
+ *
+ * Records which do not fit into subscriber queue are dropped and reported by
+ * "DROPPED <count>" line as soon as the queue has room again.
+ *
+ * @param[in]    path            - path to the socket.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t feed_init(const char *path);
+
+/**
+ * @brief Closes feed socket and all subscriber connections.
+ *
+ * @return The function does not return a value.
+ */
+void feed_fini(void);
+
+/**
+ * @brief Queues a change record for all subscribers.
+ *
+ * The function never blocks. It does nothing if the feed is not enabled.
+ *
+ * @param[in]    path            - sysfs path of the block device.
+ * @param[in]    old             - previous IBPI pattern.
+ * @param[in]    new             - current IBPI pattern.
+ * @param[in]    reason          - short reason of the change.
+ *
+ * @return The function does not return a value.
+ */
+void feed_publish(const char *path, enum ibpi_pattern old,
+		  enum ibpi_pattern new, const char *reason);
+
+/**
+ * @brief Adds feed descriptors to select() sets.
+ *
+ * @param[in,out] rdfds          - set of descriptors checked for reading.
+ * @param[in,out] wrfds          - set of descriptors checked for writing.
+ * @param[in]     max_fd         - current highest descriptor plus one.
+ *
+ * @return The highest descriptor plus one.
+ */
+int feed_set_fds(fd_set *rdfds, fd_set *wrfds, int max_fd);
+
+/**
+ * @brief Handles ready feed descriptors.
+ *
+ * The function accepts new subscribers, sends queued records and closes
+ * connections of subscribers which have disconnected.
+ *
+ * @param[in]    rdfds           - set of descriptors ready for reading.
+ * @param[in]    wrfds           - set of descriptors ready for writing.
+ *
+ * @return Number of ready feed descriptors handled.
+ */
+int feed_handle_fds(fd_set *rdfds, fd_set *wrfds);
+
+#endif				/* _FEED_H_INCLUDED_ */
@@ -96,6 +96,25 @@ enum ibpi_pattern {
 	ibpi_pattern_count,
 };
 
+/**
+ * @brief Converts IBPI pattern to a bit of indication mask.
+ */
+#define IBPI_MASK(ibpi)		(1u << (ibpi))
+
+/**
+ * @brief Indications which can be shown together with other patterns.
+ *
+ * Locate, failure, predicted failure and rebuild are independent signals of a
+ * slot. Controllers which drive several LEDs of the slot in one write (SES,
+ * SGPIO of AHCI and SAS HBA, Dell backplane) show all of them at once, so
+ * e.g. a failed drive being located keeps both LEDs on. The other controllers
+ * show the pattern of the highest priority only.
+ */
+#define IBPI_INDICATIONS	(IBPI_MASK(IBPI_PATTERN_REBUILD) | \
+				 IBPI_MASK(IBPI_PATTERN_PFA) | \
+				 IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE) | \
+				 IBPI_MASK(IBPI_PATTERN_LOCATE))
+
 extern const char *ibpi_str[ibpi_pattern_count];
 
 #endif				/* _IBPI_H_INCLUDED_ */
@@ -19,6 +19,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
 #include <stdint.h>
@@ -43,9 +44,14 @@
 #include "config_file.h"
 #include "ibpi.h"
 #include "list.h"
+#include "pidfile.h"
+#include "plan.h"
+#include "probes.h"
 #include "scsi.h"
 #include "status.h"
 #include "sysfs.h"
+#include "timed.h"
+#include "topology.h"
 #include "utils.h"
 #include "version.h"
 
@@ -119,12 +125,50 @@ static int possible_params[] = {
 	OPT_QUIET,
 	OPT_WARNING,
 	OPT_LOG_LEVEL,
+	OPT_DUMP_TOPOLOGY,
+	OPT_DURATION,
+	OPT_DRY_RUN,
+	OPT_BENCH,
 };
 
 static const int possible_params_size = sizeof(possible_params)
 		/ sizeof(possible_params[0]);
 
 static int listed_only;
+static int dump_topology;
+
+/**
+ * Duration of patterns in seconds, 0 if patterns do not expire.
+ */
+static int duration;
+
+/**
+ * Flag whether to print transactions instead of sending them, see plan.h.
+ */
+static int dry_run;
+
+/**
+ * Flag whether devices are taken from topology snapshot of ledmon.
+ */
+static int use_snapshot;
+
+/**
+ * Number of rounds of latency benchmark, 0 if the benchmark is not run.
+ */
+static int bench_rounds;
+
+/**
+ * @brief Latency samples of LED transactions of single controller.
+ *
+ * Each sample is the time in milliseconds taken to send a pattern to a slot
+ * and to flush it to the hardware.
+ */
+struct bench_cntrl {
+	struct cntrl_device *cntrl;
+	double *samples;
+	int len;
+	int errors;
+};
 
 static void ibpi_state_fini(struct ibpi_state *p)
 {
@@ -189,6 +233,16 @@ static void _ledctl_help(void)
 			  "Ledctl will change state only for given devices.");
 	print_opt("--list-controllers", "-L",
 			  "Displays list of controllers detected by ledmon.");
+	print_opt("--dump-topology", "",
+			  "Prints topology manifest for TOPOLOGY_FILE of ledmon.");
+	print_opt("--dry-run", "",
+			  "Prints transactions instead of changing LEDs.");
+	print_opt("--duration=SECONDS", "",
+			  "Ledmon reverts the patterns after given time.");
+	print_opt("--bench=ROUNDS", "",
+			  "Measures latency of LED transactions per controller.");
+	print_opt("", "",
+			  "Locate and failure LEDs are restored afterwards.");
 	print_opt("--log=PATH", "-l PATH",
 			  "Use local log file instead /var/log/ledctl.log.");
 	print_opt("--help", "-h", "Displays this help text.");
@@ -260,10 +314,8 @@ static void _determine(struct ibpi_state *state)
 	if (list_is_empty(&state->block_list) == 0) {
 		struct block_device *block;
 
-		list_for_each(&state->block_list, block) {
-			if (block->ibpi < state->ibpi)
-				block->ibpi = state->ibpi;
-		}
+		list_for_each(&state->block_list, block)
+			block_add_indication(block, state->ibpi);
 	} else {
 		log_warning
 		    ("IBPI %s: missing block device(s)... pattern ignored.",
@@ -331,72 +383,11 @@ static struct ibpi_state *_ibpi_find(const struct list *ibpi_local_list,
 static struct ibpi_state *_ibpi_state_get(const char *name)
 {
 	struct ibpi_state *state = NULL;
-	enum ibpi_pattern ibpi;
 
-	if (strcmp(name, "locate") == 0) {
-		ibpi = IBPI_PATTERN_LOCATE;
-	} else if (strcmp(name, "locate_off") == 0) {
-		ibpi = IBPI_PATTERN_LOCATE_OFF;
-	} else if (strcmp(name, "normal") == 0) {
-		ibpi = IBPI_PATTERN_NORMAL;
-	} else if (strcmp(name, "off") == 0) {
-		ibpi = IBPI_PATTERN_NORMAL;
-	} else if ((strcmp(name, "ica") == 0) ||
-		   (strcmp(name, "degraded") == 0)) {
-		ibpi = IBPI_PATTERN_DEGRADED;
-	} else if (strcmp(name, "rebuild") == 0) {
-		ibpi = IBPI_PATTERN_REBUILD;
-	} else if ((strcmp(name, "ifa") == 0) ||
-		   (strcmp(name, "failed_array") == 0)) {
-		ibpi = IBPI_PATTERN_FAILED_ARRAY;
-	} else if (strcmp(name, "hotspare") == 0) {
-		ibpi = IBPI_PATTERN_HOTSPARE;
-	} else if (strcmp(name, "pfa") == 0) {
-		ibpi = IBPI_PATTERN_PFA;
-	} else if ((strcmp(name, "failure") == 0) ||
-		   (strcmp(name, "disk_failed") == 0)) {
-		ibpi = IBPI_PATTERN_FAILED_DRIVE;
-	} else if (strcmp(name, "ses_abort") == 0) {
-		ibpi = SES_REQ_ABORT;
-	} else if (strcmp(name, "ses_rebuild") == 0) {
-		ibpi = SES_REQ_REBUILD;
-	} else if (strcmp(name, "ses_ifa") == 0) {
-		ibpi = SES_REQ_IFA;
-	} else if (strcmp(name, "ses_ica") == 0) {
-		ibpi = SES_REQ_ICA;
-	} else if (strcmp(name, "ses_cons_check") == 0) {
-		ibpi = SES_REQ_CONS_CHECK;
-	} else if (strcmp(name, "ses_hotspare") == 0) {
-		ibpi = SES_REQ_HOSTSPARE;
-	} else if (strcmp(name, "ses_rsvd_dev") == 0) {
-		ibpi = SES_REQ_RSVD_DEV;
-	} else if (strcmp(name, "ses_ok") == 0) {
-		ibpi = SES_REQ_OK;
-	} else if (strcmp(name, "ses_ident") == 0) {
-		ibpi = SES_REQ_IDENT;
-	} else if (strcmp(name, "ses_rm") == 0) {
-		ibpi = SES_REQ_RM;
-	} else if (strcmp(name, "ses_insert") == 0) {
-		ibpi = SES_REQ_INS;
-	} else if (strcmp(name, "ses_missing") == 0) {
-		ibpi = SES_REQ_MISSING;
-	} else if (strcmp(name, "ses_dnr") == 0) {
-		ibpi = SES_REQ_DNR;
-	} else if (strcmp(name, "ses_active") == 0) {
-		ibpi = SES_REQ_ACTIVE;
-	} else if (strcmp(name, "ses_enable_bb") == 0) {
-		ibpi = SES_REQ_EN_BB;
-	} else if (strcmp(name, "ses_enable_ba") == 0) {
-		ibpi = SES_REQ_EN_BA;
-	} else if (strcmp(name, "ses_devoff") == 0) {
-		ibpi = SES_REQ_DEV_OFF;
-	} else if (strcmp(name, "ses_fault") == 0) {
-		ibpi = SES_REQ_FAULT;
-	} else if (strcmp(name, "ses_prdfail") == 0) {
-		ibpi = SES_REQ_PRDFAIL;
-	} else {
+	int ibpi = str2ibpi(name);
+
+	if (ibpi < 0)
 		return NULL;
-	}
 	state = _ibpi_find(&ibpi_list, ibpi);
 	if (state == NULL)
 		state = _ibpi_state_init(ibpi);
@@ -450,7 +441,11 @@ static status_t _ibpi_state_add_block(struct ibpi_state *state, char *name)
 	}
 	blk1 = _block_device_search(sysfs_get_block_devices(), path);
 	if (blk1 == NULL) {
-		log_error("%s: device not supported", name);
+		/* the device may be missing in outdated snapshot only */
+		if (use_snapshot)
+			log_debug("%s: device not in topology snapshot", name);
+		else
+			log_error("%s: device not supported", name);
 		return STATUS_NOT_SUPPORTED;
 	}
 	blk2 = _block_device_search(&state->block_list, path);
@@ -515,7 +510,9 @@ static status_t _cmdline_ibpi_parse(int argc, char *argv[])
 			}
 		}
 	}
-	if (_ibpi_state_determine(&ibpi_list) != STATUS_SUCCESS)
+	/* benchmark keeps the scanned state to restore it afterwards */
+	if (!bench_rounds &&
+	    _ibpi_state_determine(&ibpi_list) != STATUS_SUCCESS)
 		ret_status = STATUS_IBPI_DETERMINE_ERROR;
 	return ret_status;
 }
@@ -553,6 +550,25 @@ static status_t _cmdline_parse(int argc, char *argv[])
 				else
 					status = STATUS_CMDLINE_ERROR;
 				break;
+			case OPT_DUMP_TOPOLOGY:
+				dump_topology = 1;
+				break;
+			case OPT_DRY_RUN:
+				dry_run = 1;
+				break;
+			case OPT_DURATION:
+				if (str_toi(optarg, &duration, 1, INT_MAX)) {
+					log_error("Invalid duration: %s", optarg);
+					status = STATUS_CMDLINE_ERROR;
+				}
+				break;
+			case OPT_BENCH:
+				if (str_toi(optarg, &bench_rounds, 1, INT_MAX)) {
+					log_error("Invalid number of rounds: %s",
+						  optarg);
+					status = STATUS_CMDLINE_ERROR;
+				}
+				break;
 			default:
 				status = set_verbose_level(
 						possible_params[opt_index]);
@@ -597,6 +613,91 @@ static status_t _cmdline_parse(int argc, char *argv[])
 	return STATUS_SUCCESS;
 }
 
+/**
+ * @brief Loads topology snapshot published by ledmon.
+ *
+ * The snapshot is used only if it is owned by root and cannot be written by
+ * other users, so devices cannot be redirected by a planted file.
+ *
+ * @return 1 if ledmon is running and the snapshot has been loaded, otherwise 0.
+ */
+static int _ledctl_load_snapshot(void)
+{
+	int fd;
+
+	if (pidfile_check("ledmon", NULL) != STATUS_SUCCESS)
+		return 0;
+	/* only root can replace the file, LEDMON_RUN_DIR belongs to root */
+	fd = run_file_open(TOPOLOGY_SNAPSHOT_FILE, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	close(fd);
+	return topology_load(TOPOLOGY_SNAPSHOT_FILE) == STATUS_SUCCESS;
+}
+
+/**
+ * @brief Checks devices given in command line against the snapshot.
+ *
+ * @return 1 if all devices match the snapshot, otherwise 0.
+ */
+static int _ledctl_snapshot_valid(void)
+{
+	struct ibpi_state *state;
+	struct block_device *device;
+
+	list_for_each(&ibpi_list, state) {
+		list_for_each(&state->block_list, device) {
+			if (!topology_block_valid(device)) {
+				log_debug("%s: device has changed since topology snapshot",
+					  device->sysfs_path);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Finds devices and parses operands of command line.
+ *
+ * This is internal function of ledctl utility. If ledmon is running, devices
+ * are taken from topology snapshot it publishes and only the devices given in
+ * command line are checked. If the snapshot cannot be used, all devices are
+ * discovered by sysfs_scan(). See topology.h. The benchmark always discovers
+ * devices because slots whose LEDs cannot be read back are restored to the
+ * state determined from RAID devices.
+ *
+ * @param[in]      argc           number of elements in argv array.
+ * @param[in]      argv           command line arguments.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+static status_t _ledctl_scan(int argc, char *argv[])
+{
+	int first = optind;
+	status_t status;
+
+	if (!bench_rounds && _ledctl_load_snapshot()) {
+		use_snapshot = 1;
+		sysfs_scan_topology();
+		status = _cmdline_ibpi_parse(argc, argv);
+		use_snapshot = 0;
+		if (status == STATUS_SUCCESS && _ledctl_snapshot_valid() &&
+		    topology_snapshot_current()) {
+			topology_fini();
+			return STATUS_SUCCESS;
+		}
+		log_debug("Topology snapshot is outdated, discovering devices.");
+		/* the manifest must not be trusted by sysfs_scan() */
+		topology_fini();
+		list_erase(&ibpi_list);
+		sysfs_reset();
+		optind = first;
+	}
+	sysfs_scan();
+	return _cmdline_ibpi_parse(argc, argv);
+}
+
 /**
  * @brief Determine and send IBPI pattern.
  *
@@ -618,19 +719,284 @@ static status_t _ledctl_execute(struct list *ibpi_local_list)
 
 	if (!listed_only) {
 		list_for_each(sysfs_get_block_devices(), device)
-			device->send_fn(device, IBPI_PATTERN_LOCATE_OFF);
+			block_send_msg_sync(device, IBPI_PATTERN_LOCATE_OFF);
 	}
 
 	list_for_each(ibpi_local_list, state)
 		list_for_each(&state->block_list, device)
-			device->send_fn(device, device->ibpi);
+			block_send_msg_sync(device, device->ibpi);
 
 	list_for_each(sysfs_get_block_devices(), device)
-		device->flush_fn(device);
+		block_flush_msg_sync(device);
 
 	return STATUS_SUCCESS;
 }
 
+/**
+ * @brief Submits patterns given in command line to ledmon as timed ones.
+ *
+ * This is internal function of ledctl utility. The patterns have already been
+ * set, ledmon reverts them when the duration elapses. See timed.h.
+ *
+ * @param[in]      ibpi_local_list  list of IBPI patterns and their devices.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+static status_t _ledctl_submit_timed(struct list *ibpi_local_list)
+{
+	struct ibpi_state *state;
+	struct block_device *device;
+	const char **paths;
+	enum ibpi_pattern *ibpis;
+	status_t status;
+	int count = 0;
+
+	list_for_each(ibpi_local_list, state)
+		list_for_each(&state->block_list, device)
+			count++;
+	paths = calloc(count + 1, sizeof(*paths));
+	ibpis = calloc(count + 1, sizeof(*ibpis));
+	if (!paths || !ibpis) {
+		free(paths);
+		free(ibpis);
+		return STATUS_OUT_OF_MEMORY;
+	}
+	count = 0;
+	list_for_each(ibpi_local_list, state) {
+		list_for_each(&state->block_list, device) {
+			paths[count] = device->sysfs_path;
+			ibpis[count++] = state->ibpi;
+		}
+	}
+	status = timed_submit(paths, ibpis, count, duration);
+	if (status == STATUS_INVALID_STATE)
+		log_warning("ledmon is not running, patterns will not expire.");
+	else if (status != STATUS_SUCCESS)
+		log_error("Unable to submit timed patterns: %s",
+			  strstatus(status));
+	free(paths);
+	free(ibpis);
+	return status;
+}
+
+/**
+ * @brief Checks if the device is given for any pattern preceding the state.
+ */
+static int _bench_listed_before(const struct list *ibpi_local_list,
+				const struct ibpi_state *last,
+				const struct block_device *device)
+{
+	struct ibpi_state *state;
+
+	list_for_each(ibpi_local_list, state) {
+		if (state == last)
+			break;
+		if (_block_device_search(&state->block_list,
+					 device->sysfs_path))
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Restores the slot after the benchmark.
+ *
+ * Locate and Failure LEDs recorded before the benchmark are set again, the
+ * other indications come from RAID devices. A slot whose LEDs cannot be read
+ * back gets the state determined from its RAID devices, as ledmon sets it.
+ *
+ * @param[in]      device         block device of the slot.
+ * @param[in]      leds           LEDs recorded by block_get_leds().
+ */
+static void _bench_restore(struct block_device *device, int leds)
+{
+	unsigned int own = IBPI_MASK(IBPI_PATTERN_LOCATE) |
+			   IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE);
+	enum ibpi_pattern ibpi = device->ibpi;
+	unsigned int mask;
+
+	if (ibpi == IBPI_PATTERN_UNKNOWN)
+		ibpi = IBPI_PATTERN_NORMAL;
+	if (leds >= 0) {
+		mask = (device->ibpi_mask & ~own) | (unsigned int)leds;
+		if (ibpi == IBPI_PATTERN_FAILED_DRIVE ||
+		    ibpi == IBPI_PATTERN_LOCATE ||
+		    ibpi == IBPI_PATTERN_LOCATE_OFF)
+			ibpi = IBPI_PATTERN_NORMAL;
+		device->ibpi = ibpi;
+		device->ibpi_mask = 0;
+		for (ibpi = IBPI_PATTERN_NORMAL; ibpi <= IBPI_PATTERN_LOCATE_OFF;
+		     ibpi++) {
+			if (mask & IBPI_MASK(ibpi))
+				block_add_indication(device, ibpi);
+		}
+		ibpi = device->ibpi;
+	}
+	if (block_send_msg_sync(device, ibpi) == 0)
+		block_flush_msg_sync(device);
+}
+
+static void _bench_cntrl_fini(struct bench_cntrl *bc)
+{
+	free(bc->samples);
+	free(bc);
+}
+
+/**
+ * @brief Gets samples of the controller, allocates them on first use.
+ *
+ * @param[in]      results        list of samples of all controllers.
+ * @param[in]      cntrl          controller of the slot.
+ * @param[in]      size           maximum number of samples of the controller.
+ *
+ * @return Pointer to the samples or NULL if out of memory.
+ */
+static struct bench_cntrl *_bench_cntrl_get(struct list *results,
+					    struct cntrl_device *cntrl,
+					    int size)
+{
+	struct bench_cntrl *bc;
+
+	list_for_each(results, bc) {
+		if (bc->cntrl == cntrl)
+			return bc;
+	}
+	bc = calloc(1, sizeof(*bc));
+	if (!bc)
+		return NULL;
+	bc->samples = calloc(size, sizeof(*bc->samples));
+	if (!bc->samples) {
+		free(bc);
+		return NULL;
+	}
+	bc->cntrl = cntrl;
+	list_append(results, bc);
+	return bc;
+}
+
+static int _bench_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double _bench_percentile(double *v, int len, int p)
+{
+	int i;
+
+	if (len == 0)
+		return 0.0;
+	i = (len * p + 99) / 100 - 1;
+	return v[i < 0 ? 0 : i];
+}
+
+static void _bench_report(struct list *results)
+{
+	struct bench_cntrl *bc;
+
+	printf("%-48s %-9s %7s %6s %9s %9s %9s %9s\n", "controller", "type",
+	       "xfers", "errors", "p50[ms]", "p90[ms]", "p99[ms]", "max[ms]");
+	list_for_each(results, bc) {
+		qsort(bc->samples, bc->len, sizeof(*bc->samples), _bench_cmp);
+		printf("%-48s %-9s %7d %6d %9.3f %9.3f %9.3f %9.3f\n",
+		       bc->cntrl ? bc->cntrl->sysfs_path : "?",
+		       cntrl_type_name(bc->cntrl ? bc->cntrl->cntrl_type :
+				       CNTRL_TYPE_UNKNOWN),
+		       bc->len, bc->errors,
+		       _bench_percentile(bc->samples, bc->len, 50),
+		       _bench_percentile(bc->samples, bc->len, 90),
+		       _bench_percentile(bc->samples, bc->len, 99),
+		       bc->len ? bc->samples[bc->len - 1] : 0.0);
+	}
+	fflush(stdout);
+}
+
+/**
+ * @brief Measures latency of LED transactions per controller.
+ *
+ * This is internal function of ledctl utility. Patterns given in command line
+ * are sent to their devices in command line order and the sequence is
+ * repeated given number of rounds. Each pattern is flushed to the hardware
+ * separately, so every sample is a complete transaction through the backend
+ * of the controller. Other slots are not touched. Locate and Failure LEDs of
+ * the slots are recorded before the run and restored afterwards, see
+ * _bench_restore().
+ *
+ * @param[in]      ibpi_local_list  list of IBPI patterns and their devices.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+static status_t _ledctl_bench(struct list *ibpi_local_list)
+{
+	struct list results;
+	struct ibpi_state *state;
+	struct block_device *device;
+	struct bench_cntrl *bc;
+	status_t status = STATUS_SUCCESS;
+	uint64_t start;
+	int round, size = 0, err, i;
+	int *leds;
+
+	list_for_each(ibpi_local_list, state)
+		list_for_each(&state->block_list, device)
+			size++;
+	if (size == 0) {
+		log_error("missing operand(s)... run %s --help for details.",
+			  progname);
+		return STATUS_LIST_EMPTY;
+	}
+	if (size > INT_MAX / bench_rounds) {
+		log_error("Too many rounds of benchmark: %d", bench_rounds);
+		return STATUS_CMDLINE_ERROR;
+	}
+	leds = calloc(size, sizeof(*leds));
+	if (!leds)
+		return STATUS_OUT_OF_MEMORY;
+	i = 0;
+	list_for_each(ibpi_local_list, state) {
+		list_for_each(&state->block_list, device) {
+			if (!_bench_listed_before(ibpi_local_list, state,
+						  device))
+				leds[i++] = block_get_leds(device);
+		}
+	}
+	size *= bench_rounds;
+	list_init(&results, (item_free_t)_bench_cntrl_fini);
+	for (round = 0; round < bench_rounds && !status; round++) {
+		list_for_each(ibpi_local_list, state) {
+			list_for_each(&state->block_list, device) {
+				bc = _bench_cntrl_get(&results, device->cntrl,
+						      size);
+				if (!bc) {
+					status = STATUS_OUT_OF_MEMORY;
+					break;
+				}
+				start = get_monotonic_us();
+				err = block_send_msg_sync(device, state->ibpi);
+				if (!err)
+					err = block_flush_msg_sync(device);
+				bc->samples[bc->len++] =
+					(get_monotonic_us() - start) / 1000.0;
+				if (err)
+					bc->errors++;
+			}
+		}
+	}
+	i = 0;
+	list_for_each(ibpi_local_list, state) {
+		list_for_each(&state->block_list, device) {
+			if (!_bench_listed_before(ibpi_local_list, state,
+						  device))
+				_bench_restore(device, leds[i++]);
+		}
+	}
+	free(leds);
+	_bench_report(&results);
+	list_erase(&results);
+	return status;
+}
+
 static status_t _read_shared_conf(void)
 {
 	status_t status;
@@ -651,6 +1017,8 @@ static status_t _init_ledctl_conf(void)
 	conf.log_level = LOG_LEVEL_WARNING;
 	list_init(&conf.cntrls_whitelist, NULL);
 	list_init(&conf.cntrls_blacklist, NULL);
+	list_init(&conf.cntrls_interval, NULL);
+	list_init(&conf.cntrls_flush_delay, NULL);
 
 	return set_log_path(LEDCTL_DEF_LOG_FILE);
 }
@@ -693,6 +1061,10 @@ int main(int argc, char *argv[])
 		exit(STATUS_ONEXIT_ERROR);
 	if (_cmdline_parse(argc, argv))
 		exit(STATUS_CMDLINE_ERROR);
+	if (bench_rounds && duration) {
+		log_error("--bench cannot be used together with --duration.");
+		exit(STATUS_CMDLINE_ERROR);
+	}
 	free(shortopt);
 	free(longopt);
 	status = _read_shared_conf();
@@ -704,12 +1076,35 @@ int main(int argc, char *argv[])
 
 	list_init(&ibpi_list, (item_free_t)ibpi_state_fini);
 	sysfs_init();
-	sysfs_scan();
-	status = _cmdline_ibpi_parse(argc, argv);
+	if (dump_topology) {
+		/* controllers are filtered as configured for ledmon */
+		sysfs_scan();
+		status = topology_dump(stdout);
+		sysfs_reset();
+		exit(status);
+	}
+	status = _ledctl_scan(argc, argv);
 	if (status != STATUS_SUCCESS) {
 		log_debug("main(): _ibpi_parse() failed (status=%s).",
 			  strstatus(status));
 		exit(status);
 	}
-	return _ledctl_execute(&ibpi_list);
+	if (dry_run)
+		plan_begin();
+	if (bench_rounds) {
+		/* the transactions are not printed in dry run */
+		status = _ledctl_bench(&ibpi_list);
+		plan_fini();
+		return status;
+	}
+	status = _ledctl_execute(&ibpi_list);
+	plan_stats_save();
+	if (dry_run) {
+		plan_print(stdout);
+		plan_fini();
+		return status;
+	}
+	if (status == STATUS_SUCCESS && duration)
+		status = _ledctl_submit_timed(&ibpi_list);
+	return status;
 }
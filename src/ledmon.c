@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <signal.h>
 #include <stdint.h>
@@ -39,24 +40,47 @@
 #include <dmalloc.h>
 #endif
 
+#include "activity.h"
 #include "ahci.h"
 #include "block.h"
+#include "cadence.h"
 #include "cntrl.h"
 #include "config.h"
 #include "config_file.h"
+#include "feed.h"
 #include "ibpi.h"
 #include "list.h"
 #include "pidfile.h"
+#include "plan.h"
+#include "priority.h"
+#include "probes.h"
 #include "raid.h"
 #include "scsi.h"
+#include "ses.h"
 #include "slave.h"
 #include "smp.h"
+#include "state.h"
 #include "status.h"
 #include "sysfs.h"
+#include "timed.h"
+#include "topology.h"
 #include "udev.h"
 #include "utils.h"
 #include "version.h"
 #include "vmdssd.h"
+#include "xfer.h"
+
+/**
+ * Delay (in milliseconds) before the first retry of a LED message which could
+ * not be applied. The delay is doubled with each subsequent attempt.
+ */
+#define LEDMON_RETRY_DELAY_MS		500
+
+/**
+ * Maximum number of attempts to apply an IBPI pattern to a device. After that
+ * the pattern is considered as sent and it is not retried anymore.
+ */
+#define LEDMON_RETRY_MAX_ATTEMPTS	5
 
 /**
  * @brief List of active block devices.
@@ -75,6 +99,11 @@ static struct list ledmon_block_list;
  */
 static sig_atomic_t terminate;
 
+/**
+ * This flag indicates that ledctl has submitted timed patterns, see timed.h.
+ */
+static sig_atomic_t timed_pending;
+
 /**
  * @brief Path to ledmon configuration file.
  *
@@ -92,6 +121,27 @@ static char *ledmon_conf_path;
  */
 static int foreground;
 
+/**
+ * @brief Boolean flag whether to print transactions instead of sending them.
+ *
+ * This flag is turned on with --dry-run option, see plan.h.
+ */
+static int dry_run;
+
+/**
+ * @brief Boolean flag whether to reconcile LED state once and exit.
+ *
+ * This flag is turned on with --once option, see state.h.
+ */
+static int once;
+
+/**
+ * Number of devices whose new state has been applied and number of devices
+ * whose state could not be applied in a single-shot run.
+ */
+static int once_applied;
+static int once_failed;
+
 /**
  * @brief Name of IBPI patterns.
  *
@@ -143,6 +193,8 @@ static int possible_params[] = {
 	OPT_WARNING,
 	OPT_LOG_LEVEL,
 	OPT_FOREGROUND,
+	OPT_DRY_RUN,
+	OPT_ONCE,
 };
 
 static int possible_params_size = sizeof(possible_params)
@@ -164,7 +216,13 @@ static int possible_params_size = sizeof(possible_params)
 static void _ledmon_fini(int __attribute__ ((unused)) status, void *program_name)
 {
 	sysfs_reset();
+	cadence_fini();
+	topology_fini();
+	topology_unpublish();
+	timed_fini();
+	unlink(TIMED_REQUEST_FILE);
 	list_erase(&ledmon_block_list);
+	feed_fini();
 	log_close();
 	pidfile_remove(program_name);
 }
@@ -247,6 +305,10 @@ static void _ledmon_help(void)
 			  "Use local log file instead /var/log/ledmon.log");
 	print_opt("--log-level=VALUE", "-l VALUE",
 			  "Allows user to set ledmon verbose level in logs.");
+	print_opt("--dry-run", "",
+			  "Print transactions of the first scan and exit.");
+	print_opt("--once", "",
+			  "Apply the state of devices once and exit.");
 	print_opt("--foreground", "",
 			  "Do not run as daemon.");
 	print_opt("--help", "-h", "Displays this help text.");
@@ -377,6 +439,12 @@ static status_t _cmdline_parse(int argc, char *argv[])
 			case OPT_FOREGROUND:
 				foreground = 1;
 				break;
+			case OPT_DRY_RUN:
+				dry_run = 1;
+				break;
+			case OPT_ONCE:
+				once = 1;
+				break;
 			default:
 				status = set_verbose_level(
 						possible_params[opt_index]);
@@ -414,13 +482,29 @@ static void _ledmon_sig_term(int signum)
 	}
 }
 
+/**
+ * @brief SIGUSR1 handler function.
+ *
+ * This is internal function of monitor service.
+ *
+ * @param[in]    signum          - the number of signal received.
+ *
+ * @return The function does not return a value.
+ */
+static void _ledmon_sig_usr1(int signum)
+{
+	if (signum == SIGUSR1)
+		timed_pending = 1;
+}
+
 /**
  * @brief Configures signal handlers.
  *
  * This is internal function of monitor services. It sets to ignore SIGALRM,
  * SIGHUP and SIGPIPE signals. The function installs a handler for SIGTERM
  * signal. User must send SIGTERM to daemon process in order to shutdown the
- * daemon gently.
+ * daemon gently. SIGUSR1 is sent by ledctl when it submits timed patterns. It
+ * stays blocked until the daemon waits, so it never interrupts a scan.
  *
  * @return The function does not return a value.
  */
@@ -445,52 +529,452 @@ static void _ledmon_setup_signals(void)
 	sigaction(SIGPIPE, &act, NULL);
 	act.sa_handler = _ledmon_sig_term;
 	sigaction(SIGTERM, &act, NULL);
+	act.sa_handler = _ledmon_sig_usr1;
 	sigaction(SIGUSR1, &act, NULL);
 
+	sigdelset(&sigset, SIGUSR1);
 	sigprocmask(SIG_UNBLOCK, &sigset, NULL);
 }
 
+/**
+ * @brief Schedules the next attempt to send LED message.
+ *
+ * This is internal function of monitor service. The function is called when
+ * the current IBPI pattern of the device could not be applied. It increments
+ * the attempt counter and computes the time of the next attempt using
+ * exponential backoff. If the limit of attempts is reached the pattern is
+ * considered as sent and the device is not retried until its state changes.
+ *
+ * @param[in]    block            Pointer to block device structure.
+ *
+ * @return The function does not return a value.
+ */
+static void _schedule_retry(struct block_device *block)
+{
+	uint64_t delay;
+
+	block->send_attempts++;
+	if (block->send_attempts >= LEDMON_RETRY_MAX_ATTEMPTS) {
+		log_warning("Unable to set '%s' on %s after %d attempts.",
+			    ibpi2str(block->ibpi), block->sysfs_path,
+			    block->send_attempts);
+		block->ibpi_mask_prev = block_indications(block, block->ibpi);
+		block->ibpi_prev = block->ibpi;
+		block->send_attempts = 0;
+		block->retry_time = 0;
+		once_failed++;
+		return;
+	}
+	delay = (uint64_t)LEDMON_RETRY_DELAY_MS << (block->send_attempts - 1);
+	block->retry_time = get_monotonic_ms() + delay;
+	log_debug("RETRY %s: '%s' in %" PRIu64 " ms (attempt %d).",
+		  block->sysfs_path, ibpi2str(block->ibpi), delay,
+		  block->send_attempts + 1);
+}
+
+/**
+ * @brief Sends LED control message.
+ *
+ * This is internal function of monitor service. The function sends a LED
+ * command to storage controller or enclosure device. The function checks
+ * the time of last modification of block device structure. If the timestamp
+ * is different then the current global timestamp this means the device is
+ * missing due to hot-remove or hardware failure so it must be reported on
+ * LEDs appropriately. Note that controller device and host attached to this
+ * block device points to invalid pointer so it must be 'refreshed'.
+ *
+ * Devices in UNKNOWN state are not managed and nothing is sent to them.
+ * If the message cannot be sent the next attempt is scheduled. The previous
+ * state of the device is not updated until the message is flushed. A message
+ * which is a multi-step transaction in flight is continued, see xfer.h.
+ *
+ * @param[in]    block            Pointer to block device structure.
+ *
+ * @return The function does not return a value.
+ */
+static void _send_msg(struct block_device *block)
+{
+	block->retry_time = 0;
+	if (!block->cntrl) {
+		log_debug("Missing cntrl for dev: %s. Not sending anything.",
+			  strstr(block->sysfs_path, "host"));
+		return;
+	}
+	if (block->timestamp != timestamp ||
+	    block->ibpi == IBPI_PATTERN_REMOVED) {
+		/* Activity LED of empty slot is given back to the hardware */
+		block->activity = ACTIVITY_HW;
+		if (block->ibpi != IBPI_PATTERN_FAILED_DRIVE) {
+			log_info("CHANGE %s: from '%s' to '%s'.",
+				 block->sysfs_path, ibpi2str(block->ibpi),
+				 ibpi2str(IBPI_PATTERN_FAILED_DRIVE));
+			feed_publish(block->sysfs_path, block->ibpi,
+				     IBPI_PATTERN_FAILED_DRIVE, "detached");
+			block->ibpi = IBPI_PATTERN_FAILED_DRIVE;
+			block->ibpi_mask = 0;
+			/* failure found by the scan is urgent as well */
+			priority_boost();
+		} else {
+			char *host = strstr(block->sysfs_path, "host");
+			log_debug("DETACHED DEV '%s' in failed state",
+				  host ? host : block->sysfs_path);
+		}
+	}
+	/* LEDs of the device are not managed, nothing to send or retry */
+	if (block->ibpi < IBPI_PATTERN_NORMAL) {
+		block->ibpi_prev = block->ibpi;
+		block->ibpi_mask_prev = 0;
+		block->send_attempts = 0;
+		return;
+	}
+	if (block_send_msg(block, block->ibpi) &&
+	    block_state_changed(block, block->ibpi))
+		_schedule_retry(block);
+}
+
+/**
+ * @brief Checks if flushing of LED control message is deferred.
+ *
+ * This is internal function of monitor service. The first change of a device
+ * opens coalescing window of its controller, so changes of other slots which
+ * come within the window are flushed together in one transaction. A device
+ * joins the window already opened by another device of the same controller.
+ * Failed drives are never deferred, neither are messages on termination and
+ * in single-shot run.
+ *
+ * @param[in]    block            Pointer to block device structure.
+ *
+ * @return 1 if the message is flushed later, otherwise 0.
+ */
+static int _flush_deferred(struct block_device *block)
+{
+	struct block_device *device;
+	uint64_t now, delay;
+
+	if (!block_state_changed(block, block->ibpi) || block->retry_time ||
+	    block->ibpi == IBPI_PATTERN_FAILED_DRIVE ||
+	    (block->ibpi_mask & IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE)) ||
+	    terminate || once ||
+	    plan_active()) {
+		block->flush_time = 0;
+		return 0;
+	}
+	now = get_monotonic_ms();
+	if (!block->flush_time) {
+		delay = cadence_flush_delay(block->cntrl->sysfs_path,
+					    block->cntrl->cntrl_type);
+		if (!delay)
+			return 0;
+		block->flush_time = now + delay;
+		list_for_each(&ledmon_block_list, device) {
+			if (device->flush_time && device->cntrl &&
+			    device->flush_time < block->flush_time &&
+			    !strcmp(device->cntrl->sysfs_path,
+				    block->cntrl->sysfs_path))
+				block->flush_time = device->flush_time;
+		}
+		log_debug("DEFER %s: '%s' for %" PRIu64 " ms.",
+			  block->sysfs_path, ibpi2str(block->ibpi),
+			  block->flush_time > now ? block->flush_time - now : 0);
+	}
+	if (now < block->flush_time)
+		return 1;
+	block->flush_time = 0;
+	return 0;
+}
+
+/**
+ * @brief Flushes LED control message.
+ *
+ * This is internal function of monitor service. The function flushes messages
+ * buffered by the controller of the device. If the device has changed its
+ * state and both send and flush succeeded the current state becomes the
+ * previous one, otherwise the next attempt is scheduled. Devices with
+ * transaction in flight are flushed once the transaction is complete and
+ * devices within coalescing window when the window is closed. A flush which
+ * is in flight is continued once its next step is due.
+ *
+ * @param[in]    block            Pointer to block device structure.
+ *
+ * @return The function does not return a value.
+ */
+static void _flush_msg(struct block_device *block)
+{
+	int status;
+
+	if (!block->cntrl)
+		return;
+	if (xfer_flushing(block)) {
+		if (block->xfer_time > get_monotonic_us())
+			return;
+	} else if (xfer_pending(block) || _flush_deferred(block)) {
+		return;
+	}
+	status = block_flush_msg(block);
+
+	/* The flush is still in flight. */
+	if (status == 0 && xfer_flushing(block))
+		return;
+
+	/* Nothing has been sent or sending failed and is already scheduled. */
+	if (!block_state_changed(block, block->ibpi) || block->retry_time)
+		return;
+	if (status) {
+		_schedule_retry(block);
+	} else {
+		block->ibpi_mask_prev = block_indications(block, block->ibpi);
+		block->ibpi_prev = block->ibpi;
+		block->send_attempts = 0;
+		once_applied++;
+	}
+}
+
+/**
+ * @brief Fails devices whose slots are empty or broken.
+ *
+ * This is internal function of monitor service. Enclosures which have been
+ * sent a message in this cycle report status of their slots. A drive which
+ * has been pulled or has died is reported by the enclosure before the kernel
+ * removes the block device, e.g. during SAS link recovery. Such devices are
+ * failed at once and the pattern is sent with the messages already buffered,
+ * so no extra command is sent to the enclosure. The verdict is kept across
+ * scans until the slot reports the drive again or the device goes away. Once
+ * the pattern has been sent nothing is written to the enclosure, so each scan
+ * reads the status of failed slots again, see scsi_ses_slot_refresh(), and
+ * the status is checked when the read is complete.
+ *
+ * @param[in]    refresh         - 1 to read status of failed slots again.
+ *
+ * @return The function does not return a value.
+ */
+static void _ledmon_check_slots(int refresh)
+{
+	struct block_device *device;
+
+	list_for_each(&ledmon_block_list, device) {
+		if (!device->cntrl ||
+		    device->cntrl->cntrl_type != CNTRL_TYPE_SCSI)
+			continue;
+		switch (scsi_ses_slot_status(device, timestamp)) {
+		case SES_STATUS_UNRECOVERABLE:
+		case SES_STATUS_NOT_INSTALLED:
+			break;
+		case -1:
+			/* the slot has not been read by this scan */
+			if (refresh && device->slot_failed)
+				scsi_ses_slot_refresh(device);
+			continue;
+		default:
+			if (device->slot_failed)
+				log_info("SLOT %s: drive reported again.",
+					 device->sysfs_path);
+			device->slot_failed = 0;
+			continue;
+		}
+		device->slot_failed = 1;
+		if (device->ibpi == IBPI_PATTERN_FAILED_DRIVE)
+			continue;
+		log_info("CHANGE %s: from '%s' to '%s'.", device->sysfs_path,
+			 ibpi2str(device->ibpi),
+			 ibpi2str(IBPI_PATTERN_FAILED_DRIVE));
+		PROBE3(state_change, device->sysfs_path, device->ibpi,
+		       IBPI_PATTERN_FAILED_DRIVE);
+		feed_publish(device->sysfs_path, device->ibpi,
+			     IBPI_PATTERN_FAILED_DRIVE, "slot status");
+		device->ibpi = IBPI_PATTERN_FAILED_DRIVE;
+		device->ibpi_mask = 0;
+		priority_boost();
+		_send_msg(device);
+	}
+}
+
+/**
+ * @brief Checks if urgent LED message is pending.
+ *
+ * This is internal function of monitor service. Failure and locate patterns
+ * are urgent and they are sent with raised scheduling and I/O priority.
+ * Drives found failed while the messages are sent, detached ones or slots
+ * reported by an enclosure, raise the priority on their own.
+ *
+ * @return 1 if any device waits for failure or locate pattern, otherwise 0.
+ */
+static int _ledmon_urgent(void)
+{
+	struct block_device *device;
+
+	list_for_each(&ledmon_block_list, device) {
+		if (!block_state_changed(device, device->ibpi))
+			continue;
+		if (device->ibpi == IBPI_PATTERN_FAILED_DRIVE ||
+		    device->ibpi == IBPI_PATTERN_LOCATE)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Gets time of the nearest pending retry, flush or transaction step.
+ *
+ * @param[in]    deadline         Time limit given in microseconds of monotonic
+ *                                clock.
+ *
+ * @return Time of the nearest retry, flush or step or deadline if it comes
+ * earlier.
+ */
+static uint64_t _ledmon_next_retry(uint64_t deadline)
+{
+	struct block_device *device;
+
+	list_for_each(&ledmon_block_list, device) {
+		if (device->retry_time && device->retry_time * 1000 < deadline)
+			deadline = device->retry_time * 1000;
+		if (device->flush_time && device->flush_time * 1000 < deadline)
+			deadline = device->flush_time * 1000;
+		if (device->xfer_time && device->xfer_time < deadline)
+			deadline = device->xfer_time;
+	}
+	return deadline;
+}
+
+/**
+ * @brief Reverts a device whose timed pattern has expired.
+ *
+ * This is internal function of monitor service. The device still shows the
+ * pattern set by ledctl, so the pattern becomes the previous state and the
+ * state computed by ledmon is sent again.
+ *
+ * @param[in]    path             Sysfs path of the block device.
+ * @param[in]    ibpi             The pattern which has expired.
+ *
+ * @return The function does not return a value.
+ */
+static void _ledmon_timed_expired(const char *path, enum ibpi_pattern ibpi)
+{
+	struct block_device *device;
+
+	list_for_each(&ledmon_block_list, device) {
+		if (strcmp(device->sysfs_path, path) != 0)
+			continue;
+		log_info("EXPIRED %s: from '%s' to '%s'.", path, ibpi2str(ibpi),
+			 ibpi2str(device->ibpi));
+		device->ibpi_prev = ibpi;
+		device->ibpi_mask_prev = 0;
+		device->send_attempts = 0;
+		_send_msg(device);
+		break;
+	}
+}
+
+/**
+ * @brief Resends LED messages which are due to be retried.
+ *
+ * This is internal function of monitor service. Controllers and hosts of the
+ * devices are valid until the end of current scan, so the messages are sent
+ * exactly the same way as in _ledmon_execute(). Transactions waiting for the
+ * next step are continued as well. Devices whose timed patterns have expired
+ * are reverted, so all of them are flushed at once.
+ *
+ * @return The function does not return a value.
+ */
+static void _ledmon_retry(void)
+{
+	uint64_t now = get_monotonic_us();
+	struct block_device *device;
+
+	if (_ledmon_urgent())
+		priority_boost();
+	timed_expire(now / 1000, _ledmon_timed_expired);
+	list_for_each(&ledmon_block_list, device) {
+		if ((device->retry_time && device->retry_time * 1000 <= now) ||
+		    (device->xfer_time && device->xfer_time <= now &&
+		     !xfer_flushing(device)))
+			_send_msg(device);
+	}
+	/* Status of failed slots read again, or of slots written by retries. */
+	_ledmon_check_slots(0);
+	list_for_each(&ledmon_block_list, device)
+		_flush_msg(device);
+	priority_restore();
+}
+
 /**
  * @brief Puts the calling process into sleep.
  *
  * This is internal function of monitor service. The function puts the calling
- * process into a sleep for the given amount of time (expressed in seconds). The
- * function will give control back to the process as soon as time elapses or
- * SIGTERM occurs.
+ * process into a sleep for the given amount of time (expressed in ms) or
+ * until a controller is due to be refreshed. The function will give control
+ * back to the process as soon as time elapses or SIGTERM occurs. Pending
+ * retries of LED messages are sent and timed patterns are expired while
+ * waiting. Activity LEDs are updated on each tick, see activity.h.
  *
- * @param[in]    seconds         - the time interval given in seconds.
+ * @param[in]    interval_ms     - the time interval given in milliseconds.
  *
  * @return The function does not return a value.
  */
-static void _ledmon_wait(int seconds)
+static void _ledmon_wait(uint64_t interval_ms)
 {
 	int fd, udev_fd, max_fd, res;
-	fd_set rdfds, exfds;
+	fd_set rdfds, wrfds, exfds;
 	struct timespec timeout;
 	sigset_t sigset;
+	uint64_t now, wakeup, deadline, refresh, expiry, tick;
 
 	sigprocmask(SIG_UNBLOCK, NULL, &sigset);
 	sigdelset(&sigset, SIGTERM);
-	timeout.tv_nsec = 0;
-	timeout.tv_sec = seconds;
+	sigdelset(&sigset, SIGUSR1);
+	deadline = get_monotonic_us() + interval_ms * 1000;
+	refresh = cadence_next() * 1000;
+	if (refresh && refresh < deadline)
+		deadline = refresh;
 
 	fd = open("/proc/mdstat", O_RDONLY);
 	udev_fd = get_udev_monitor();
-	max_fd = MAX(fd, udev_fd) + 1;
 	do {
 		FD_ZERO(&rdfds);
+		FD_ZERO(&wrfds);
 		FD_ZERO(&exfds);
 
 		if (fd > 0)
 			FD_SET(fd, &exfds);
 		if (udev_fd > 0)
 			FD_SET(udev_fd, &rdfds);
-
-		res = pselect(max_fd, &rdfds, NULL, &exfds, &timeout, &sigset);
-		if (terminate || !FD_ISSET(udev_fd, &rdfds) ||
+		max_fd = feed_set_fds(&rdfds, &wrfds, MAX(fd, udev_fd) + 1);
+
+		now = get_monotonic_us();
+		wakeup = _ledmon_next_retry(deadline);
+		expiry = timed_next() * 1000;
+		if (expiry && expiry < wakeup)
+			wakeup = expiry;
+		tick = activity_next();
+		if (tick && tick < wakeup)
+			wakeup = tick;
+		if (wakeup < now)
+			wakeup = now;
+		timeout.tv_sec = (wakeup - now) / 1000000;
+		timeout.tv_nsec = ((wakeup - now) % 1000000) * 1000;
+
+		res = pselect(max_fd, &rdfds, &wrfds, &exfds, &timeout,
+			      &sigset);
+		if (terminate)
+			break;
+		if (res < 0 && errno == EINTR && timed_pending) {
+			timed_pending = 0;
+			timed_load();
+			continue;
+		}
+		if (res == 0) {
+			if (get_monotonic_us() >= deadline)
+				break;
+			activity_tick();
+			_ledmon_retry();
+			continue;
+		}
+		if (res > 0 && feed_handle_fds(&rdfds, &wrfds) == res)
+			continue;
+		if (res < 0 || !FD_ISSET(udev_fd, &rdfds) ||
 		    handle_udev_event(&ledmon_block_list) <= 0)
 			break;
-	} while (res > 0);
+	} while (1);
 
 	if (fd >= 0)
 		close(fd);
@@ -661,7 +1145,18 @@ static void _add_block(struct block_device *block)
 		}
 
 		_handle_fail_state(block, temp);
+		/* indications found by the scan belong to its pattern only */
+		temp->ibpi_mask = temp->ibpi == block->ibpi ? block->ibpi_mask : 0;
+		/* the verdict of the slot overrides the RAID state */
+		if (temp->slot_failed) {
+			temp->ibpi = IBPI_PATTERN_FAILED_DRIVE;
+			temp->ibpi_mask = 0;
+		}
 
+		if (ibpi != temp->ibpi) {
+			PROBE3(state_change, temp->sysfs_path, ibpi, temp->ibpi);
+			feed_publish(temp->sysfs_path, ibpi, temp->ibpi, "scan");
+		}
 		if (ibpi != temp->ibpi && ibpi <= IBPI_PATTERN_REMOVED) {
 			log_info("CHANGE %s: from '%s' to '%s'.",
 				 temp->sysfs_path, ibpi2str(ibpi),
@@ -680,57 +1175,15 @@ static void _add_block(struct block_device *block)
 		if (temp != NULL) {
 			log_info("NEW %s: state '%s'.", temp->sysfs_path,
 				 ibpi2str(temp->ibpi));
+			PROBE3(state_change, temp->sysfs_path,
+			       IBPI_PATTERN_UNKNOWN, temp->ibpi);
+			feed_publish(temp->sysfs_path, IBPI_PATTERN_UNKNOWN,
+				     temp->ibpi, "new");
 			list_append(&ledmon_block_list, temp);
 		}
 	}
 }
 
-/**
- * @brief Sends LED control message.
- *
- * This is internal function of monitor service. The function sends a LED
- * command to storage controller or enclosure device. The function checks
- * the time of last modification of block device structure. If the timestamp
- * is different then the current global timestamp this means the device is
- * missing due to hot-remove or hardware failure so it must be reported on
- * LEDs appropriately. Note that controller device and host attached to this
- * block device points to invalid pointer so it must be 'refreshed'.
- *
- * @param[in]    block            Pointer to block device structure.
- *
- * @return The function does not return a value.
- */
-static void _send_msg(struct block_device *block)
-{
-	if (!block->cntrl) {
-		log_debug("Missing cntrl for dev: %s. Not sending anything.",
-			  strstr(block->sysfs_path, "host"));
-		return;
-	}
-	if (block->timestamp != timestamp ||
-	    block->ibpi == IBPI_PATTERN_REMOVED) {
-		if (block->ibpi != IBPI_PATTERN_FAILED_DRIVE) {
-			log_info("CHANGE %s: from '%s' to '%s'.",
-				 block->sysfs_path, ibpi2str(block->ibpi),
-				 ibpi2str(IBPI_PATTERN_FAILED_DRIVE));
-			block->ibpi = IBPI_PATTERN_FAILED_DRIVE;
-		} else {
-			char *host = strstr(block->sysfs_path, "host");
-			log_debug("DETACHED DEV '%s' in failed state",
-				  host ? host : block->sysfs_path);
-		}
-	}
-	block->send_fn(block, block->ibpi);
-	block->ibpi_prev = block->ibpi;
-}
-
-static void _flush_msg(struct block_device *block)
-{
-	if (!block->cntrl)
-		return;
-	block->flush_fn(block);
-}
-
 static void _revalidate_dev(struct block_device *block)
 {
 	/* Bring back controller and host to the device. */
@@ -746,7 +1199,7 @@ static void _revalidate_dev(struct block_device *block)
 		block->host = block_get_host(block->cntrl, block->host_id);
 		if (block->host) {
 			if (dev_directly_attached(block->sysfs_path))
-				cntrl_init_smp(NULL, block->cntrl);
+				cntrl_init_smp(block->sysfs_path, block->cntrl);
 			else
 				scsi_get_enclosure(block);
 		} else {
@@ -798,11 +1251,17 @@ static void _ledmon_execute(void)
 	list_for_each(sysfs_get_block_devices(), device)
 		_add_block(device);
 	/* Send message to all devices in the list if needed. */
+	if (_ledmon_urgent())
+		priority_boost();
 	list_for_each(&ledmon_block_list, device)
 		_send_msg(device);
+	/* Enclosures which have been written report state of slots. */
+	_ledmon_check_slots(1);
 	/* Flush unsent messages from internal buffers. */
 	list_for_each(&ledmon_block_list, device)
 		_flush_msg(device);
+	/* Priority is raised as well by drives found failed while sending. */
+	priority_restore();
 	/* Check if there is any orphaned device. */
 	list_for_each(&ledmon_block_list, device)
 		_check_block_dev(device, &restart);
@@ -813,6 +1272,105 @@ static void _ledmon_execute(void)
 	}
 }
 
+/**
+ * @brief Prints transactions the first scan would issue.
+ *
+ * This is internal function of monitor service used by --dry-run option. The
+ * state of devices is determined as by a newly started daemon and LED messages
+ * are passed to the backends in plan mode, so no LED state is changed.
+ * Multi-step transactions are continued until they are complete. Retries of
+ * failed messages are not planned.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+static status_t _ledmon_dry_run(void)
+{
+	struct block_device *device;
+	uint64_t next, now;
+
+	list_init(&ledmon_block_list, (item_free_t)block_device_fini);
+	sysfs_init();
+	timestamp = time(NULL);
+	sysfs_scan();
+	plan_begin();
+	_ledmon_execute();
+	do {
+		next = 0;
+		list_for_each(&ledmon_block_list, device) {
+			if (device->xfer_time &&
+			    (!next || device->xfer_time < next))
+				next = device->xfer_time;
+		}
+		if (!next)
+			break;
+		now = get_monotonic_us();
+		if (next > now)
+			usleep(next - now);
+		list_for_each(&ledmon_block_list, device) {
+			if (device->xfer_time && device->xfer_time <= next)
+				_send_msg(device);
+		}
+		list_for_each(&ledmon_block_list, device)
+			_flush_msg(device);
+	} while (1);
+	plan_print(stdout);
+	plan_fini();
+	plan_stats_save();
+	list_erase(&ledmon_block_list);
+	sysfs_reset();
+	cadence_fini();
+	return STATUS_SUCCESS;
+}
+
+/**
+ * @brief Applies the state of devices once.
+ *
+ * This is internal function of monitor service used by --once option. The
+ * devices saved by the previous run are restored, so their previous state is
+ * known and the state machine continues where it stopped. One scan is done,
+ * the messages are sent and flushed and failed messages are retried until
+ * they succeed or the limit of attempts is reached. Then the state is saved
+ * and the summary is printed.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+static status_t _ledmon_once(void)
+{
+	struct block_device *device;
+	uint64_t next, now;
+	int fd, restored, count = 0;
+	status_t status;
+
+	fd = state_open();
+	if (fd < 0)
+		return STATUS_FILE_LOCK_ERROR;
+	list_init(&ledmon_block_list, (item_free_t)block_device_fini);
+	sysfs_init();
+	timestamp = time(NULL);
+	sysfs_scan();
+	restored = state_load(fd, &ledmon_block_list);
+	_ledmon_execute();
+	while ((next = _ledmon_next_retry(UINT64_MAX)) != UINT64_MAX) {
+		now = get_monotonic_us();
+		if (next > now)
+			usleep(next - now);
+		_ledmon_retry();
+	}
+	status = state_save(fd, &ledmon_block_list);
+	if (status != STATUS_SUCCESS)
+		log_error("Unable to save state to %s.", STATE_FILE);
+	list_for_each(&ledmon_block_list, device)
+		count++;
+	log_info("once: %d devices (%d restored), %d applied, %d failed.",
+		 count, restored, once_applied, once_failed);
+	printf("%d devices, %d applied, %d failed\n", count, once_applied,
+	       once_failed);
+	list_erase(&ledmon_block_list);
+	sysfs_reset();
+	cadence_fini();
+	return status;
+}
+
 static status_t _init_ledmon_conf(void)
 {
 	memset(&conf, 0, sizeof(struct ledmon_conf));
@@ -824,8 +1382,12 @@ static status_t _init_ledmon_conf(void)
 	conf.raid_members_only = 0;
 	conf.log_level = LOG_LEVEL_WARNING;
 	conf.scan_interval = LEDMON_DEF_SLEEP_INTERVAL;
+	conf.io_level = IO_LEVEL_DEFAULT;
+	conf.activity_cpu_budget = LEDMON_DEF_ACTIVITY_CPU_BUDGET;
 	list_init(&conf.cntrls_whitelist, NULL);
 	list_init(&conf.cntrls_blacklist, NULL);
+	list_init(&conf.cntrls_interval, NULL);
+	list_init(&conf.cntrls_flush_delay, NULL);
 	return set_log_path(LEDMON_DEF_LOG_FILE);
 }
 
@@ -880,17 +1442,22 @@ int main(int argc, char *argv[])
 	if (_cmdline_parse(argc, argv) != STATUS_SUCCESS)
 		return STATUS_CMDLINE_ERROR;
 
-	ledmon_write_shared_conf();
+	if (!dry_run && !once)
+		ledmon_write_shared_conf();
 
 	if (log_open(conf.log_path) != STATUS_SUCCESS)
 		return STATUS_LOG_FILE_ERROR;
 
 	free(shortopt);
 	free(longopt);
+	if (dry_run)
+		return _ledmon_dry_run();
 	if (pidfile_check(progname, NULL) == 0) {
 		log_warning("daemon is running...");
 		return STATUS_LEDMON_RUNNING;
 	}
+	if (once)
+		return _ledmon_once();
 	if (!foreground) {
 		pid_t pid = fork();
 
@@ -929,6 +1496,13 @@ int main(int argc, char *argv[])
 	}
 	_ledmon_setup_signals();
 
+	if (conf.feed_socket && feed_init(conf.feed_socket) != STATUS_SUCCESS)
+		log_warning("LED state change feed is disabled.");
+	priority_init();
+	if (conf.topology_file &&
+	    topology_load(conf.topology_file) != STATUS_SUCCESS)
+		log_warning("Topology manifest is ignored, full discovery is used.");
+
 	if (on_exit(_ledmon_fini, progname))
 		exit(STATUS_ONEXIT_ERROR);
 	list_init(&ledmon_block_list, (item_free_t)block_device_fini);
@@ -940,11 +1514,23 @@ int main(int argc, char *argv[])
 		timestamp = time(NULL);
 		sysfs_scan();
 		_ledmon_execute();
-		_ledmon_wait(conf.scan_interval);
-		/* Invalidate each device in the list. Clear controller and host. */
+		activity_update(&ledmon_block_list);
+		topology_publish();
+		_ledmon_wait((uint64_t)conf.scan_interval * 1000);
+		if (terminate) {
+			/* Do not leave messages in coalescing window. */
+			list_for_each(&ledmon_block_list, device)
+				_flush_msg(device);
+			activity_fini();
+		}
+		plan_stats_save();
+		/*
+		 * Invalidate each device in the list. Clear controller and host.
+		 * Devices found by sysfs_scan() are kept, so the next scan only
+		 * refreshes controllers which are due.
+		 */
 		list_for_each(&ledmon_block_list, device)
 			_invalidate_dev(device);
-		sysfs_reset();
 	}
 	ledmon_remove_shared_conf();
 	stop_udev_monitor();
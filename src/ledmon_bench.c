@@ -0,0 +1,1000 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*
+ * Fault-to-LED latency benchmark.
+ *
+ * The tool mounts a synthetic sysfs tree (AHCI or SAS controller with md
+ * RAID5 arrays) over /sys in a private mount namespace and runs the monitor
+ * loop of ledmon against it. The AHCI backend writes em_message files of the
+ * synthetic tree, so no hardware is touched. The SAS controller is driven by
+ * isci driver with drives attached directly to its phys, the SMP backend fills
+ * the GPIO buffer of the host but the tree has no bsg device, so the
+ * transmission is skipped. md state transitions are injected by a separate
+ * thread at random moments of the scan interval and the wall-clock time until
+ * the backend is asked to visualize the corresponding pattern is measured.
+ *
+ * Events of the injector interrupt _ledmon_wait() by SIGUSR1. Like ledmon,
+ * the loop is woken up by md events only while it is waiting (/proc/mdstat is
+ * open), so transitions which happen during a scan are noticed with the next
+ * periodic scan. Udev events are queued and never lost, they are handed over
+ * to handle_udev_action() as udev monitor would deliver them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define main ledmon_main
+#include "ledmon.c"
+#undef main
+
+/**
+ * Number of in-sync members and spares of each synthetic RAID5 array.
+ */
+#define BENCH_MEMBERS		4
+#define BENCH_SPARES		1
+#define BENCH_ARRAY_DRIVES	(BENCH_MEMBERS + BENCH_SPARES)
+
+/**
+ * Path to synthetic AHCI controller.
+ */
+#define BENCH_CNTRL		"/sys/devices/pci0000:00/0000:00:17.0"
+
+/**
+ * Path to synthetic SAS controller and number of phys of each of its hosts.
+ */
+#define BENCH_SAS_CNTRL		"/sys/devices/pci0000:00/0000:00:03.0/0000:03:00.0"
+#define BENCH_SAS_PHYS		4
+
+/**
+ * Number of rescans run after the state of topology is restored.
+ */
+#define BENCH_SETTLE_SCANS	3
+
+#define BENCH_DEF_SAMPLES	50
+
+enum bench_topology {
+	BENCH_AHCI = 0,
+	BENCH_SAS,
+	BENCH_TOPOLOGY_COUNT
+};
+
+static const char * const bench_topologies[] = {
+	[BENCH_AHCI] = "ahci",
+	[BENCH_SAS]  = "sas",
+};
+
+enum bench_scenario {
+	BENCH_FAULTY = 0,
+	BENCH_DEGRADED,
+	BENCH_RECOVERY,
+	BENCH_HOT_REMOVE,
+	BENCH_SCENARIO_COUNT
+};
+
+static const struct {
+	const char *name;
+	enum ibpi_pattern ibpi;
+} bench_scenarios[] = {
+	[BENCH_FAULTY]     = { "faulty member",  IBPI_PATTERN_FAILED_DRIVE },
+	[BENCH_DEGRADED]   = { "degraded array", IBPI_PATTERN_DEGRADED },
+	[BENCH_RECOVERY]   = { "recovery start", IBPI_PATTERN_REBUILD },
+	[BENCH_HOT_REMOVE] = { "hot-remove",     IBPI_PATTERN_FAILED_DRIVE },
+};
+
+/**
+ * Events posted to monitor loop. Md events only wake the loop up, the others
+ * are queued until the loop handles them.
+ */
+enum bench_msg {
+	BENCH_MSG_MDSTAT      = 0,
+	BENCH_MSG_UDEV_REMOVE = 1,
+	BENCH_MSG_RESCAN      = 2,
+	BENCH_MSG_STOP        = 4
+};
+
+/**
+ * State shared by monitor loop and injector thread.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t monitor;
+	int pending;
+	enum bench_topology topology;
+	int drives;
+	int interval_ms;
+	int samples;
+	int notify;
+	unsigned long cycles;
+	int waiting;
+	int armed;
+	int done;
+	char target[PATH_MAX];
+	enum ibpi_pattern target_ibpi;
+	uint64_t t_inject;
+	uint64_t t_done;
+	double *results[BENCH_SCENARIO_COUNT];
+	int results_len[BENCH_SCENARIO_COUNT];
+	/* injections which did not wake the loop up, the scan noticed them */
+	int polled[BENCH_SCENARIO_COUNT];
+	int timeouts[BENCH_SCENARIO_COUNT];
+} bench = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.samples = BENCH_DEF_SAMPLES,
+	.notify = 1,
+};
+
+static send_message_t bench_real_send;
+
+static uint64_t _bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void _bench_sleep_ms(int ms)
+{
+	struct timespec ts = {
+		.tv_sec = ms / 1000,
+		.tv_nsec = (ms % 1000) * 1000000L
+	};
+
+	nanosleep(&ts, NULL);
+}
+
+static int _bench_mkdir_p(const char *path)
+{
+	char buf[PATH_MAX];
+	char *p;
+
+	str_cpy(buf, path, sizeof(buf));
+	for (p = buf + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(buf, 0755) && errno != EEXIST)
+			return -1;
+		*p = '/';
+	}
+	if (mkdir(buf, 0755) && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+static int _bench_write(const char *value, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	char *p;
+	va_list vl;
+	FILE *f;
+
+	va_start(vl, fmt);
+	vsnprintf(path, sizeof(path), fmt, vl);
+	va_end(vl);
+
+	p = strrchr(path, '/');
+	*p = '\0';
+	if (_bench_mkdir_p(path))
+		return -1;
+	*p = '/';
+
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	fprintf(f, "%s\n", value);
+	fclose(f);
+	return 0;
+}
+
+static int _bench_link(const char *target, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	char *p;
+	va_list vl;
+
+	va_start(vl, fmt);
+	vsnprintf(path, sizeof(path), fmt, vl);
+	va_end(vl);
+
+	p = strrchr(path, '/');
+	*p = '\0';
+	if (_bench_mkdir_p(path))
+		return -1;
+	*p = '/';
+
+	unlink(path);
+	return symlink(target, path);
+}
+
+static void _bench_drive_name(int index, char *buf, size_t size)
+{
+	char tmp[8];
+	int len = 0;
+
+	do {
+		tmp[len++] = 'a' + index % 26;
+		index = index / 26 - 1;
+	} while (index >= 0 && len < (int)sizeof(tmp));
+
+	snprintf(buf, size, "sd");
+	while (len > 0 && strlen(buf) + 1 < size)
+		strncat(buf, &tmp[--len], 1);
+}
+
+static void _bench_drive_path(int index, char *buf, size_t size)
+{
+	int host = index / BENCH_SAS_PHYS, phy = index % BENCH_SAS_PHYS;
+	char name[16];
+
+	_bench_drive_name(index, name, sizeof(name));
+	if (bench.topology == BENCH_SAS)
+		snprintf(buf, size, BENCH_SAS_CNTRL "/host%d/port-%d:%d/"
+			 "end_device-%d:%d/target%d:0:%d/%d:0:%d:0/block/%s",
+			 host, host, phy, host, phy, host, phy, host, phy, name);
+	else
+		snprintf(buf, size, BENCH_CNTRL "/ata%d/host%d/target%d:0:0/"
+			 "%d:0:0:0/block/%s", index + 1, index, index, index,
+			 name);
+}
+
+static int _bench_link_member(int array, int index)
+{
+	char name[16], path[PATH_MAX];
+
+	_bench_drive_name(index, name, sizeof(name));
+	_bench_drive_path(index, path, sizeof(path));
+	if (_bench_link(path, "/sys/block/%s", name))
+		return -1;
+	return _bench_link(path, "/sys/devices/virtual/block/md%d/md/dev-%s/block",
+			   array, name);
+}
+
+static void _bench_unlink_member(int array, int index)
+{
+	char name[16], path[PATH_MAX];
+
+	_bench_drive_name(index, name, sizeof(name));
+	snprintf(path, sizeof(path), "/sys/block/%s", name);
+	unlink(path);
+	snprintf(path, sizeof(path),
+		 "/sys/devices/virtual/block/md%d/md/dev-%s/block", array, name);
+	unlink(path);
+}
+
+static int _bench_set_member(int array, int index, const char *state)
+{
+	char name[16];
+
+	_bench_drive_name(index, name, sizeof(name));
+	return _bench_write(state,
+			    "/sys/devices/virtual/block/md%d/md/dev-%s/state",
+			    array, name);
+}
+
+static int _bench_set_array(int array, const char *attr, const char *value)
+{
+	return _bench_write(value, "/sys/devices/virtual/block/md%d/md/%s",
+			    array, attr);
+}
+
+/**
+ * @brief Builds Intel AHCI controller with enclosure management enabled and
+ * one port per drive.
+ */
+static int _bench_build_ahci(int drives)
+{
+	int index;
+
+	if (_bench_write("0x010601", BENCH_CNTRL "/class") ||
+	    _bench_write("0x8086", BENCH_CNTRL "/vendor") ||
+	    _bench_write("0xa102", BENCH_CNTRL "/device") ||
+	    _bench_write("1", "/sys/bus/pci/drivers/ahci/module/parameters/"
+				"ahci_em_messages") ||
+	    _bench_link("/sys/bus/pci/drivers/ahci", BENCH_CNTRL "/driver") ||
+	    _bench_link(BENCH_CNTRL, "/sys/bus/pci/devices/0000:00:17.0"))
+		return -1;
+	for (index = 0; index < drives; index++) {
+		if (_bench_write("0", BENCH_CNTRL "/ata%d/host%d/scsi_host/"
+				 "host%d/em_message", index + 1, index, index))
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Builds SAS controller of isci driver with hosts of BENCH_SAS_PHYS
+ * phys and one drive attached directly to each phy.
+ */
+static int _bench_build_sas(int drives)
+{
+	char buf[PATH_MAX];
+	int index, host, phy;
+
+	if (_bench_write("0x010700", BENCH_SAS_CNTRL "/class") ||
+	    _bench_write("0x8086", BENCH_SAS_CNTRL "/vendor") ||
+	    _bench_write("0x1d6b", BENCH_SAS_CNTRL "/device") ||
+	    _bench_mkdir_p("/sys/bus/pci/drivers/isci") ||
+	    _bench_link("/sys/bus/pci/drivers/isci",
+			BENCH_SAS_CNTRL "/driver") ||
+	    _bench_link(BENCH_SAS_CNTRL, "/sys/bus/pci/devices/0000:03:00.0"))
+		return -1;
+	for (index = 0; index < drives; index++) {
+		host = index / BENCH_SAS_PHYS;
+		phy = index % BENCH_SAS_PHYS;
+		snprintf(buf, sizeof(buf), BENCH_SAS_CNTRL "/host%d/phy-%d:%d",
+			 host, host, phy);
+		if (_bench_mkdir_p(buf))
+			return -1;
+		snprintf(buf, sizeof(buf), BENCH_SAS_CNTRL
+			 "/host%d/port-%d:%d/phy-%d:%d", host, host, phy, host,
+			 phy);
+		if (_bench_mkdir_p(buf))
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Builds synthetic sysfs tree.
+ *
+ * A tmpfs is mounted over /sys in a private mount namespace and populated
+ * with the controller of the topology and RAID5 arrays of BENCH_MEMBERS
+ * members and BENCH_SPARES spares.
+ */
+static int _bench_build_tree(int arrays)
+{
+	char buf[PATH_MAX], name[16];
+	int i, j, index, status;
+
+	umount2("/sys", MNT_DETACH);
+	if (mount("tmpfs", "/sys", "tmpfs", 0, "mode=0755")) {
+		fprintf(stderr, "Unable to mount synthetic sysfs: %s\n",
+			strerror(errno));
+		return -1;
+	}
+
+	if (bench.topology == BENCH_SAS)
+		status = _bench_build_sas(arrays * BENCH_ARRAY_DRIVES);
+	else
+		status = _bench_build_ahci(arrays * BENCH_ARRAY_DRIVES);
+	if (status)
+		return -1;
+
+	for (j = 0; j < arrays; j++) {
+		snprintf(buf, sizeof(buf), "9:%d", j);
+		if (_bench_write(buf, "/sys/devices/virtual/block/md%d/dev", j) ||
+		    _bench_set_array(j, "metadata_version", "1.2") ||
+		    _bench_set_array(j, "array_state", "clean") ||
+		    _bench_set_array(j, "level", "raid5") ||
+		    _bench_set_array(j, "degraded", "0") ||
+		    _bench_set_array(j, "sync_action", "idle"))
+			return -1;
+		snprintf(buf, sizeof(buf), "%d", BENCH_MEMBERS);
+		if (_bench_set_array(j, "raid_disks", buf))
+			return -1;
+		snprintf(buf, sizeof(buf), "/sys/devices/virtual/block/md%d", j);
+		if (_bench_link(buf, "/sys/block/md%d", j))
+			return -1;
+
+		for (i = 0; i < BENCH_ARRAY_DRIVES; i++) {
+			index = j * BENCH_ARRAY_DRIVES + i;
+			_bench_drive_name(index, name, sizeof(name));
+			_bench_drive_path(index, buf, sizeof(buf));
+			if (_bench_write("8:0", "%s/dev", buf) ||
+			    _bench_set_member(j, index, i < BENCH_MEMBERS ?
+					      "in_sync" : "spare") ||
+			    _bench_link_member(j, index))
+				return -1;
+			snprintf(buf, sizeof(buf), "%d", i < BENCH_MEMBERS ? i : -1);
+			if (_bench_write(i < BENCH_MEMBERS ? buf : "none",
+					 "/sys/devices/virtual/block/md%d/md/"
+					 "dev-%s/slot", j, name) ||
+			    _bench_write("0", "/sys/devices/virtual/block/md%d/md/"
+					 "dev-%s/errors", j, name))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Enters private mount namespace.
+ */
+static int _bench_unshare(void)
+{
+	if (unshare(CLONE_NEWNS)) {
+		fprintf(stderr, "Unable to create mount namespace: %s\n",
+			strerror(errno));
+		return -1;
+	}
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL)) {
+		fprintf(stderr, "Unable to make mounts private: %s\n",
+			strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Send function installed on each block device. It records the moment the
+ * backend completes the transaction visualizing the awaited pattern on the
+ * target device.
+ */
+static int _bench_send(struct block_device *device, enum ibpi_pattern ibpi)
+{
+	int status = bench_real_send(device, ibpi);
+
+	pthread_mutex_lock(&bench.lock);
+	if (bench.armed && !bench.done && ibpi == bench.target_ibpi &&
+	    status == 0 && !xfer_pending(device) &&
+	    strcmp(device->sysfs_path, bench.target) == 0) {
+		bench.t_done = _bench_now_ns();
+		bench.done = 1;
+		pthread_cond_broadcast(&bench.cond);
+	}
+	pthread_mutex_unlock(&bench.lock);
+	return status;
+}
+
+/**
+ * Flush function of the SAS tree. It has no bsg device, so the transmission of
+ * the GPIO buffer is skipped and reported as successful.
+ */
+static int _bench_flush(struct block_device *device __attribute__ ((unused)))
+{
+	return 0;
+}
+
+static void _bench_hook_send(void)
+{
+	struct block_device *device;
+
+	list_for_each(sysfs_get_block_devices(), device) {
+		if (device->send_fn != _bench_send) {
+			bench_real_send = device->send_fn;
+			device->send_fn = _bench_send;
+		}
+		if (bench.topology == BENCH_SAS)
+			device->flush_fn = _bench_flush;
+	}
+}
+
+/**
+ * @brief Posts event to monitor loop, bench.lock has to be held.
+ */
+static void _bench_notify(enum bench_msg msg)
+{
+	bench.pending |= msg;
+	pthread_kill(bench.monitor, SIGUSR1);
+}
+
+/**
+ * @brief SIGUSR1 handler of the benchmark.
+ *
+ * Unlike ledmon's handler it does not request loading of timed patterns, so
+ * the signal ends _ledmon_wait().
+ */
+static void _bench_sig_wake(int signum __attribute__ ((unused)))
+{
+}
+
+/**
+ * @brief Delivers udev remove event of the target to ledmon's handler.
+ *
+ * The synthetic tree has no udev, so the event which udev monitor would
+ * receive for the removed drive is passed to handle_udev_action().
+ */
+static void _bench_udev_remove(void)
+{
+	char path[PATH_MAX];
+
+	pthread_mutex_lock(&bench.lock);
+	str_cpy(path, bench.target, sizeof(path));
+	pthread_mutex_unlock(&bench.lock);
+	handle_udev_action(&ledmon_block_list, "remove", path);
+}
+
+/**
+ * @brief Runs monitor loop the same way as ledmon does.
+ *
+ * SIGUSR1 is blocked except in _ledmon_wait(), so an event posted just before
+ * the wait starts interrupts it. Wake-ups posted after the wait has ended are
+ * discarded, queued events are handled instead of waiting.
+ */
+static void _bench_monitor(void)
+{
+	static const struct timespec nowait;
+	struct block_device *device;
+	sigset_t sigset;
+	int pending = 0, wait;
+
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGUSR1);
+	while (!(pending & BENCH_MSG_STOP)) {
+		timestamp = time(NULL);
+		sysfs_scan();
+		_bench_hook_send();
+		_ledmon_execute();
+		activity_update(&ledmon_block_list);
+
+		pthread_mutex_lock(&bench.lock);
+		bench.cycles++;
+		pthread_cond_broadcast(&bench.cond);
+		wait = bench.waiting = !bench.pending;
+		pthread_mutex_unlock(&bench.lock);
+
+		if (wait)
+			_ledmon_wait(bench.interval_ms);
+
+		pthread_mutex_lock(&bench.lock);
+		bench.waiting = 0;
+		pending = bench.pending;
+		bench.pending = 0;
+		pthread_mutex_unlock(&bench.lock);
+		while (sigtimedwait(&sigset, NULL, &nowait) == SIGUSR1)
+			;
+
+		if (pending & BENCH_MSG_UDEV_REMOVE)
+			_bench_udev_remove();
+		list_for_each(&ledmon_block_list, device)
+			_invalidate_dev(device);
+	}
+}
+
+/**
+ * @brief Requests a rescan and waits until it is done.
+ */
+static void _bench_rescan(void)
+{
+	unsigned long cycles;
+
+	pthread_mutex_lock(&bench.lock);
+	cycles = bench.cycles;
+	_bench_notify(BENCH_MSG_RESCAN);
+	while (bench.cycles <= cycles)
+		pthread_cond_wait(&bench.cond, &bench.lock);
+	pthread_mutex_unlock(&bench.lock);
+}
+
+static void _bench_inject(enum bench_scenario scenario, int array, int member,
+			  int restore)
+{
+	int index = array * BENCH_ARRAY_DRIVES + member;
+
+	switch (scenario) {
+	case BENCH_FAULTY:
+	case BENCH_DEGRADED:
+		_bench_set_member(array, index, restore ? "in_sync" : "faulty");
+		_bench_set_array(array, "degraded", restore ? "0" : "1");
+		break;
+	case BENCH_RECOVERY:
+		_bench_set_member(array, index, restore ? "in_sync" : "faulty");
+		_bench_set_array(array, "degraded", restore ? "0" : "1");
+		_bench_set_array(array, "sync_action", restore ? "idle" : "recover");
+		break;
+	case BENCH_HOT_REMOVE:
+		if (restore)
+			_bench_link_member(array, index);
+		else
+			_bench_unlink_member(array, index);
+		_bench_set_array(array, "degraded", restore ? "0" : "1");
+		break;
+	case BENCH_SCENARIO_COUNT:
+		break;
+	}
+}
+
+/**
+ * @brief Injects state transitions and collects the results.
+ */
+static void *_bench_injector(void *arg __attribute__ ((unused)))
+{
+	unsigned int seed = 1;
+	struct timespec deadline;
+	char path[PATH_MAX];
+	int s, i, array, member, target, rc;
+
+	for (i = 0; i < BENCH_SETTLE_SCANS; i++)
+		_bench_rescan();
+
+	for (s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+		/* isci has no pattern for members of degraded array */
+		if (bench.topology == BENCH_SAS && s == BENCH_DEGRADED)
+			continue;
+		for (i = 0; i < bench.samples; i++) {
+			array = rand_r(&seed) % (bench.drives / BENCH_ARRAY_DRIVES);
+			member = rand_r(&seed) % BENCH_MEMBERS;
+			if (s == BENCH_DEGRADED)
+				target = (member + 1) % BENCH_MEMBERS;
+			else if (s == BENCH_RECOVERY)
+				target = BENCH_MEMBERS;
+			else
+				target = member;
+			_bench_drive_path(array * BENCH_ARRAY_DRIVES + target,
+					  path, sizeof(path));
+
+			/* random moment of the scan interval */
+			_bench_sleep_ms(rand_r(&seed) % bench.interval_ms);
+
+			pthread_mutex_lock(&bench.lock);
+			str_cpy(bench.target, path, sizeof(bench.target));
+			bench.target_ibpi = bench_scenarios[s].ibpi;
+			bench.done = 0;
+			bench.armed = 1;
+			bench.t_inject = _bench_now_ns();
+			_bench_inject(s, array, member, 0);
+			if (s == BENCH_HOT_REMOVE)
+				_bench_notify(BENCH_MSG_UDEV_REMOVE);
+			else if (bench.notify && bench.waiting)
+				_bench_notify(BENCH_MSG_MDSTAT);
+			else
+				bench.polled[s]++;
+
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += 3 * bench.interval_ms / 1000 + 5;
+			rc = 0;
+			while (!bench.done && rc != ETIMEDOUT)
+				rc = pthread_cond_timedwait(&bench.cond,
+							    &bench.lock,
+							    &deadline);
+			if (bench.done)
+				bench.results[s][bench.results_len[s]++] =
+					(bench.t_done - bench.t_inject) / 1e6;
+			else
+				bench.timeouts[s]++;
+			bench.armed = 0;
+			pthread_mutex_unlock(&bench.lock);
+
+			_bench_inject(s, array, member, 1);
+			for (rc = 0; rc < BENCH_SETTLE_SCANS; rc++)
+				_bench_rescan();
+		}
+	}
+	pthread_mutex_lock(&bench.lock);
+	_bench_notify(BENCH_MSG_STOP);
+	pthread_mutex_unlock(&bench.lock);
+	return NULL;
+}
+
+static int _bench_cmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double _bench_percentile(double *v, int len, int p)
+{
+	int i;
+
+	if (len == 0)
+		return 0.0;
+	i = (len * p + 99) / 100 - 1;
+	return v[i < 0 ? 0 : i];
+}
+
+static void _bench_report(void)
+{
+	int s, len;
+	double *v;
+
+	for (s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+		v = bench.results[s];
+		len = bench.results_len[s];
+		qsort(v, len, sizeof(*v), _bench_cmp);
+		printf("%-5s %6d %8d  %-15s %7d %9.3f %9.3f %9.3f %9.3f %6d %8d\n",
+		       bench_topologies[bench.topology], bench.drives,
+		       bench.interval_ms, bench_scenarios[s].name,
+		       len, _bench_percentile(v, len, 50),
+		       _bench_percentile(v, len, 90),
+		       _bench_percentile(v, len, 99),
+		       len ? v[len - 1] : 0.0, bench.polled[s],
+		       bench.timeouts[s]);
+	}
+	fflush(stdout);
+}
+
+/**
+ * @brief Runs the benchmark for single topology size and scan interval.
+ */
+static int _bench_run(enum bench_topology topology, int drives,
+		      int interval_ms)
+{
+	pthread_t injector;
+	int s, err_fd, null_fd;
+
+	bench.topology = topology;
+	bench.drives = drives;
+	bench.interval_ms = interval_ms;
+	bench.cycles = 0;
+	for (s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+		bench.results_len[s] = 0;
+		bench.polled[s] = 0;
+		bench.timeouts[s] = 0;
+	}
+
+	if (_bench_build_tree(drives / BENCH_ARRAY_DRIVES))
+		return -1;
+
+	list_init(&ledmon_block_list, (item_free_t)block_device_fini);
+	sysfs_init();
+	if (pthread_create(&injector, NULL, _bench_injector, NULL))
+		return -1;
+	/* like the daemon, backends report unsupported patterns to nowhere */
+	err_fd = dup(STDERR_FILENO);
+	null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd >= 0) {
+		dup2(null_fd, STDERR_FILENO);
+		close(null_fd);
+	}
+	_bench_monitor();
+	pthread_join(injector, NULL);
+	if (err_fd >= 0) {
+		dup2(err_fd, STDERR_FILENO);
+		close(err_fd);
+	}
+	sysfs_reset();
+	cadence_fini();
+	list_erase(&ledmon_block_list);
+
+	_bench_report();
+	return 0;
+}
+
+/**
+ * @brief Parses comma separated names of topologies.
+ */
+static int _bench_parse_topologies(const char *str, int *list, int max)
+{
+	char buf[BUFFER_MAX], *name, *s;
+	int n = 0, t;
+
+	str_cpy(buf, str, sizeof(buf));
+	for (s = buf; (name = strsep(&s, ",")) && n < max; n++) {
+		for (t = 0; t < BENCH_TOPOLOGY_COUNT; t++) {
+			if (strcmp(name, bench_topologies[t]) == 0)
+				break;
+		}
+		if (t == BENCH_TOPOLOGY_COUNT)
+			return -1;
+		list[n] = t;
+	}
+	return n;
+}
+
+static int _bench_parse_list(const char *str, int *list, int max)
+{
+	char *end;
+	int n = 0;
+
+	while (*str && n < max) {
+		list[n] = strtol(str, &end, 10);
+		if (end == str || list[n] <= 0)
+			return -1;
+		n++;
+		str = *end == ',' ? end + 1 : end;
+	}
+	return *str ? -1 : n;
+}
+
+#define BENCH_TOKEN_ROUNDS	200000
+
+/**
+ * Chain of string comparisons ledctl used to parse pattern names before.
+ */
+static int _bench_chain(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < ibpi_tokens_count; i++) {
+		if (strcmp(name, ibpi_tokens[i].name) == 0)
+			return ibpi_tokens[i].value;
+	}
+	return -1;
+}
+
+/**
+ * @brief Compares parser of pattern names with chain of string comparisons.
+ *
+ * Input consists of all pattern names of ledctl and some unknown ones. Names
+ * with trailing white spaces and new line have to give the same result.
+ */
+static int _bench_tokens(void)
+{
+	static const char * const unknown[] = { "", "loc", "ses_", "unknown",
+						"ses_prdfailure" };
+	static const char * const suffix[] = { "\n", " ", " \t\r\n" };
+	const char **input;
+	char buf[64];
+	size_t i, j, n = 0;
+	uint64_t t0, t1, t2;
+	volatile int sink = 0;
+
+	input = calloc(ibpi_tokens_count + 5, sizeof(*input));
+	if (!input)
+		return -1;
+	for (i = 0; i < ibpi_tokens_count; i++)
+		input[n++] = ibpi_tokens[i].name;
+	for (i = 0; i < 5; i++)
+		input[n++] = unknown[i];
+
+	for (i = 0; i < n; i++) {
+		int expected = _bench_chain(input[i]);
+
+		if (str2ibpi(input[i]) != expected) {
+			printf("mismatch: '%s'\n", input[i]);
+			free(input);
+			return -1;
+		}
+		for (j = 0; j < 3; j++) {
+			snprintf(buf, sizeof(buf), "%s%s", input[i], suffix[j]);
+			if (str2ibpi(buf) != expected) {
+				printf("mismatch: '%s' with suffix %zu\n",
+				       input[i], j);
+				free(input);
+				return -1;
+			}
+		}
+	}
+
+	t0 = _bench_now_ns();
+	for (j = 0; j < BENCH_TOKEN_ROUNDS; j++)
+		for (i = 0; i < n; i++)
+			sink += _bench_chain(input[i]);
+	t1 = _bench_now_ns();
+	for (j = 0; j < BENCH_TOKEN_ROUNDS; j++)
+		for (i = 0; i < n; i++)
+			sink += str2ibpi(input[i]);
+	t2 = _bench_now_ns();
+
+	printf("%-12s %10s\n", "parser", "ns/lookup");
+	printf("%-12s %10.1f\n", "strcmp", (double)(t1 - t0) /
+	       (BENCH_TOKEN_ROUNDS * n));
+	printf("%-12s %10.1f\n", "token", (double)(t2 - t1) /
+	       (BENCH_TOKEN_ROUNDS * n));
+	UNUSED(sink);
+	free(input);
+	return 0;
+}
+
+static void _bench_help(void)
+{
+	printf("Usage: ledmon_bench [OPTIONS]\n\n");
+	print_opt("--drives=LIST", "-d LIST",
+		  "Topology sizes (default 10,40,160).");
+	print_opt("--intervals=LIST", "-i LIST",
+		  "Scan intervals in ms (default 200,1000).");
+	print_opt("--topologies=LIST", "-T LIST",
+		  "Controllers of synthetic tree: ahci, sas (default both).");
+	print_opt("--samples=VALUE", "-s VALUE",
+		  "Samples per scenario (default 50).");
+	print_opt("--no-notify", "-n",
+		  "Do not wake up on md events, poll only.");
+	print_opt("--tokens", "-t",
+		  "Compare token tables with string comparisons and exit.");
+	print_opt("--help", "-h", "Displays this help text.");
+}
+
+int main(int argc, char *argv[])
+{
+	static struct option bench_options[] = {
+		{"drives",    required_argument, NULL, 'd'},
+		{"intervals", required_argument, NULL, 'i'},
+		{"samples",   required_argument, NULL, 's'},
+		{"topologies", required_argument, NULL, 'T'},
+		{"no-notify", no_argument,       NULL, 'n'},
+		{"tokens",    no_argument,       NULL, 't'},
+		{"help",      no_argument,       NULL, 'h'},
+		{NULL,        no_argument,       NULL, 0}
+	};
+	int drives[16] = { 10, 40, 160 }, drives_len = 3;
+	int intervals[16] = { 200, 1000 }, intervals_len = 2;
+	int topologies[BENCH_TOPOLOGY_COUNT] = { BENCH_AHCI, BENCH_SAS };
+	int topologies_len = BENCH_TOPOLOGY_COUNT;
+	struct sigaction act;
+	sigset_t sigset;
+	int opt, d, i, s, t;
+
+	set_invocation_name(argv[0]);
+	while ((opt = getopt_long(argc, argv, "d:i:s:T:nth", bench_options,
+				  NULL)) != -1) {
+		switch (opt) {
+		case 'd':
+			drives_len = _bench_parse_list(optarg, drives, 16);
+			break;
+		case 'i':
+			intervals_len = _bench_parse_list(optarg, intervals, 16);
+			break;
+		case 's':
+			bench.samples = atoi(optarg);
+			break;
+		case 'T':
+			topologies_len = _bench_parse_topologies(optarg,
+						topologies, BENCH_TOPOLOGY_COUNT);
+			break;
+		case 'n':
+			bench.notify = 0;
+			break;
+		case 't':
+			return _bench_tokens() ? STATUS_DATA_ERROR :
+						 STATUS_SUCCESS;
+		case 'h':
+			_bench_help();
+			return STATUS_SUCCESS;
+		default:
+			return STATUS_CMDLINE_ERROR;
+		}
+		if (drives_len <= 0 || intervals_len <= 0 ||
+		    topologies_len <= 0 || bench.samples <= 0)
+			return STATUS_CMDLINE_ERROR;
+	}
+
+	if (_init_ledmon_conf() != STATUS_SUCCESS)
+		return STATUS_LEDMON_INIT;
+	conf.log_level = LOG_LEVEL_QUIET;
+	set_log_path("/dev/null");
+
+	/* inherited by the injector, so only the wait receives SIGUSR1 */
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGUSR1);
+	sigprocmask(SIG_BLOCK, &sigset, NULL);
+	act.sa_handler = _bench_sig_wake;
+	act.sa_flags = 0;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGUSR1, &act, NULL);
+	bench.monitor = pthread_self();
+	for (s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+		bench.results[s] = calloc(bench.samples, sizeof(double));
+		if (!bench.results[s])
+			return STATUS_OUT_OF_MEMORY;
+	}
+	if (_bench_unshare())
+		return STATUS_NOT_A_PRIVILEGED_USER;
+
+	printf("%-5s %6s %8s  %-15s %7s %9s %9s %9s %9s %6s %8s\n", "cntrl",
+	       "drives", "int[ms]", "scenario", "samples", "p50[ms]",
+	       "p90[ms]", "p99[ms]", "max[ms]", "polled", "timeout");
+	for (t = 0; t < topologies_len; t++) {
+		for (d = 0; d < drives_len; d++) {
+			int n = (drives[d] + BENCH_ARRAY_DRIVES - 1) /
+				BENCH_ARRAY_DRIVES * BENCH_ARRAY_DRIVES;
+
+			for (i = 0; i < intervals_len; i++) {
+				if (_bench_run(topologies[t], n, intervals[i]))
+					return STATUS_SYSFS_INIT_ERROR;
+			}
+		}
+	}
+	return STATUS_SUCCESS;
+}
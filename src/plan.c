@@ -0,0 +1,248 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "list.h"
+#include "plan.h"
+#include "token.h"
+#include "utils.h"
+
+/**
+ * Kinds of hardware transactions, see probes.h.
+ */
+enum plan_kind {
+	PLAN_EM_MESSAGE = 0,
+	PLAN_AMD_SGPIO,
+	PLAN_SG_RECEIVE_DIAG,
+	PLAN_SG_SEND_DIAG,
+	PLAN_SMP,
+	PLAN_IPMI,
+	PLAN_VMD_ATTENTION,
+	PLAN_KIND_COUNT
+};
+
+static const struct token plan_kinds[] = {
+	TOKEN("em_message", PLAN_EM_MESSAGE),
+	TOKEN("amd_sgpio", PLAN_AMD_SGPIO),
+	TOKEN("sg_receive_diag", PLAN_SG_RECEIVE_DIAG),
+	TOKEN("sg_send_diag", PLAN_SG_SEND_DIAG),
+	TOKEN("smp", PLAN_SMP),
+	TOKEN("ipmi", PLAN_IPMI),
+	TOKEN("vmd_attention", PLAN_VMD_ATTENTION),
+};
+
+/**
+ * @brief Accumulated duration of transactions of one kind.
+ */
+struct plan_stats {
+	unsigned long count;
+	uint64_t total;
+};
+
+/**
+ * @brief Transaction recorded in plan mode.
+ */
+struct plan_entry {
+	enum plan_kind kind;
+	char *path;
+	size_t len;
+	int write;
+};
+
+static int active;
+static struct list entries;
+/* statistics accumulated since the last plan_stats_save() */
+static struct plan_stats stats[PLAN_KIND_COUNT];
+
+static void _entry_free(struct plan_entry *entry)
+{
+	free(entry->path);
+	free(entry);
+}
+
+void plan_begin(void)
+{
+	if (active)
+		return;
+	list_init(&entries, (item_free_t)_entry_free);
+	active = 1;
+}
+
+int plan_active(void)
+{
+	return active;
+}
+
+int plan_xfer(const char *kind, const char *path, size_t len, int write)
+{
+	struct plan_entry *entry;
+	int k;
+
+	if (!active)
+		return 0;
+	k = token_find(plan_kinds, TOKEN_COUNT(plan_kinds), kind);
+	if (k < 0)
+		return 0;
+	entry = calloc(1, sizeof(*entry));
+	if (entry) {
+		entry->kind = k;
+		entry->path = path ? str_dup(path) : NULL;
+		entry->len = len;
+		entry->write = write;
+		list_append(&entries, entry);
+	}
+	return write;
+}
+
+void plan_stat(const char *kind, uint64_t start)
+{
+	int k = token_find(plan_kinds, TOKEN_COUNT(plan_kinds), kind);
+
+	if (k < 0)
+		return;
+	stats[k].count++;
+	stats[k].total += get_monotonic_us() - start;
+}
+
+static void _stats_read(FILE *f, struct plan_stats *totals)
+{
+	char line[128], name[32];
+	unsigned long count;
+	uint64_t total;
+	int k;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%31s %lu %" SCNu64, name, &count, &total) != 3)
+			continue;
+		k = token_find(plan_kinds, TOKEN_COUNT(plan_kinds), name);
+		if (k < 0)
+			continue;
+		totals[k].count += count;
+		totals[k].total += total;
+	}
+}
+
+status_t plan_stats_save(void)
+{
+	struct plan_stats totals[PLAN_KIND_COUNT];
+	status_t status = STATUS_SUCCESS;
+	int fd, k, changed = 0;
+	FILE *f;
+
+	for (k = 0; k < PLAN_KIND_COUNT; k++)
+		changed |= stats[k].count != 0;
+	if (!changed)
+		return STATUS_SUCCESS;
+
+	fd = open(PLAN_STATS_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return STATUS_FILE_OPEN_ERROR;
+	f = fdopen(fd, "r+");
+	if (!f) {
+		close(fd);
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	if (flock(fd, LOCK_EX)) {
+		fclose(f);
+		return STATUS_FILE_LOCK_ERROR;
+	}
+	memcpy(totals, stats, sizeof(totals));
+	_stats_read(f, totals);
+	rewind(f);
+	if (ftruncate(fd, 0))
+		status = STATUS_FILE_WRITE_ERROR;
+	for (k = 0; k < PLAN_KIND_COUNT; k++) {
+		if (totals[k].count)
+			fprintf(f, "%s\t%lu\t%" PRIu64 "\n", plan_kinds[k].name,
+				totals[k].count, totals[k].total);
+	}
+	if (fflush(f))
+		status = STATUS_FILE_WRITE_ERROR;
+	fclose(f);
+	if (status == STATUS_SUCCESS)
+		memset(stats, 0, sizeof(stats));
+	return status;
+}
+
+void plan_print(FILE *f)
+{
+	struct plan_stats totals[PLAN_KIND_COUNT];
+	struct plan_entry *entry;
+	uint64_t estimate = 0;
+	int reads = 0, writes = 0, unknown = 0;
+	FILE *s;
+
+	if (!active)
+		return;
+	memcpy(totals, stats, sizeof(totals));
+	s = fopen(PLAN_STATS_FILE, "re");
+	if (s) {
+		flock(fileno(s), LOCK_SH);
+		_stats_read(s, totals);
+		fclose(s);
+	}
+
+	fprintf(f, "%-16s %-5s %6s %10s  %s\n", "TRANSACTION", "DIR", "BYTES",
+		"EXPECT_US", "PATH");
+	list_for_each(&entries, entry) {
+		const struct plan_stats *st = &totals[entry->kind];
+		char expect[24] = "-";
+
+		if (st->count) {
+			snprintf(expect, sizeof(expect), "%" PRIu64,
+				 st->total / st->count);
+			estimate += st->total / st->count;
+		} else {
+			unknown++;
+		}
+		if (entry->write)
+			writes++;
+		else
+			reads++;
+		fprintf(f, "%-16s %-5s %6zu %10s  %s\n",
+			plan_kinds[entry->kind].name,
+			entry->write ? "write" : "read", entry->len, expect,
+			entry->path ? entry->path : "-");
+	}
+	fprintf(f, "%d writes not issued, %d reads issued, expected %" PRIu64
+		" us", writes, reads, estimate);
+	if (unknown)
+		fprintf(f, " (%d transactions without statistics)", unknown);
+	fprintf(f, "\n");
+}
+
+void plan_fini(void)
+{
+	if (!active)
+		return;
+	list_erase(&entries);
+	active = 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _PLAN_H_INCLUDED_
+#define _PLAN_H_INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "status.h"
+
+/*
+ * Write plan and transaction statistics.
+ *
+ * Backends report each hardware transaction with plan_xfer() just before it
+ * is issued. Kinds of transactions are the same as of xfer_start probe, see
+ * probes.h. In plan mode the transactions which change LED state are only
+ * recorded and the backend behaves as if they succeeded. Reads which the
+ * messages are built from, e.g. SES status pages, are recorded and issued.
+ *
+ * Duration of issued transactions is accumulated with plan_stat() and saved
+ * to PLAN_STATS_FILE, so the plan can show expected latency of each
+ * transaction.
+ */
+
+/**
+ * File transaction statistics are shared in.
+ */
+#define PLAN_STATS_FILE		"/dev/shm/ledmon.xstats"
+
+/**
+ * @brief Switches to plan mode.
+ *
+ * @return The function does not return a value.
+ */
+void plan_begin(void);
+
+/**
+ * @brief Checks if plan mode is active.
+ *
+ * @return 1 if plan mode is active, otherwise 0.
+ */
+int plan_active(void);
+
+/**
+ * @brief Reports hardware transaction about to be issued.
+ *
+ * @param[in]    kind            - kind of transaction.
+ * @param[in]    path            - path of the target or NULL.
+ * @param[in]    len             - number of bytes transferred.
+ * @param[in]    write           - 1 if the transaction changes LED state.
+ *
+ * @return 1 if the transaction must not be issued, otherwise 0.
+ */
+int plan_xfer(const char *kind, const char *path, size_t len, int write);
+
+/**
+ * @brief Accumulates duration of issued transaction.
+ *
+ * @param[in]    kind            - kind of transaction.
+ * @param[in]    start           - start time in microseconds of monotonic
+ *                                 clock.
+ *
+ * @return The function does not return a value.
+ */
+void plan_stat(const char *kind, uint64_t start);
+
+/**
+ * @brief Adds statistics accumulated since the last call to PLAN_STATS_FILE.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t plan_stats_save(void);
+
+/**
+ * @brief Prints recorded transactions with expected latency.
+ *
+ * Expected latency of a transaction is the average duration of transactions
+ * of the same kind found in PLAN_STATS_FILE.
+ *
+ * @param[in]    f               - output stream.
+ *
+ * @return The function does not return a value.
+ */
+void plan_print(FILE *f);
+
+/**
+ * @brief Releases recorded transactions and leaves plan mode.
+ *
+ * @return The function does not return a value.
+ */
+void plan_fini(void);
+
+#endif				/* _PLAN_H_INCLUDED_ */
@@ -0,0 +1,194 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "config_file.h"
+#include "priority.h"
+#include "utils.h"
+
+/* glibc does not provide ioprio_set() and ioprio_get() wrappers */
+#define IOPRIO_WHO_PROCESS		1
+#define IOPRIO_CLASS_SHIFT		13
+#define IOPRIO_PRIO_VALUE(class, data)	(((class) << IOPRIO_CLASS_SHIFT) | (data))
+#define IOPRIO_PRIO_CLASS(mask)		((mask) >> IOPRIO_CLASS_SHIFT)
+#define IOPRIO_PRIO_DATA(mask)		((mask) & ((1 << IOPRIO_CLASS_SHIFT) - 1))
+
+static int boosted;
+
+static int _ioprio_set(int class, int level)
+{
+	return syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+		       IOPRIO_PRIO_VALUE(class, level));
+}
+
+static int _sched_set(enum sched_policy_enum policy)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	int p;
+
+	switch (policy) {
+	case SCHED_POLICY_BATCH:
+		p = SCHED_BATCH;
+		break;
+	case SCHED_POLICY_IDLE:
+		p = SCHED_IDLE;
+		break;
+	default:
+		p = SCHED_OTHER;
+		break;
+	}
+	return sched_setscheduler(0, p, &param);
+}
+
+/**
+ * Parses list of CPUs in format used by cpuset, e.g. "0-3,8".
+ */
+static int _parse_cpu_list(const char *s, cpu_set_t *set)
+{
+	char *end;
+	long first, last;
+
+	CPU_ZERO(set);
+	while (*s) {
+		first = strtol(s, &end, 10);
+		if (end == s || first < 0)
+			return -1;
+		last = first;
+		if (*end == '-') {
+			s = end + 1;
+			last = strtol(s, &end, 10);
+			if (end == s || last < first)
+				return -1;
+		}
+		if (last >= CPU_SETSIZE)
+			return -1;
+		for (; first <= last; first++)
+			CPU_SET(first, set);
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -1;
+		s = end;
+	}
+	return CPU_COUNT(set) ? 0 : -1;
+}
+
+static void _log_effective(void)
+{
+	char cpus[BUFSIZ] = "";
+	const char *policy;
+	cpu_set_t set;
+	int i, prio;
+
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (i = 0; i < CPU_SETSIZE; i++) {
+			int len = strlen(cpus);
+
+			if (CPU_ISSET(i, &set))
+				snprintf(cpus + len, sizeof(cpus) - len, "%s%d",
+					 len ? "," : "", i);
+		}
+	}
+	switch (sched_getscheduler(0)) {
+	case SCHED_BATCH:
+		policy = "batch";
+		break;
+	case SCHED_IDLE:
+		policy = "idle";
+		break;
+	case SCHED_OTHER:
+		policy = "normal";
+		break;
+	default:
+		policy = "other";
+		break;
+	}
+	prio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+	log_info("CPU affinity: %s, scheduling policy: %s, I/O class: %d, I/O level: %d",
+		 cpus, policy, prio < 0 ? -1 : (int)IOPRIO_PRIO_CLASS(prio),
+		 prio < 0 ? -1 : (int)IOPRIO_PRIO_DATA(prio));
+}
+
+status_t priority_init(void)
+{
+	status_t status = STATUS_SUCCESS;
+	cpu_set_t set;
+
+	if (conf.cpu_affinity) {
+		if (_parse_cpu_list(conf.cpu_affinity, &set)) {
+			log_error("Invalid CPU_AFFINITY: %s", conf.cpu_affinity);
+			status = STATUS_INVALID_FORMAT;
+		} else if (sched_setaffinity(0, sizeof(set), &set)) {
+			log_error("Unable to set CPU affinity %s: %s",
+				  conf.cpu_affinity, strerror(errno));
+			status = STATUS_INVALID_STATE;
+		}
+	}
+	if (conf.sched_policy != SCHED_POLICY_UNDEF &&
+	    _sched_set(conf.sched_policy)) {
+		log_error("Unable to set scheduling policy %s: %s",
+			  sched_policy_map[conf.sched_policy], strerror(errno));
+		status = STATUS_INVALID_STATE;
+	}
+	if (conf.io_class != IO_CLASS_UNDEF &&
+	    _ioprio_set(conf.io_class, conf.io_level)) {
+		log_error("Unable to set I/O priority %s: %s",
+			  io_class_map[conf.io_class], strerror(errno));
+		status = STATUS_INVALID_STATE;
+	}
+	_log_effective();
+	return status;
+}
+
+void priority_boost(void)
+{
+	if (boosted)
+		return;
+	if (conf.sched_policy == SCHED_POLICY_BATCH ||
+	    conf.sched_policy == SCHED_POLICY_IDLE)
+		_sched_set(SCHED_POLICY_NORMAL);
+	if (conf.io_class == IO_CLASS_IDLE ||
+	    (conf.io_class == IO_CLASS_BEST_EFFORT && conf.io_level > 0))
+		_ioprio_set(IO_CLASS_BEST_EFFORT, 0);
+	boosted = 1;
+}
+
+void priority_restore(void)
+{
+	if (!boosted)
+		return;
+	if (conf.sched_policy == SCHED_POLICY_BATCH ||
+	    conf.sched_policy == SCHED_POLICY_IDLE)
+		_sched_set(conf.sched_policy);
+	if (conf.io_class == IO_CLASS_IDLE ||
+	    (conf.io_class == IO_CLASS_BEST_EFFORT && conf.io_level > 0))
+		_ioprio_set(conf.io_class, conf.io_level);
+	boosted = 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _PRIORITY_H_INCLUDED_
+#define _PRIORITY_H_INCLUDED_
+
+#include "status.h"
+
+/**
+ * @brief Applies CPU affinity, scheduling policy and I/O priority.
+ *
+ * The function applies settings given in configuration (CPU_AFFINITY,
+ * SCHED_POLICY, IO_CLASS and IO_LEVEL) to the calling process and logs
+ * the effective settings. Settings which cannot be applied are logged and
+ * left unchanged.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t priority_init(void);
+
+/**
+ * @brief Temporarily raises scheduling policy and I/O priority.
+ *
+ * The function switches to normal scheduling policy and the highest
+ * best-effort I/O priority if configured settings are lower. It is used
+ * around urgent LED messages. The function does nothing if the priority is
+ * already raised.
+ *
+ * @return The function does not return a value.
+ */
+void priority_boost(void);
+
+/**
+ * @brief Restores configured scheduling policy and I/O priority.
+ *
+ * @return The function does not return a value.
+ */
+void priority_restore(void);
+
+#endif				/* _PRIORITY_H_INCLUDED_ */
@@ -0,0 +1,65 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _PROBES_H_INCLUDED_
+#define _PROBES_H_INCLUDED_
+
+/*
+ * USDT static tracepoints of provider "ledmon". A probe is a single nop
+ * instruction unless a tracer is attached, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/sbin/ledmon:ledmon:send_start
+ *                { printf("%s %d\n", str(arg1), arg2); }'
+ *
+ * Probes and their arguments:
+ *
+ *   scan_start(phase)                   start of sysfs_scan() phase
+ *   scan_end(phase)                     end of sysfs_scan() phase
+ *   state_change(path, from, to)        IBPI pattern of block device changed
+ *   send_start(cntrl_type, path, ibpi)  before send_fn invocation
+ *   send_end(cntrl_type, path, status)  after send_fn invocation
+ *   flush_start(cntrl_type, path)       before flush_fn invocation
+ *   flush_end(cntrl_type, path, status) after flush_fn invocation
+ *   udev_event(action, syspath)         udev event received
+ *   xfer_start(kind, path)              before hardware transaction
+ *   xfer_end(kind, path, status)        after hardware transaction
+ *
+ * Phase and kind arguments are strings, cntrl_type is enum cntrl_type,
+ * from, to and ibpi are enum ibpi_pattern values. Kind is one of "em_message",
+ * "amd_sgpio", "sg_receive_diag", "sg_send_diag", "smp", "ipmi" and
+ * "vmd_attention". The path of "ipmi" transaction is NULL.
+ */
+
+#if _HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE1(name, a)			DTRACE_PROBE1(ledmon, name, a)
+#define PROBE2(name, a, b)		DTRACE_PROBE2(ledmon, name, a, b)
+#define PROBE3(name, a, b, c)		DTRACE_PROBE3(ledmon, name, a, b, c)
+#else
+/* arguments are type checked but never evaluated */
+#define PROBE1(name, a) \
+	do { if (0) { (void)(a); } } while (0)
+#define PROBE2(name, a, b) \
+	do { if (0) { (void)(a); (void)(b); } } while (0)
+#define PROBE3(name, a, b, c) \
+	do { if (0) { (void)(a); (void)(b); (void)(c); } } while (0)
+#endif
+
+#endif				/* _PROBES_H_INCLUDED_ */
@@ -34,93 +34,82 @@
 #include "slave.h"
 #include "status.h"
 #include "sysfs.h"
+#include "token.h"
 #include "utils.h"
 
+static const struct token array_state_tokens[] = {
+	TOKEN("clear",         RAID_STATE_CLEAR),
+	TOKEN("inactive",      RAID_STATE_INACTIVE),
+	TOKEN("suspended",     RAID_STATE_SUSPENDED),
+	TOKEN("readonly",      RAID_STATE_READONLY),
+	TOKEN("read-auto",     RAID_STATE_READ_AUTO),
+	TOKEN("clean",         RAID_STATE_CLEAN),
+	TOKEN("active",        RAID_STATE_ACTIVE),
+	TOKEN("write-pending", RAID_STATE_WRITE_PENDING),
+	TOKEN("active-idle",   RAID_STATE_ACTIVE_IDLE),
+};
+
+static const struct token sync_action_tokens[] = {
+	TOKEN("idle",    RAID_ACTION_IDLE),
+	TOKEN("reshape", RAID_ACTION_RESHAPE),
+	TOKEN("frozen",  RAID_ACTION_FROZEN),
+	TOKEN("resync",  RAID_ACTION_RESYNC),
+	TOKEN("check",   RAID_ACTION_CHECK),
+	TOKEN("recover", RAID_ACTION_RECOVER),
+	TOKEN("repair",  RAID_ACTION_REPAIR),
+};
+
+static const struct token level_tokens[] = {
+	TOKEN("raid0",  RAID_LEVEL_0),
+	TOKEN("raid1",  RAID_LEVEL_1),
+	TOKEN("raid10", RAID_LEVEL_10),
+	TOKEN("raid4",  RAID_LEVEL_4),
+	TOKEN("raid5",  RAID_LEVEL_5),
+	TOKEN("raid6",  RAID_LEVEL_6),
+	TOKEN("linear", RAID_LEVEL_LINEAR),
+	TOKEN("faulty", RAID_LEVEL_FAULTY),
+};
+
 /**
+ * Reads sysfs attribute and maps it to a value of token table.
  */
-static enum raid_state _get_array_state(const char *path)
+static int _get_token(const char *path, const char *name,
+		      const struct token *table, size_t count, int defval)
 {
-	enum raid_state state = RAID_STATE_UNKNOWN;
+	char *p = get_text(path, name);
 
-	char *p = get_text(path, "md/array_state");
 	if (p) {
-		if (strcmp(p, "clear") == 0)
-			state = RAID_STATE_CLEAR;
-		else if (strcmp(p, "inactive") == 0)
-			state = RAID_STATE_INACTIVE;
-		else if (strcmp(p, "suspended") == 0)
-			state = RAID_STATE_SUSPENDED;
-		else if (strcmp(p, "readonly") == 0)
-			state = RAID_STATE_READONLY;
-		else if (strcmp(p, "read-auto") == 0)
-			state = RAID_STATE_READ_AUTO;
-		else if (strcmp(p, "clean") == 0)
-			state = RAID_STATE_CLEAN;
-		else if (strcmp(p, "active") == 0)
-			state = RAID_STATE_ACTIVE;
-		else if (strcmp(p, "write-pending") == 0)
-			state = RAID_STATE_WRITE_PENDING;
-		else if (strcmp(p, "active-idle") == 0)
-			state = RAID_STATE_ACTIVE_IDLE;
+		int value = token_find(table, count, p);
+
+		if (value >= 0)
+			defval = value;
 		free(p);
 	}
-	return state;
+	return defval;
 }
 
 /**
  */
-static enum raid_action _get_sync_action(const char *path)
+static enum raid_state _get_array_state(const char *path)
 {
-	enum raid_action action = RAID_ACTION_UNKNOWN;
+	return _get_token(path, "md/array_state", array_state_tokens,
+			  TOKEN_COUNT(array_state_tokens), RAID_STATE_UNKNOWN);
+}
 
-	char *p = get_text(path, "md/sync_action");
-	if (p) {
-		if (strcmp(p, "idle") == 0)
-			action = RAID_ACTION_IDLE;
-		else if (strcmp(p, "reshape") == 0)
-			action = RAID_ACTION_RESHAPE;
-		else if (strcmp(p, "frozen") == 0)
-			action = RAID_ACTION_FROZEN;
-		else if (strcmp(p, "resync") == 0)
-			action = RAID_ACTION_RESYNC;
-		else if (strcmp(p, "check") == 0)
-			action = RAID_ACTION_CHECK;
-		else if (strcmp(p, "recover") == 0)
-			action = RAID_ACTION_RECOVER;
-		else if (strcmp(p, "repair") == 0)
-			action = RAID_ACTION_REPAIR;
-		free(p);
-	}
-	return action;
+/**
+ */
+static enum raid_action _get_sync_action(const char *path)
+{
+	return _get_token(path, "md/sync_action", sync_action_tokens,
+			  TOKEN_COUNT(sync_action_tokens), RAID_ACTION_UNKNOWN);
 }
 
 /**
  */
 static enum raid_level _get_level(const char *path)
 {
-	enum raid_level result = RAID_LEVEL_UNKNOWN;
-
-	char *p = get_text(path, "md/level");
-	if (p) {
-		if (strcmp(p, "raid0") == 0)
-			result = RAID_LEVEL_0;
-		else if (strcmp(p, "raid1") == 0)
-			result = RAID_LEVEL_1;
-		else if (strcmp(p, "raid10") == 0)
-			result = RAID_LEVEL_10;
-		else if (strcmp(p, "raid4") == 0)
-			result = RAID_LEVEL_4;
-		else if (strcmp(p, "raid5") == 0)
-			result = RAID_LEVEL_5;
-		else if (strcmp(p, "raid6") == 0)
-			result = RAID_LEVEL_6;
-		else if (strcmp(p, "linear") == 0)
-			result = RAID_LEVEL_LINEAR;
-		else if (strcmp(p, "faulty") == 0)
-			result = RAID_LEVEL_FAULTY;
-		free(p);
-	}
-	return result;
+	return _get_token(path, "md/level", level_tokens,
+			  TOKEN_COUNT(level_tokens), RAID_LEVEL_UNKNOWN);
 }
 
 /**
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +33,7 @@
 #include <dmalloc.h>
 #endif
 
+#include <scsi/scsi.h>
 #include <scsi/sg_lib.h>
 #include <scsi/sg_cmds_extra.h>
 
@@ -39,22 +41,55 @@
 #include "config.h"
 #include "enclosure.h"
 #include "list.h"
+#include "plan.h"
+#include "probes.h"
 #include "scsi.h"
 #include "ses.h"
 #include "status.h"
 #include "sysfs.h"
+#include "topology.h"
 #include "utils.h"
+#include "xfer.h"
+
+/**
+ * Time in microseconds between checks of a command in flight.
+ */
+#define SES_POLL_WAIT	1000
+
+/**
+ * Time in milliseconds the enclosure has to complete a command.
+ */
+#define SES_CMD_TIMEOUT	60000
+
+/**
+ * Steps of SES transaction, see xfer.h. Page 1 and page 2 are read when the
+ * first message is sent and page 2 is sent back by the first flush.
+ */
+enum ses_step {
+	SES_STEP_LOAD = 1,
+	SES_STEP_STATUS = 2,
+	SES_STEP_SEND = XFER_FLUSH | 1,
+};
 
 static int debug = 0;
 
-static int get_ses_page(int fd, struct ses_page *p, int pg_code)
+static int get_ses_page(struct enclosure_device *enclosure, int fd,
+			struct ses_page *p, int pg_code)
 {
 	int ret;
 	int retry_count = 3;
+	uint64_t start;
 
 	do {
+		plan_xfer("sg_receive_diag", enclosure->sysfs_path,
+			  sizeof(p->buf), 0);
+		start = get_monotonic_us();
+		PROBE2(xfer_start, "sg_receive_diag", enclosure->sysfs_path);
 		ret = sg_ll_receive_diag(fd, 1, pg_code, p->buf, sizeof(p->buf),
 					 0, debug);
+		PROBE3(xfer_end, "sg_receive_diag", enclosure->sysfs_path,
+		       ret);
+		plan_stat("sg_receive_diag", start);
 	} while (ret && retry_count--);
 
 	if (!ret)
@@ -122,16 +157,6 @@ static struct ses_pages *ses_init(void)
 	return NULL;
 }
 
-static void ses_free(struct ses_pages *sp)
-{
-	if (!sp)
-		return;
-	free(sp->page1);
-	free(sp->page2);
-	free(sp->page10);
-	free(sp);
-}
-
 static void dump_p10(unsigned char *p)
 {
 	int i;
@@ -154,45 +179,283 @@ static int enclosure_open(const struct enclosure_device *enclosure)
 	return fd;
 }
 
-static int enclosure_load_pages(struct enclosure_device *enclosure)
+/**
+ * @brief Finds element of the slot in page 2.
+ *
+ * Array Device Slot element is preferred over Device Slot element.
+ *
+ * @return Pointer to the element in page 2 or NULL if the slot is not found.
+ */
+static struct ses_slot_ctrl_elem *ses_find_slot(struct ses_pages *sp, int idx,
+						element_type *type)
 {
-	int ret;
-	int fd;
-	struct ses_pages *sp;
+	/* Move do descriptors */
+	struct ses_slot_ctrl_elem *descriptors = (void *)(sp->page2->buf + 8);
+	struct ses_slot_ctrl_elem *desc_element = NULL;
+	int i;
 
-	if (enclosure->ses_pages)
-		return 0;
+	*type = SES_UNSPECIFIED;
+	for (i = 0; i < sp->page1_types_len; i++) {
+		struct type_descriptor_header *t = &sp->page1_types[i];
 
-	fd = enclosure_open(enclosure);
-	if (fd == -1)
-		return 1;
+		descriptors++; /* At first, skip overall header. */
 
-	sp = ses_init();
-	if (!sp) {
-		ret = 1;
-		goto end;
+		if (t->element_type == SES_DEVICE_SLOT ||
+		    t->element_type == SES_ARRAY_DEVICE_SLOT) {
+			if (*type < t->element_type &&
+			    t->num_of_elements > idx) {
+				*type = t->element_type;
+				desc_element = &descriptors[idx];
+			}
+		} else {
+			/*
+			 * Device Slot and Array Device Slot elements are
+			 * always first on the type descriptor header list
+			 */
+			break;
+		}
+
+		descriptors += t->num_of_elements;
 	}
+	return desc_element;
+}
 
-	/* Read configuration. */
-	ret = get_ses_page(fd, sp->page1, ENCL_CFG_DIAG_STATUS);
-	if (ret)
-		goto end;
+/**
+ * @brief Saves status codes of slots before page 2 is modified.
+ */
+static void ses_save_slot_status(struct ses_pages *sp)
+{
+	struct ses_slot_ctrl_elem *el;
+	element_type type;
+	int i, count = 0;
 
-	ret = process_page1(sp);
-	if (ret)
-		goto end;
+	for (i = 0; i < sp->page1_types_len; i++) {
+		struct type_descriptor_header *t = &sp->page1_types[i];
 
-	/* Get Enclosure Status */
-	ret = get_ses_page(fd, sp->page2, ENCL_CTRL_DIAG_STATUS);
-end:
-	close(fd);
-	if (ret)
-		ses_free(sp);
+		if (t->element_type != SES_DEVICE_SLOT &&
+		    t->element_type != SES_ARRAY_DEVICE_SLOT)
+			break;
+		if (t->num_of_elements > count)
+			count = t->num_of_elements;
+	}
+	if (!count)
+		return;
+	sp->slot_status = calloc(count, sizeof(*sp->slot_status));
+	if (!sp->slot_status)
+		return;
+	for (i = 0; i < count; i++) {
+		el = ses_find_slot(sp, i, &type);
+		sp->slot_status[i] = el ? el->common_control & 0x0f :
+			SES_STATUS_UNSUPPORTED;
+	}
+	sp->slot_status_len = count;
+}
+
+static void enclosure_free_pages(struct enclosure_device *enclosure)
+{
+	ses_free(enclosure->ses_pages);
+	enclosure->ses_pages = NULL;
+}
+
+/**
+ * @brief Submits the command of the enclosure to sg driver.
+ *
+ * RECEIVE DIAGNOSTIC RESULTS reads the page into the pages being read and
+ * SEND DIAGNOSTIC sends page 2 of the enclosure.
+ *
+ * @return 0 if the command is in flight, otherwise 1.
+ */
+static int ses_cmd_submit(struct enclosure_device *enclosure)
+{
+	struct ses_cmd *cmd = enclosure->cmd;
+	struct ses_page *p;
+
+	if (cmd->pg_code == ENCL_CFG_DIAG_STATUS)
+		p = cmd->sp->page1;
+	else if (cmd->pg_code == ENCL_CTRL_DIAG_STATUS)
+		p = cmd->sp->page2;
 	else
-		enclosure->ses_pages = sp;
+		p = enclosure->ses_pages->page2;
+
+	memset(&cmd->hdr, 0, sizeof(cmd->hdr));
+	memset(cmd->cdb, 0, sizeof(cmd->cdb));
+	if (cmd->pg_code) {
+		cmd->cdb[0] = RECEIVE_DIAGNOSTIC;
+		cmd->cdb[1] = 0x01;	/* PCV */
+		cmd->cdb[2] = cmd->pg_code;
+		cmd->cdb[3] = sizeof(p->buf) >> 8;
+		cmd->cdb[4] = sizeof(p->buf) & 0xff;
+		cmd->hdr.dxfer_direction = SG_DXFER_FROM_DEV;
+		cmd->hdr.dxfer_len = sizeof(p->buf);
+		plan_xfer("sg_receive_diag", enclosure->sysfs_path,
+			  sizeof(p->buf), 0);
+		PROBE2(xfer_start, "sg_receive_diag", enclosure->sysfs_path);
+	} else {
+		cmd->cdb[0] = SEND_DIAGNOSTIC;
+		cmd->cdb[1] = 0x10;	/* PF */
+		cmd->cdb[3] = p->len >> 8;
+		cmd->cdb[4] = p->len & 0xff;
+		cmd->hdr.dxfer_direction = SG_DXFER_TO_DEV;
+		cmd->hdr.dxfer_len = p->len;
+		PROBE2(xfer_start, "sg_send_diag", enclosure->sysfs_path);
+	}
+	cmd->hdr.interface_id = 'S';
+	cmd->hdr.cmdp = cmd->cdb;
+	cmd->hdr.cmd_len = sizeof(cmd->cdb);
+	cmd->hdr.dxferp = p->buf;
+	cmd->hdr.sbp = cmd->sense;
+	cmd->hdr.mx_sb_len = sizeof(cmd->sense);
+	cmd->hdr.timeout = SES_CMD_TIMEOUT;
+	cmd->start = get_monotonic_us();
+
+	if (cmd->fd < 0 && enclosure->dev_path)
+		cmd->fd = open(enclosure->dev_path, O_RDWR | O_NONBLOCK);
+	if (cmd->fd < 0)
+		return 1;
+	if (write(cmd->fd, &cmd->hdr, sizeof(cmd->hdr)) < 0) {
+		log_debug("SES: Unable to submit command to %s: %s",
+			  enclosure->dev_path, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Starts a command of the enclosure.
+ *
+ * @param[in]    enclosure       - enclosure device, no command in flight.
+ * @param[in]    pg_code         - page to read, 0 to send page 2.
+ *
+ * @return 0 if the command is in flight, otherwise 1.
+ */
+static int ses_cmd_start(struct enclosure_device *enclosure, int pg_code)
+{
+	struct ses_cmd *cmd;
+
+	cmd = calloc(1, sizeof(*cmd));
+	if (!cmd)
+		return 1;
+	cmd->fd = -1;
+	cmd->pg_code = pg_code;
+	cmd->retries = 3;
+	if (pg_code) {
+		cmd->sp = ses_init();
+		if (!cmd->sp) {
+			free(cmd);
+			return 1;
+		}
+	}
+	enclosure->cmd = cmd;
+	if (ses_cmd_submit(enclosure) == 0)
+		return 0;
+	enclosure->cmd = NULL;
+	ses_cmd_free(cmd);
+	return 1;
+}
+
+/**
+ * @brief Continues the command of the enclosure.
+ *
+ * Reading of page 1 is followed by reading of page 2 and the pages become
+ * the pages of the enclosure. A failed read is retried. When page 2 has been
+ * sent its status is stored and the pages are released.
+ *
+ * @param[in]    enclosure       - enclosure device.
+ * @param[in]    timeout         - time in milliseconds to wait for completion,
+ *                                 -1 to wait until the command completes.
+ *
+ * @return -EAGAIN if a command is in flight, status of failed read, otherwise
+ *         0.
+ */
+static int ses_cmd_wait(struct enclosure_device *enclosure, int timeout)
+{
+	struct ses_cmd *cmd = enclosure->cmd;
+	struct pollfd pfd;
+	struct ses_page *p;
+	int ret;
+
+	if (!cmd)
+		return 0;
+	pfd.fd = cmd->fd;
+	pfd.events = POLLIN;
+	ret = poll(&pfd, 1, timeout);
+	if (ret == 0 || (ret < 0 && errno == EINTR))
+		return -EAGAIN;
+	ret = ret < 0 || read(cmd->fd, &cmd->hdr, sizeof(cmd->hdr)) < 0 ||
+	      (cmd->hdr.info & SG_INFO_OK_MASK) != SG_INFO_OK;
+
+	if (!cmd->pg_code) {
+		PROBE3(xfer_end, "sg_send_diag", enclosure->sysfs_path, ret);
+		plan_stat("sg_send_diag", cmd->start);
+		enclosure->flush_status = ret;
+		enclosure_free_pages(enclosure);
+		enclosure->cmd = NULL;
+		ses_cmd_free(cmd);
+		return 0;
+	}
+	PROBE3(xfer_end, "sg_receive_diag", enclosure->sysfs_path, ret);
+	plan_stat("sg_receive_diag", cmd->start);
+	if (ret && cmd->retries-- && ses_cmd_submit(enclosure) == 0)
+		return -EAGAIN;
+	if (!ret) {
+		p = cmd->pg_code == ENCL_CFG_DIAG_STATUS ? cmd->sp->page1 :
+							   cmd->sp->page2;
+		p->len = (p->buf[2] << 8) + p->buf[3] + 4;
+		if (cmd->pg_code == ENCL_CFG_DIAG_STATUS)
+			ret = process_page1(cmd->sp);
+		if (!ret && cmd->pg_code == ENCL_CFG_DIAG_STATUS) {
+			cmd->pg_code = ENCL_CTRL_DIAG_STATUS;
+			cmd->retries = 3;
+			if (ses_cmd_submit(enclosure) == 0)
+				return -EAGAIN;
+			ret = 1;
+		}
+	}
+	if (!ret) {
+		ses_save_slot_status(cmd->sp);
+		cmd->sp->loaded = time(NULL);
+		enclosure->ses_pages = cmd->sp;
+		enclosure->flush_status = 0;
+		cmd->sp = NULL;
+	}
+	enclosure->cmd = NULL;
+	ses_cmd_free(cmd);
 	return ret;
 }
 
+/**
+ * @brief Reads page 1 and page 2 of the enclosure.
+ *
+ * Page 2 which is being sent is sent first, so the pages are read again.
+ *
+ * @param[in]    enclosure       - enclosure device.
+ * @param[in]    timeout         - time in milliseconds to wait for the
+ *                                 command in flight, -1 to wait until the
+ *                                 pages are read.
+ *
+ * @return 0 if the pages are read, -EAGAIN if a command is in flight,
+ *         otherwise error.
+ */
+static int enclosure_load_pages(struct enclosure_device *enclosure,
+				int timeout)
+{
+	int ret = 0;
+
+	while (!enclosure->ses_pages || enclosure->cmd) {
+		if (!enclosure->cmd) {
+			if (ret)
+				return ret;
+			ret = ses_cmd_start(enclosure, ENCL_CFG_DIAG_STATUS);
+			if (ret)
+				return ret;
+		}
+		ret = ses_cmd_wait(enclosure, timeout);
+		if (ret == -EAGAIN)
+			return ret;
+	}
+	return 0;
+}
+
 static int enclosure_load_page10(struct enclosure_device *enclosure)
 {
 	int ret;
@@ -202,7 +465,7 @@ static int enclosure_load_page10(struct enclosure_device *enclosure)
 	if (enclosure->ses_pages && enclosure->ses_pages->page10)
 		return 0;
 
-	ret = enclosure_load_pages(enclosure);
+	ret = enclosure_load_pages(enclosure, -1);
 	if (ret)
 		return ret;
 
@@ -217,7 +480,7 @@ static int enclosure_load_page10(struct enclosure_device *enclosure)
 	}
 
 	/* Additional Element Status */
-	ret = get_ses_page(fd, p, ENCL_ADDITIONAL_EL_STATUS);
+	ret = get_ses_page(enclosure, fd, p, ENCL_ADDITIONAL_EL_STATUS);
 end:
 	close(fd);
 	if (ret)
@@ -228,12 +491,6 @@ end:
 	return ret;
 }
 
-static void enclosure_free_pages(struct enclosure_device *enclosure)
-{
-	ses_free(enclosure->ses_pages);
-	enclosure->ses_pages = NULL;
-}
-
 static void print_page10(struct ses_pages *sp)
 {
 	unsigned char *ai = sp->page10->buf + 8;
@@ -410,43 +667,72 @@ static int ses_set_message(enum ibpi_pattern ibpi, struct ses_slot_ctrl_elem *el
 	return 0;
 }
 
-static int ses_write_msg(enum ibpi_pattern ibpi, struct block_device *device)
+/**
+ * Sets bits of indications shown together with the pattern. Each of them has
+ * its own bit in the control element.
+ */
+static void ses_set_indications(unsigned int mask,
+				struct ses_slot_ctrl_elem *el)
 {
-	struct ses_pages *sp = device->enclosure->ses_pages;
-	int idx = device->encl_index;
-	/* Move do descriptors */
-	struct ses_slot_ctrl_elem *descriptors = (void *)(sp->page2->buf + 8);
-	int i;
-	struct ses_slot_ctrl_elem *desc_element = NULL;
-	element_type local_element_type = SES_UNSPECIFIED;
-
-	for (i = 0; i < sp->page1_types_len; i++) {
-		struct type_descriptor_header *t = &sp->page1_types[i];
+	if (mask & IBPI_MASK(IBPI_PATTERN_PFA))
+		_set_prdfail(el->b);
+	if (mask & IBPI_MASK(IBPI_PATTERN_REBUILD))
+		_set_rebuild(el->b);
+	if (mask & IBPI_MASK(IBPI_PATTERN_LOCATE))
+		_set_ident(el->b);
+	if (mask & IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE))
+		_set_fault(el->b);
+}
 
-		descriptors++; /* At first, skip overall header. */
+/**
+ * Keeps IDENT and FAULT bits set by another process, e.g. by ledctl while
+ * ledmon is running. They are kept unless this process has set them itself
+ * with the state last applied or locate_off is requested. The first message
+ * sent by this process sets the bits as requested.
+ */
+static void ses_keep_other_bits(struct block_device *device,
+				enum ibpi_pattern ibpi,
+				const struct ses_slot_ctrl_elem *status,
+				struct ses_slot_ctrl_elem *el)
+{
+	struct ses_slot_ctrl_elem own, bit;
 
-		if (t->element_type == SES_DEVICE_SLOT ||
-		    t->element_type == SES_ARRAY_DEVICE_SLOT) {
-			if (local_element_type < t->element_type &&
-			    t->num_of_elements > idx) {
-				local_element_type = t->element_type;
-				desc_element = &descriptors[idx];
-			}
-		} else {
-			/*
-			 * Device Slot and Array Device Slot elements are
-			 * always first on the type descriptor header list
-			 */
-			break;
-		}
+	if (device->ibpi_prev < IBPI_PATTERN_NORMAL ||
+	    device->ibpi_prev > SES_REQ_FAULT)
+		return;
+	memset(&own, 0, sizeof(own));
+	if (ses_set_message(device->ibpi_prev, &own))
+		return;
+	ses_set_indications(device->ibpi_mask_prev, &own);
+
+	memset(&bit, 0, sizeof(bit));
+	_set_ident(bit.b);
+	if ((status->b2 & bit.b2) && !(own.b2 & bit.b2) &&
+	    ibpi != IBPI_PATTERN_LOCATE_OFF)
+		_set_ident(el->b);
+	memset(&bit, 0, sizeof(bit));
+	_set_fault(bit.b);
+	if ((status->b3 & bit.b3) && !(own.b3 & bit.b3))
+		_set_fault(el->b);
+}
 
-		descriptors += t->num_of_elements;
-	}
+static int ses_write_msg(enum ibpi_pattern ibpi, struct block_device *device)
+{
+	struct ses_slot_ctrl_elem *desc_element, status;
+	element_type local_element_type;
 
+	desc_element = ses_find_slot(device->enclosure->ses_pages,
+				     device->encl_index, &local_element_type);
 	if (desc_element) {
-		int ret = ses_set_message(ibpi, desc_element);
+		int ret;
+
+		status = *desc_element;
+		ret = ses_set_message(ibpi, desc_element);
 		if (ret)
 			return ret;
+		ses_set_indications(block_indications(device, ibpi),
+				    desc_element);
+		ses_keep_other_bits(device, ibpi, &status, desc_element);
 		/* keep PRDFAIL, clear rest */
 		desc_element->common_control &= 0x40;
 		/* set select */
@@ -462,20 +748,23 @@ static int ses_write_msg(enum ibpi_pattern ibpi, struct block_device *device)
 	return 1;
 }
 
+/**
+ * @brief Starts sending page 2 of the enclosure.
+ *
+ * The pages are released once page 2 has been sent, see ses_cmd_wait().
+ *
+ * @return 0 if page 2 is in flight or it has been sent, otherwise 1.
+ */
 static int ses_send_diag(struct enclosure_device *enclosure)
 {
-	int ret;
-	int fd;
-
-	fd = enclosure_open(enclosure);
-	if (fd == -1)
-		return 1;
+	int ret = 0;
 
-	ret = sg_ll_send_diag(fd, 0, 1, 0, 0, 0, 0,
-			      enclosure->ses_pages->page2->buf,
-			      enclosure->ses_pages->page2->len,
-			      0, debug);
-	close(fd);
+	if (plan_xfer("sg_send_diag", enclosure->sysfs_path,
+		      enclosure->ses_pages->page2->len, 1) ||
+	    (ret = ses_cmd_start(enclosure, 0))) {
+		enclosure->flush_status = ret;
+		enclosure_free_pages(enclosure);
+	}
 	return ret;
 }
 
@@ -539,6 +828,10 @@ static int get_encl_slot(struct block_device *device)
 	if (idx != -1)
 		return idx;
 
+	/* trusted topology manifest saves reading of Page10 */
+	if (topology_slot(device->sysfs_path, &idx))
+		return idx;
+
 	/*
 	 * Older kernels may not have the "slot" sysfs attribute,
 	 * fallback to Page10 method.
@@ -646,6 +939,8 @@ int scsi_get_enclosure(struct block_device *device)
 		if (_slot_match(encl->sysfs_path, device->cntrl_path)) {
 			device->enclosure = encl;
 			device->encl_index = get_encl_slot(device);
+			topology_check_slot(device->sysfs_path,
+					    device->encl_index);
 			break;
 		}
 	}
@@ -663,14 +958,33 @@ int scsi_ses_write(struct block_device *device, enum ibpi_pattern ibpi)
 	    device->encl_index == -1)
 		__set_errno_and_return(EINVAL);
 
+	/* the pages read for status of the slots, see scsi_ses_slot_refresh() */
+	if (device->xfer_step == SES_STEP_STATUS) {
+		if (device->enclosure->cmd &&
+		    ses_cmd_wait(device->enclosure, 0) == -EAGAIN) {
+			xfer_wait(device, SES_STEP_STATUS,
+				  get_monotonic_us() + SES_POLL_WAIT);
+			return 0;
+		}
+		xfer_done(device);
+	}
+
 	/* write only if state has changed */
-	if (ibpi == device->ibpi_prev)
-		return 1;
+	if (!block_state_changed(device, ibpi)) {
+		xfer_done(device);
+		return 0;
+	}
 
 	if ((ibpi < IBPI_PATTERN_NORMAL) || (ibpi > SES_REQ_FAULT))
 		__set_errno_and_return(ERANGE);
 
-	ret = enclosure_load_pages(device->enclosure);
+	ret = enclosure_load_pages(device->enclosure, 0);
+	if (ret == -EAGAIN) {
+		xfer_wait(device, SES_STEP_LOAD,
+			  get_monotonic_us() + SES_POLL_WAIT);
+		return 0;
+	}
+	xfer_done(device);
 	if (ret) {
 		log_warning
 		    ("Unable to send %s message to %s. Device is missing?",
@@ -678,23 +992,100 @@ int scsi_ses_write(struct block_device *device, enum ibpi_pattern ibpi)
 		return ret;
 	}
 
+	/* the pages carry a message now, so they are sent */
+	device->enclosure->status_pages = 0;
 	return ses_write_msg(ibpi, device);
 }
 
 int scsi_ses_flush(struct block_device *device)
 {
-	int ret;
+	struct enclosure_device *enclosure;
 
 	if (!device || !device->enclosure)
-		return 1;
+		__set_errno_and_return(ENODEV);
+	enclosure = device->enclosure;
 
-	if (!device->enclosure->ses_pages)
+	/* pages read only for status of the slots are not sent back */
+	if (enclosure->status_pages && !enclosure->cmd) {
+		enclosure_free_pages(enclosure);
+		enclosure->status_pages = 0;
 		return 0;
+	}
 
-	ret = ses_send_diag(device->enclosure);
+	/*
+	 * Page 2 is shared by all slots of the enclosure, so it is sent with
+	 * the first flush and every other device reports the same status.
+	 * Devices flushed while page 2 is in flight wait for it as well.
+	 */
+	if (!xfer_flushing(device) && !enclosure->cmd && enclosure->ses_pages &&
+	    ses_send_diag(enclosure))
+		return enclosure->flush_status;
+
+	if (enclosure->cmd && !enclosure->cmd->pg_code &&
+	    ses_cmd_wait(enclosure, 0) == -EAGAIN) {
+		xfer_wait(device, SES_STEP_SEND,
+			  get_monotonic_us() + SES_POLL_WAIT);
+		return 0;
+	}
+	if (xfer_flushing(device))
+		xfer_done(device);
+	return enclosure->flush_status;
+}
 
-	enclosure_free_pages(device->enclosure);
-	return ret;
+/**
+ */
+int scsi_ses_slot_status(struct block_device *device, time_t since)
+{
+	struct ses_pages *sp;
+
+	if (!device || !device->enclosure || device->encl_index == -1)
+		return -1;
+	sp = device->enclosure->ses_pages;
+	if (!sp || sp->loaded < since ||
+	    device->encl_index >= sp->slot_status_len)
+		return -1;
+	return sp->slot_status[device->encl_index];
+}
+
+void scsi_ses_slot_refresh(struct block_device *device)
+{
+	struct enclosure_device *enclosure = device->enclosure;
+
+	if (!enclosure || device->encl_index == -1 || xfer_pending(device))
+		return;
+	/* pages being sent with a message report the status anyway */
+	if (enclosure->ses_pages && !enclosure->cmd)
+		return;
+	if (!enclosure->cmd) {
+		if (ses_cmd_start(enclosure, ENCL_CFG_DIAG_STATUS))
+			return;
+		enclosure->status_pages = 1;
+	}
+	xfer_wait(device, SES_STEP_STATUS, get_monotonic_us() + SES_POLL_WAIT);
+}
+
+int scsi_ses_get_leds(struct block_device *device)
+{
+	struct ses_slot_ctrl_elem *el, bit;
+	element_type type;
+	int leds = 0;
+
+	if (!device->enclosure || device->encl_index == -1 ||
+	    enclosure_load_pages(device->enclosure, -1))
+		return -1;
+	el = ses_find_slot(device->enclosure->ses_pages, device->encl_index,
+			   &type);
+	if (!el)
+		return -1;
+	memset(&bit, 0, sizeof(bit));
+	_set_ident(bit.b);
+	if (el->b2 & bit.b2)
+		leds |= IBPI_MASK(IBPI_PATTERN_LOCATE);
+	memset(&bit, 0, sizeof(bit));
+	_set_fault(bit.b);
+	if (el->b3 & bit.b3)
+		leds |= IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE);
+	return leds;
 }
 
 /**
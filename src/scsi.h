@@ -20,6 +20,8 @@
 #ifndef _SCSI_H_INCLUDED
 #define _SCSI_H_INCLUDED
 
+#include <time.h>
+
 #include "block.h"
 #include "ibpi.h"
 
@@ -59,6 +61,46 @@ int scsi_ses_write(struct block_device *device, enum ibpi_pattern ibpi);
  */
 int scsi_ses_flush(struct block_device *device);
 
+/**
+ * @brief Gets status of the slot reported by an enclosure.
+ *
+ * The status is decoded from page 2 which has been read to send a message to
+ * the enclosure, so the function never reads from the enclosure itself.
+ *
+ * @param[in]      device         Block device in enclosure.
+ * @param[in]      since          Pages read before this time are ignored.
+ *
+ * @return Element status code, see enum ses_elem_status, or -1 if the status
+ *         of the slot is not known.
+ */
+int scsi_ses_slot_status(struct block_device *device, time_t since);
+
+/**
+ * @brief Reads status of the slots of the enclosure again.
+ *
+ * Page 1 and page 2 are read as a transaction of the device, see xfer.h,
+ * if no message is being sent to the enclosure. Nothing is sent back, the
+ * pages are released by the next flush.
+ *
+ * @param[in]      device         Block device in enclosure.
+ *
+ * @return The function does not return a value.
+ */
+void scsi_ses_slot_refresh(struct block_device *device);
+
+/**
+ * @brief Gets Locate and Failure LEDs of the slot from page 2.
+ *
+ * The pages are read if they are not loaded yet and they are kept for the
+ * next message.
+ *
+ * @param[in]      device         Block device in enclosure.
+ *
+ * @return IBPI_MASK() of the patterns whose LEDs are on, or -1 if the LEDs
+ *         cannot be read.
+ */
+int scsi_ses_get_leds(struct block_device *device);
+
 /**
  * @brief Assigns enclosure device to block device.
  *
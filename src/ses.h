@@ -21,6 +21,11 @@
 #define _SES_H_INCLUDED_
 
 #include <asm/types.h>
+#include <scsi/sg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 /* Size of buffer for SES-2 Messages. */
 #define SES_ALLOC_BUFF 4096
@@ -38,6 +43,19 @@ typedef enum __attribute__((packed)) {
 	SES_ARRAY_DEVICE_SLOT	= 0x17,
 } element_type;
 
+/* Element status codes reported in status elements of page 2. */
+enum ses_elem_status {
+	SES_STATUS_UNSUPPORTED		= 0x00,
+	SES_STATUS_OK			= 0x01,
+	SES_STATUS_CRITICAL		= 0x02,
+	SES_STATUS_NONCRITICAL		= 0x03,
+	SES_STATUS_UNRECOVERABLE	= 0x04,
+	SES_STATUS_NOT_INSTALLED	= 0x05,
+	SES_STATUS_UNKNOWN		= 0x06,
+	SES_STATUS_NOT_AVAILABLE	= 0x07,
+	SES_STATUS_NO_ACCESS		= 0x08,
+};
+
 static inline void _set_prdfail(unsigned char *u)
 {
 	u[0] |= (1 << 6);
@@ -156,8 +174,62 @@ struct ses_pages {
 	struct ses_page *page10;
 	struct type_descriptor_header *page1_types;
 	int page1_types_len;
+	/* status codes of slots as read, page 2 is reused for control */
+	__u8 *slot_status;
+	int slot_status_len;
+	/* time when the pages have been read */
+	time_t loaded;
+};
+
+/**
+ * @brief Releases SES pages read from an enclosure.
+ *
+ * @param[in]    sp              - pages to release, may be NULL.
+ *
+ * @return The function does not return a value.
+ */
+static inline void ses_free(struct ses_pages *sp)
+{
+	if (!sp)
+		return;
+	free(sp->page1);
+	free(sp->page2);
+	free(sp->page10);
+	free(sp->slot_status);
+	free(sp);
+}
+
+/* SCSI command sent to an enclosure through sg driver without blocking. */
+struct ses_cmd {
+	int fd;
+	struct sg_io_hdr hdr;
+	unsigned char cdb[6];
+	unsigned char sense[32];
+	/* page code of RECEIVE DIAGNOSTIC RESULTS, 0 for SEND DIAGNOSTIC */
+	int pg_code;
+	int retries;
+	/* pages being read */
+	struct ses_pages *sp;
+	uint64_t start;
 };
 
+/**
+ * @brief Releases SCSI command, the command in flight is abandoned.
+ *
+ * @param[in]    cmd             - command to release, may be NULL.
+ *
+ * @return The function does not return a value.
+ */
+static inline void ses_cmd_free(struct ses_cmd *cmd)
+{
+	if (!cmd)
+		return;
+	if (cmd->fd >= 0)
+		close(cmd->fd);
+	ses_free(cmd->sp);
+	free(cmd);
+}
+
 struct ses_slot_ctrl_elem {
 	union {
 		struct {
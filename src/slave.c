@@ -34,32 +34,37 @@
 #include "slave.h"
 #include "status.h"
 #include "sysfs.h"
+#include "token.h"
 #include "utils.h"
 
 /**
  */
+static const struct token state_tokens[] = {
+	TOKEN("spare",        SLAVE_STATE_SPARE),
+	TOKEN("in_sync",      SLAVE_STATE_IN_SYNC),
+	TOKEN("faulty",       SLAVE_STATE_FAULTY),
+	TOKEN("write_mostly", SLAVE_STATE_WRITE_MOSTLY),
+	TOKEN("blocked",      SLAVE_STATE_BLOCKED),
+};
+
 static unsigned char _get_state(const char *path)
 {
-	char *p, *t, *s;
+	char *p, *s;
+	size_t len;
+	int state;
 	unsigned char result = SLAVE_STATE_UNKNOWN;
 
 	s = p = get_text(path, "state");
 	if (p) {
-		while (s) {
-			t = strchr(s, ',');
-			if (t)
-				*(t++) = '\0';
-			if (strcmp(s, "spare") == 0)
-				result |= SLAVE_STATE_SPARE;
-			else if (strcmp(s, "in_sync") == 0)
-				result |= SLAVE_STATE_IN_SYNC;
-			else if (strcmp(s, "faulty") == 0)
-				result |= SLAVE_STATE_FAULTY;
-			else if (strcmp(s, "write_mostly") == 0)
-				result |= SLAVE_STATE_WRITE_MOSTLY;
-			else if (strcmp(s, "blocked") == 0)
-				result |= SLAVE_STATE_BLOCKED;
-			s = t;
+		while (*s) {
+			len = strcspn(s, ",");
+			state = token_lookup(state_tokens,
+					     TOKEN_COUNT(state_tokens), s, len);
+			if (state > 0)
+				result |= state;
+			s += len;
+			if (*s)
+				s++;
 		}
 		free(p);
 	}
@@ -90,16 +95,14 @@ static unsigned int _get_slot(const char *path)
 
 /**
  */
-static struct block_device *_get_block(const char *path, struct list *block_list)
+int slave_get_block_path(const char *path, char *link)
 {
 	char temp[PATH_MAX];
-	char link[PATH_MAX];
-	struct block_device *device;
 
 	snprintf(temp, sizeof(temp), "%s/block", path);
 
 	if (!realpath(temp, link))
-		return NULL;
+		return -1;
 
 	/* translate partition to master block dev */
 	if (snprintf(temp, PATH_MAX, "%s/partition", link) > 0) {
@@ -112,6 +115,18 @@ static struct block_device *_get_block(const char *path, struct list *block_list
 				*ptr = '\0';
 		}
 	}
+	return 0;
+}
+
+/**
+ */
+static struct block_device *_get_block(const char *path, struct list *block_list)
+{
+	char link[PATH_MAX];
+	struct block_device *device;
+
+	if (slave_get_block_path(path, link))
+		return NULL;
 
 	list_for_each(block_list, device) {
 		if (strcmp(device->sysfs_path, link) == 0)
@@ -42,6 +42,20 @@ struct slave_device {
 	unsigned char state;
 };
 
+/**
+ * @brief Gets path to block device of RAID member.
+ *
+ * The function resolves 'block' link of the member directory (md/dev-*) of
+ * RAID device. If the member is a partition, path to the master block device
+ * is returned.
+ *
+ * @param[in]      path           Path to member directory in sysfs tree.
+ * @param[out]     link           Buffer of PATH_MAX bytes for the path.
+ *
+ * @return 0 if successful, otherwise -1.
+ */
+int slave_get_block_path(const char *path, char *link);
+
 /**
  */
 struct slave_device *slave_device_init(const char *path, struct list *block_list);
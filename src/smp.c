@@ -18,7 +18,6 @@
  */
 
 
-#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -43,6 +42,8 @@
 #include "enclosure.h"
 #include "ibpi.h"
 #include "list.h"
+#include "plan.h"
+#include "probes.h"
 #include "scsi.h"
 #include "smp.h"
 #include "status.h"
@@ -51,6 +52,12 @@
 
 #define GPIO_TX_GP1	0x01
 
+/* flags of a phy of the host */
+#define PHY_SET		0x01	/* LEDs have been set by this process */
+#define PHY_SENT	0x02	/* LEDs have been transmitted */
+#define PHY_LOCATE_OFF	0x04	/* locate LED is turned off explicitly */
+#define PHY_ACTIVITY	0x08	/* activity LED is driven by this process */
+
 #define INIT_IBPI(act, loc, err)  \
 	{	.error = err,     \
 		.locate = loc,    \
@@ -254,6 +261,26 @@ int set_raw_pattern(unsigned int dev_idx, unsigned char *data,
 	return rc == 3;
 }
 
+/**
+ * get_raw_pattern - turn a tx_gp bitstream into a tx register
+ *
+ * the reverse of set_raw_pattern(), the LEDs are either on or off */
+static void get_raw_pattern(unsigned int dev_idx, unsigned char *data,
+			    struct gpio_tx_register_byte *pattern)
+{
+	int od_offset = dev_idx * 3;
+
+	pattern->activity = try_test_sas_gpio_gp_bit(od_offset + 0, data,
+						     GPIO_TX_GP1, 1) == 1 ?
+			    LED_ON : LED_OFF;
+	pattern->locate = try_test_sas_gpio_gp_bit(od_offset + 1, data,
+						   GPIO_TX_GP1, 1) == 1 ?
+			  LED_ON : LED_OFF;
+	pattern->error = try_test_sas_gpio_gp_bit(od_offset + 2, data,
+						  GPIO_TX_GP1, 1) == 1 ?
+			 LED_ON : LED_OFF;
+}
+
 /**
  * @brief open device for smp protocol
  */
@@ -395,12 +422,67 @@ int smp_write_gpio(const char *path, int smp_reg_type,
 	header.register_index = smp_reg_index;
 	header.register_count = smp_reg_count;
 	memset(header.reserved, 0, sizeof(header.reserved));
+	if (plan_xfer("smp", path, sizeof(header) + len, 1))
+		return 0;
 	int fd = _open_smp_device(path);
+	uint64_t start = get_monotonic_us();
+	PROBE2(xfer_start, "smp", path);
 	status = _start_smp_write_gpio(fd, &header, data, len);
+	PROBE3(xfer_end, "smp", path, status);
+	plan_stat("smp", start);
 	_close_smp_device(fd);
 	return status;
 }
 
+/**
+   @brief read gpio registers of hba
+
+   @note len is a number of 32bit words
+ */
+static int smp_read_gpio(const char *path, int smp_reg_type,
+			 int smp_reg_index, int smp_reg_count, void *data,
+			 size_t len)
+{
+	struct smp_read_request_frame request;
+	uint8_t buf[sizeof(struct smp_read_response_frame_header) +
+		    MAX_SMP_FRAME_DATA + SMP_FRAME_CRC_LEN];
+	struct smp_read_response_frame_header *response = (void *)buf;
+	size_t response_size = sizeof(*response) + len * SMP_DATA_CHUNK_SIZE +
+			       SMP_FRAME_CRC_LEN;
+	uint64_t start;
+	int fd, status;
+
+	if (len * SMP_DATA_CHUNK_SIZE > MAX_SMP_FRAME_DATA)
+		__set_errno_and_return(EINVAL);
+	memset(&request, 0, sizeof(request));
+	memset(buf, 0, sizeof(buf));
+	request.frame_type = SMP_FRAME_TYPE_REQ;
+	request.function = SMP_FUNC_GPIO_READ;
+	request.register_type = smp_reg_type;
+	request.register_index = smp_reg_index;
+	request.register_count = smp_reg_count;
+	plan_xfer("smp_read", path, sizeof(request), 0);
+	fd = _open_smp_device(path);
+	if (fd < 0)
+		return GPIO_STATUS_FAILURE;
+	start = get_monotonic_us();
+	PROBE2(xfer_start, "smp_read", path);
+	status = _send_smp_frame(fd, &request, sizeof(request), buf,
+				 &response_size);
+	PROBE3(xfer_end, "smp_read", path, status);
+	plan_stat("smp_read", start);
+	_close_smp_device(fd);
+
+	if (status != GPIO_STATUS_OK ||
+	    response->frame_type != SMP_FRAME_TYPE_RESP ||
+	    response->function != SMP_FUNC_GPIO_READ ||
+	    response->function_result != GPIO_STATUS_OK ||
+	    response_size < sizeof(*response) + len * SMP_DATA_CHUNK_SIZE)
+		return GPIO_STATUS_FAILURE;
+	memcpy(data, response->read_data, len * SMP_DATA_CHUNK_SIZE);
+	return GPIO_STATUS_OK;
+}
+
 #define BLINK_GEN_1HZ				8
 #define BLINK_GEN_2HZ				4
 #define BLINK_GEN_4HZ				2
@@ -419,10 +501,146 @@ struct gpio_tx_register_byte *get_bdev_ibpi_buffer(struct block_device *bdevice)
 	return NULL;
 }
 
+/**
+ * Gets LEDs of the pattern with indications shown together. An indication
+ * turns on the locate or error LED if the pattern leaves it off.
+ */
+static struct gpio_tx_register_byte _get_sgpio(struct block_device *device,
+					       enum ibpi_pattern ibpi)
+{
+	struct gpio_tx_register_byte leds = ibpi2sgpio[ibpi].pattern;
+	unsigned int mask = block_indications(device, ibpi);
+	enum ibpi_pattern i;
+
+	for (i = IBPI_PATTERN_NORMAL; i <= IBPI_PATTERN_LOCATE_OFF; i++) {
+		if (!(mask & IBPI_MASK(i)) ||
+		    (device->cntrl->isci_present && !ibpi2sgpio[i].support_mask))
+			continue;
+		if (leds.locate == LED_OFF)
+			leds.locate = ibpi2sgpio[i].pattern.locate;
+		if (leds.error == LED_OFF)
+			leds.error = ibpi2sgpio[i].pattern.error;
+	}
+	if (device->activity != ACTIVITY_HW)
+		leds.activity = device->activity == ACTIVITY_ON ? LED_ON : LED_OFF;
+	return leds;
+}
+
+/**
+ * GPIO_TX[n] register has the highest numbered drive of the four in the first
+ * byte and the lowest numbered drive in the fourth byte. See SFF-8485 Rev. 0.7
+ * Table 24.
+ */
+static int _tx_index(int phy_index)
+{
+	return phy_index + 3 - (phy_index % 4) * 2;
+}
+
+static struct gpio_tx_register_byte *_get_tx_byte(struct block_device *device,
+					struct gpio_tx_register_byte *gpio_tx)
+{
+	return &gpio_tx[_tx_index(device->phy_index)];
+}
+
+/**
+ * Sets flags of the phy of the device, see PHY_SET and others.
+ */
+static void _set_phy_flags(struct block_device *device, unsigned char set,
+			   unsigned char clear)
+{
+	struct _host_type *host = device->host;
+
+	if (!host->phy_flags || device->phy_index < 0 ||
+	    device->phy_index >= host->ports)
+		return;
+	host->phy_flags[device->phy_index] |= set;
+	host->phy_flags[device->phy_index] &= ~clear;
+}
+
+/**
+ * Keeps LEDs set by another process, e.g. by ledctl while ledmon is running.
+ * The LEDs are read from the hba before a transmission which changes locate
+ * or error LEDs and once per scan otherwise, see scsi_smp_write_buffer().
+ * LEDs of phys never set by this process are left as they are. Locate and
+ * error LEDs which this process has left off in the last transmission stay as
+ * they are too, unless locate_off is requested. The first transmission of a
+ * phy sets its LEDs as requested.
+ */
+static void _keep_other_leds(struct _host_type *host, const char *path,
+			     int isci)
+{
+	int regs = (host->ports + 3) / 4;
+	struct gpio_tx_register_byte hw[regs * 4], cur, old, sent;
+	unsigned char bitstream[4], flags;
+	int i, status;
+
+	if (!host->phy_flags || !host->sent_state)
+		return;
+	if (isci)
+		status = smp_read_gpio(path, GPIO_REG_TYPE_TX_GP, GPIO_TX_GP1, 1,
+				       bitstream, SMP_DATA_CHUNKS);
+	else
+		status = smp_read_gpio(path, GPIO_REG_TYPE_TX, 0, regs, hw,
+				       regs);
+	if (status != GPIO_STATUS_OK)
+		return;
+
+	for (i = 0; i < host->ports; i++) {
+		flags = host->phy_flags[i];
+		if (isci) {
+			get_raw_pattern(i, host->bitstream, &cur);
+			get_raw_pattern(i, bitstream, &old);
+		} else {
+			cur = host->ibpi_state_buffer[_tx_index(i)];
+			old = hw[_tx_index(i)];
+		}
+		if (!(flags & PHY_SET)) {
+			cur.locate = old.locate;
+			cur.error = old.error;
+			if (!(flags & PHY_ACTIVITY))
+				cur.activity = old.activity;
+		} else if (flags & PHY_SENT) {
+			sent = host->sent_state[i];
+			if (cur.locate == LED_OFF && sent.locate == LED_OFF &&
+			    !(flags & PHY_LOCATE_OFF))
+				cur.locate = old.locate;
+			if (cur.error == LED_OFF && sent.error == LED_OFF)
+				cur.error = old.error;
+		}
+		if (isci)
+			set_raw_pattern(i, host->bitstream, &cur);
+		else
+			host->ibpi_state_buffer[_tx_index(i)] = cur;
+	}
+}
+
+/**
+ * Remembers LEDs transmitted to the phys set by this process.
+ */
+static void _save_sent_leds(struct _host_type *host, int isci)
+{
+	int i;
+
+	if (!host->phy_flags || !host->sent_state)
+		return;
+	for (i = 0; i < host->ports; i++) {
+		if (!(host->phy_flags[i] & PHY_SET))
+			continue;
+		if (isci)
+			get_raw_pattern(i, host->bitstream,
+					&host->sent_state[i]);
+		else
+			host->sent_state[i] =
+				host->ibpi_state_buffer[_tx_index(i)];
+		host->phy_flags[i] |= PHY_SENT;
+	}
+}
+
 /**
  */
 int scsi_smp_fill_buffer(struct block_device *device, enum ibpi_pattern ibpi)
 {
+	struct gpio_tx_register_byte leds;
 	const char *sysfs_path = device->cntrl_path;
 	struct gpio_tx_register_byte *gpio_tx;
 
@@ -467,31 +685,70 @@ int scsi_smp_fill_buffer(struct block_device *device, enum ibpi_pattern ibpi)
 		log_debug("%s(): no IBPI buffer. Skipping.", __func__);
 		__set_errno_and_return(ENODEV);
 	}
+	if (device->phy_index < 0 || device->phy_index >= device->host->ports) {
+		log_debug("%s(): unknown phy of '%s'. Skipping.", __func__,
+			  device->sysfs_path);
+		__set_errno_and_return(ENODEV);
+	}
 
+	leds = _get_sgpio(device, ibpi);
+	_set_phy_flags(device, PHY_SET |
+		       (ibpi == IBPI_PATTERN_LOCATE_OFF ? PHY_LOCATE_OFF : 0),
+		       ibpi == IBPI_PATTERN_LOCATE_OFF ? 0 : PHY_LOCATE_OFF);
 	if (device->cntrl->isci_present) {
 		/* update bit stream for this device */
 		set_raw_pattern(device->phy_index,
-			&device->host->bitstream[0], &ibpi2sgpio[ibpi].pattern);
+			&device->host->bitstream[0], &leds);
 	} else {
-		/*
-		 * GPIO_TX[n] register has the highest numbered drive of the
-		 * four in the first byte and the lowest numbered drive in the
-		 * fourth byte. See SFF-8485 Rev. 0.7 Table 24.
-		 */
-		gpio_tx[device->phy_index + 3 - (device->phy_index % 4) * 2] =
-			ibpi2sgpio[ibpi].pattern;
+		*_get_tx_byte(device, gpio_tx) = leds;
 	}
 
 	/* write only if state has changed */
-	if (ibpi != device->ibpi_prev)
+	if (block_state_changed(device, ibpi)) {
 		device->host->flush = 1;
+		device->host->flush_status = 0;
+		device->host->leds_changed = 1;
+	}
 
-	return 1;
+	return 0;
+}
+
+int scsi_smp_set_activity(struct block_device *device)
+{
+	struct gpio_tx_register_byte *gpio_tx = get_bdev_ibpi_buffer(device);
+	int od_offset = device->phy_index * 3;
+	unsigned char activity;
+
+	if (!device->cntrl || !gpio_tx || device->phy_index < 0 ||
+	    device->phy_index >= device->host->ports)
+		__set_errno_and_return(ENODEV);
+
+	if (device->activity == ACTIVITY_HW)
+		activity = ibpi2sgpio[IBPI_PATTERN_NORMAL].pattern.activity;
+	else
+		activity = device->activity == ACTIVITY_ON ? LED_ON : LED_OFF;
+	if (device->cntrl->isci_present) {
+		if (activity == LED_ON)
+			try_set_sas_gpio_gp_bit(od_offset, device->host->bitstream,
+						GPIO_TX_GP1, 1);
+		else
+			try_clear_sas_gpio_gp_bit(od_offset,
+						  device->host->bitstream,
+						  GPIO_TX_GP1, 1);
+	} else {
+		_get_tx_byte(device, gpio_tx)->activity = activity;
+	}
+	_set_phy_flags(device, PHY_ACTIVITY, 0);
+	device->host->flush = 1;
+	device->host->flush_status = 0;
+
+	return 0;
 }
 
 int scsi_smp_write_buffer(struct block_device *device)
 {
 	const char *sysfs_path = device->cntrl_path;
+	uint64_t now;
 
 	if (sysfs_path == NULL)
 		__set_errno_and_return(EINVAL);
@@ -500,120 +757,171 @@ int scsi_smp_write_buffer(struct block_device *device)
 
 	if (device->host->flush) {
 		device->host->flush = 0;
+		/*
+		 * The buffer keeps the LEDs merged by the last read, so flushes
+		 * which only change activity read the hba once per scan.
+		 */
+		now = get_monotonic_ms();
+		if (device->host->leds_changed || !device->host->leds_read ||
+		    now - device->host->leds_read >=
+		    (uint64_t)conf.scan_interval * 1000) {
+			_keep_other_leds(device->host, sysfs_path,
+					 device->cntrl->isci_present);
+			device->host->leds_changed = 0;
+			device->host->leds_read = now;
+		}
 		/* re-transmit the bitstream */
 		if (device->cntrl->isci_present) {
-			return smp_write_gpio(sysfs_path,
+			device->host->flush_status =
+				smp_write_gpio(sysfs_path,
 					       GPIO_REG_TYPE_TX_GP,
 					       GPIO_TX_GP1, 1,
 					       &device->host->bitstream[0],
 					       SMP_DATA_CHUNKS);
 		} else {
-			return smp_write_gpio(sysfs_path,
+			device->host->flush_status =
+				smp_write_gpio(sysfs_path,
 					       GPIO_REG_TYPE_TX,
 					       0, (device->host->ports+3)/4,
 					       device->host->ibpi_state_buffer,
 					       (device->host->ports+3)/4);
 		}
-	} else
-		return 1;
+		if (device->host->flush_status == GPIO_STATUS_OK)
+			_save_sent_leds(device->host,
+					device->cntrl->isci_present);
+	}
+	/*
+	 * The bitstream is shared by all devices on the host, so every device
+	 * reports the status of the last transmission.
+	 */
+	return device->host->flush_status;
+}
+
+int scsi_smp_get_leds(struct block_device *device)
+{
+	struct gpio_tx_register_byte leds;
+	unsigned char bitstream[4];
+	int regs, status;
+
+	if (!device->host || !device->cntrl || !device->cntrl_path ||
+	    device->phy_index < 0 || device->phy_index >= device->host->ports)
+		return -1;
+	regs = (device->host->ports + 3) / 4;
+	if (device->cntrl->isci_present) {
+		status = smp_read_gpio(device->cntrl_path, GPIO_REG_TYPE_TX_GP,
+				       GPIO_TX_GP1, 1, bitstream,
+				       SMP_DATA_CHUNKS);
+		get_raw_pattern(device->phy_index, bitstream, &leds);
+	} else {
+		struct gpio_tx_register_byte hw[regs * 4];
+
+		status = smp_read_gpio(device->cntrl_path, GPIO_REG_TYPE_TX, 0,
+				       regs, hw, regs);
+		leds = hw[_tx_index(device->phy_index)];
+	}
+	if (status != GPIO_STATUS_OK)
+		return -1;
+	return (leds.locate != LED_OFF ? IBPI_MASK(IBPI_PATTERN_LOCATE) : 0) |
+	       (leds.error != LED_OFF ? IBPI_MASK(IBPI_PATTERN_FAILED_DRIVE) : 0);
 }
 
 /**
  */
-static void init_smp(struct cntrl_device *device)
+static void init_smp_host(struct _host_type *host)
 {
-	struct _host_type *hosts;
 	int i;
-	if (!device)
+
+	/* already initialized */
+	if (host->ibpi_state_buffer)
 		return;
+	/* whole GPIO_TX registers are transmitted */
+	host->ibpi_state_buffer = calloc((host->ports + 3) / 4 * 4,
+					 sizeof(struct gpio_tx_register_byte));
+	if (!host->ibpi_state_buffer)
+		return;
+	host->sent_state = calloc(host->ports, sizeof(*host->sent_state));
+	host->phy_flags = calloc(host->ports, sizeof(*host->phy_flags));
 
-	for (hosts = device->hosts; hosts; hosts = hosts->next) {
-		/* already initialized */
-		if (hosts->ibpi_state_buffer)
-			continue;
-		hosts->ibpi_state_buffer =
-				calloc(hosts->ports,
-					sizeof(struct
-					gpio_tx_register_byte));
+	for (i = 0; i < host->ports; i++)
+		set_raw_pattern(i, &host->bitstream[0],
+				&ibpi2sgpio[IBPI_PATTERN_ONESHOT_NORMAL].pattern);
+	host->flush = 0;
+}
 
-		if (!hosts->ibpi_state_buffer)
-			continue;
+/**
+ */
+static struct _host_type *find_smp_host(struct cntrl_device *cntrl,
+					int host_id)
+{
+	struct _host_type *host;
 
-		for (i = 0; i < hosts->ports; i++)
-			set_raw_pattern(i, &hosts->bitstream[0],
-					&ibpi2sgpio
-					[IBPI_PATTERN_ONESHOT_NORMAL].pattern);
-		hosts->flush = 0;
+	for (host = cntrl->hosts; host; host = host->next) {
+		if (host->host_id == host_id)
+			return host;
 	}
+	return NULL;
+}
+
+/**
+ * Gets phy of the port from the port to phy map of the host.
+ */
+static int _find_port_phy(struct _host_type *host, int port_id)
+{
+	int i;
+
+	for (i = 0; i < host->port_phys_len; i++) {
+		if (host->port_phys[i].port_id == port_id)
+			return host->port_phys[i].phy_index;
+	}
+	return -1;
 }
 
 /**
  */
 int cntrl_init_smp(const char *path, struct cntrl_device *cntrl)
 {
-	char *path2 = NULL;
-	char *c;
-	int host, port = 0;
-	struct dirent *de;
-	DIR *d;
+	char host_path[PATH_MAX];
+	struct _host_type *host;
+	const char *c;
+	int host_id, port_id, phy;
 
 	if (!cntrl)
-		return port;
+		return -1;
 
 	/* Other case - just init controller. */
-	if (path && strstr(path, "port-")) {
-		path2 = str_dup(path);
-		if (!path2)
-			return port;
-
-		c = strstr(path2, "port-");
-		if (!c) {
-			/* Should not happen. */
-			log_debug("%s() missing 'port' in path '%s'", __func__,
-				  path2);
-			free(path2);
-			return port;
-		}
-		c = strchr(c, '/');
-		if (!c) {
-			free(path2);
-			return port;
-		}
-		*c = 0;
-		/* And now path2 has only up to 'port-...' string. */
-
-		/* this should open port-XX:X directory
-		 * FIXME: for enclosure it may be port-XX:Y:Z but it's a second
-		 * occurrence
-		 *
-		 * We may try this on the missing device.
-		 * */
-		d = opendir(path2);
-		if (!d) {
-			log_debug("%s() Error dir open '%s', path ='%s'",
-				  __func__, path2, path);
-			free(path2);
-			return port;
-		}
-		while ((de = readdir(d))) {
-			if ((strcmp(de->d_name, ".") == 0) ||
-			    (strcmp(de->d_name, "..")) == 0) {
-				continue;
-			}
-			if (strncmp(de->d_name, "phy-", strlen("phy-")) == 0) {
-				/* Need link called "phy-XX:Y
-				 * Y is real phy we need.
-				 * This can also be found
-				 * in phy_identifier file */
-				if (sscanf(de->d_name, "phy-%d:%d", &host, &port) != 2)
-					continue;
-
-				break;
-			}
-		}
-		closedir(d);
-		free(path2);
+	if (!path || !(c = strstr(path, "port-"))) {
+		for (host = cntrl->hosts; host; host = host->next)
+			init_smp_host(host);
+		return -1;
+	}
+
+	/*
+	 * The first port-H:P component identifies the port of the host.
+	 * For enclosure it may be followed by port-H:Y:Z but it's a second
+	 * occurrence.
+	 */
+	if (sscanf(c, "port-%d:%d", &host_id, &port_id) != 2) {
+		log_debug("%s() malformed 'port' in path '%s'", __func__, path);
+		return -1;
+	}
+	host = find_smp_host(cntrl, host_id);
+	if (!host) {
+		log_debug("%s() missing host%d for path '%s'", __func__,
+			  host_id, path);
+		return -1;
+	}
+	init_smp_host(host);
+	phy = _find_port_phy(host, port_id);
+	if (phy < 0 && c > path) {
+		/* the port is new, e.g. the drive has been re-inserted */
+		snprintf(host_path, sizeof(host_path), "%.*s",
+			 (int)(c - path - 1), path);
+		update_port_phys(host, host_path);
+		phy = _find_port_phy(host, port_id);
 	}
-	init_smp(cntrl);
-	return port;
+	if (phy >= 0)
+		return phy;
+	log_debug("%s() no phy for port-%d:%d, path ='%s'", __func__,
+		  host_id, port_id, path);
+	return -1;
 }
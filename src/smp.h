@@ -84,11 +84,24 @@ int scsi_ses_write(struct block_device *device, enum ibpi_pattern ibpi);
  * @param[in]      device         Path to a smp device in sysfs.
  * @param[in]      ibpi           IBPI pattern to visualize.
  *
- * @return 1 if successful or -1 in case of error
+ * @return 0 if successful or -1 in case of error
  *         and errno is set to appropriate error code.
  */
 int scsi_smp_fill_buffer(struct block_device *device, enum ibpi_pattern ibpi);
 
+/**
+ * @brief Updates Activity LED of the device in outbound buffer.
+ *
+ * Only the activity bits of the slot are changed, see block_device::activity.
+ * The buffer of the host is sent by scsi_smp_write_buffer().
+ *
+ * @param[in]      device         Path to a smp device in sysfs.
+ *
+ * @return 0 if successful or -1 in case of error
+ *         and errno is set to appropriate error code.
+ */
+int scsi_smp_set_activity(struct block_device *device);
+
 /**
  * @brief Sends message to SMP device.
  *
@@ -97,21 +110,35 @@ int scsi_smp_fill_buffer(struct block_device *device, enum ibpi_pattern ibpi);
  *
  * @param[in]      device         Path to a smp device in sysfs.
  *
- * @return Number of bytes written to device if successful or -1 in case of error
- *         and errno is set to appropriate error code.
+ * @return 0 if the last transmission of the host's bitstream was successful,
+ *         otherwise -1 or a non-zero SMP function result.
  */
 int scsi_smp_write_buffer(struct block_device *device);
 
+/**
+ * @brief Gets Locate and Failure LEDs of the phy from GPIO TX registers.
+ *
+ * @param[in]      device         Block device connected to the phy.
+ *
+ * @return IBPI_MASK() of the patterns whose LEDs are on, or -1 if the LEDs
+ *         cannot be read.
+ */
+int scsi_smp_get_leds(struct block_device *device);
+
 /**
  * @brief Init smp and gets phy index,
  *
+ * The phy index is looked up in port to phy map of the host, which is built
+ * when the controller is discovered. Only the host the device is attached to
+ * is initialized.
+ *
  * @param[in]      path            Path to the device in sysfs. It can be NULL
- *                                 to just initialize cntrl and not to get the
- *                                 phy.
+ *                                 to just initialize all hosts of cntrl and
+ *                                 not to get the phy.
  * @param[in]      cntrl           Controller device to be initialized.
  *
  * @return Phy index on success if path and cntrl weren't NULL
- *         0 if error occurred or path was NULL.
+ *         -1 if phy is unknown, error occurred or path was NULL.
  */
 int cntrl_init_smp(const char *path, struct cntrl_device *cntrl);
 
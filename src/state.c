@@ -0,0 +1,170 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "block.h"
+#include "cntrl.h"
+#include "raid.h"
+#include "state.h"
+#include "sysfs.h"
+#include "utils.h"
+
+#define STATE_FIELDS	11
+
+int state_open(void)
+{
+	int fd;
+
+	fd = open(STATE_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+	if (fd < 0) {
+		log_error("Unable to open %s: %s", STATE_FILE, strerror(errno));
+		return -1;
+	}
+	if (flock(fd, LOCK_EX)) {
+		log_error("Unable to lock %s: %s", STATE_FILE, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static struct raid_device *_restore_raid(const char *path, int type,
+					 int level)
+{
+	struct raid_device *raid;
+
+	if (strcmp(path, "-") == 0)
+		return NULL;
+	raid = calloc(1, sizeof(*raid));
+	if (raid) {
+		raid->sysfs_path = str_dup(path);
+		raid->type = type;
+		raid->level = level;
+	}
+	return raid;
+}
+
+/**
+ * Splits the line into tab separated fields. Returns number of fields.
+ */
+static int _split(char *line, char **fields)
+{
+	char *saveptr = NULL;
+	char *s;
+	int n = 0;
+
+	line[strcspn(line, "\n")] = '\0';
+	for (s = strtok_r(line, "\t", &saveptr); s && n < STATE_FIELDS;
+	     s = strtok_r(NULL, "\t", &saveptr))
+		fields[n++] = s;
+	return s ? -1 : n;
+}
+
+int state_load(int fd, struct list *block_list)
+{
+	char *fields[STATE_FIELDS];
+	struct block_device *device;
+	struct cntrl_device *cntrl;
+	char *line = NULL;
+	size_t size = 0;
+	int count = 0;
+	FILE *f;
+
+	f = fdopen(dup(fd), "r");
+	if (!f)
+		return 0;
+	while (getline(&line, &size, f) > 0) {
+		if (_split(line, fields) != STATE_FIELDS) {
+			log_debug("state: invalid line ignored.");
+			continue;
+		}
+		cntrl = block_get_controller(sysfs_get_cntrl_devices(),
+					     fields[1]);
+		if (!cntrl) {
+			log_debug("state: controller of %s not found.",
+				  fields[0]);
+			continue;
+		}
+		device = block_device_restore(cntrl, fields[0], fields[1]);
+		if (!device)
+			continue;
+		device->host_id = atoi(fields[2]);
+		device->phy_index = atoi(fields[3]);
+		device->ibpi = atoi(fields[4]);
+		device->ibpi_prev = atoi(fields[5]);
+		if (device->ibpi > IBPI_PATTERN_REMOVED ||
+		    device->ibpi_prev > IBPI_PATTERN_REMOVED) {
+			block_device_fini(device);
+			continue;
+		}
+		device->ibpi_mask = strtoul(fields[6], NULL, 16) &
+				    IBPI_INDICATIONS;
+		device->ibpi_mask_prev = strtoul(fields[7], NULL, 16) &
+					 IBPI_INDICATIONS;
+		device->raid_dev = _restore_raid(fields[8], atoi(fields[9]),
+						 atoi(fields[10]));
+		list_append(block_list, device);
+		count++;
+	}
+	free(line);
+	fclose(f);
+	return count;
+}
+
+status_t state_save(int fd, const struct list *block_list)
+{
+	struct block_device *device;
+	status_t status = STATUS_SUCCESS;
+	FILE *f;
+
+	if (ftruncate(fd, 0) || lseek(fd, 0, SEEK_SET) < 0) {
+		close(fd);
+		return STATUS_FILE_WRITE_ERROR;
+	}
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	list_for_each(block_list, device) {
+		struct raid_device *raid = device->raid_dev;
+
+		fprintf(f, "%s\t%s\t%d\t%d\t%u\t%u\t%x\t%x\t%s\t%u\t%u\n",
+			device->sysfs_path, device->cntrl_path,
+			device->host_id, device->phy_index, device->ibpi,
+			device->ibpi_prev, device->ibpi_mask,
+			device->ibpi_mask_prev, raid ? raid->sysfs_path : "-",
+			raid ? raid->type : 0, raid ? raid->level : 0);
+	}
+	if (fclose(f))
+		status = STATUS_FILE_WRITE_ERROR;
+	return status;
+}
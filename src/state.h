@@ -0,0 +1,78 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _STATE_H_INCLUDED_
+#define _STATE_H_INCLUDED_
+
+#include "list.h"
+#include "status.h"
+
+/*
+ * State of block devices kept between single-shot runs of ledmon, see --once
+ * option. Each line of the file describes one device with tab separated
+ * fields:
+ *
+ *   <sysfs_path> <cntrl_path> <host_id> <phy_index> <ibpi> <ibpi_prev>
+ *   <ibpi_mask> <ibpi_mask_prev> <raid_path> <raid_type> <raid_level>
+ *
+ * Patterns, type and level of RAID device are enum values, masks of
+ * indications are given in hexadecimal. The RAID path is
+ * "-" if the device is not a RAID member. The file is locked while ledmon
+ * runs, so runs triggered at the same time are serialized.
+ */
+
+/**
+ * File the state is kept in.
+ */
+#define STATE_FILE	"/var/run/ledmon.state"
+
+/**
+ * @brief Opens and locks the state file.
+ *
+ * The function waits until the state file is released by other instance.
+ *
+ * @return Descriptor of the file if successful, otherwise -1.
+ */
+int state_open(void);
+
+/**
+ * @brief Restores block devices saved by the previous run.
+ *
+ * Devices whose controllers are not present anymore are skipped. Other
+ * devices are appended to the list even if they have not been found by the
+ * scan, so they are reported as detached.
+ *
+ * @param[in]    fd              - descriptor returned by state_open().
+ * @param[out]   block_list      - list the devices are appended to.
+ *
+ * @return Number of devices restored.
+ */
+int state_load(int fd, struct list *block_list);
+
+/**
+ * @brief Saves block devices and closes the state file.
+ *
+ * @param[in]    fd              - descriptor returned by state_open().
+ * @param[in]    block_list      - list of devices to save.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t state_save(int fd, const struct list *block_list);
+
+#endif				/* _STATE_H_INCLUDED_ */
@@ -20,6 +20,7 @@
 
 #include <fcntl.h>
 #include <limits.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +32,7 @@
 #endif
 
 #include "block.h"
+#include "cadence.h"
 #include "cntrl.h"
 #include "config.h"
 #include "config_file.h"
@@ -38,10 +40,12 @@
 #include "ibpi.h"
 #include "list.h"
 #include "pci_slot.h"
+#include "probes.h"
 #include "raid.h"
 #include "slave.h"
 #include "stdio.h"
 #include "sysfs.h"
+#include "topology.h"
 #include "utils.h"
 
 /**
@@ -98,6 +102,16 @@ static struct list cntnr_list;
  */
 static struct list enclo_list;
 
+/**
+ * This is internal variable global to sysfs module only. It is a list of
+ * canonical paths of enclosures registered in the system. The list is read
+ * at most once per scan, when the first controller needs it to be classified
+ * or when enclosures are scanned, so the enclosure devices do not have to be
+ * initialized before controllers.
+ */
+static struct list enclo_paths;
+static int enclo_paths_read;
+
 /**
  * This is internal variable global to sysfs module only. It is a list of
  * PCI slots registered in the system. Use sysfs_init()
@@ -106,6 +120,14 @@ static struct list enclo_list;
  */
 static struct list slots_list;
 
+/**
+ * This is internal variable global to sysfs module only. During a phase of
+ * the scan it holds devices found by the previous scan which have not been
+ * found again yet. Devices of controllers which are not due to be refreshed
+ * are taken from this list instead of being initialized again.
+ */
+static struct list stale_list;
+
 /**
  * @brief Determine device type.
  *
@@ -210,29 +232,6 @@ static int _is_duplicate(struct slave_device *slave)
 	return 0;
 }
 
-/**
- * @brief Checks if given disk can be removed from sysfs_block_list if
- * metatada is not present.
- *
- * This is internal function (action) of sysfs module. The slave_list keeps
- * all devices with metadata (raid devices). If disk is not included in slave
- * list there is not metadata on it.
- *
- * @return 1 if can be removed, otherwise 0.
- */
-static int _is_non_raid_device(struct block_device *block_device)
-{
-	struct slave_device *slave_device;
-
-	list_for_each(&slave_list, slave_device) {
-		if (strcmp(slave_device->block->sysfs_path,
-			   block_device->sysfs_path) == 0)
-			return 0;
-	}
-
-	return 1;
-}
-
 /**
  */
 static void _slave_cnt_add(const char *path, struct raid_device *raid)
@@ -273,11 +272,86 @@ static void _link_raid_device(struct raid_device *device, enum device_type type)
 	}
 }
 
+/**
+ * @brief Moves all devices of the list to the list of stale devices.
+ */
+static void _stale_begin(struct list *list)
+{
+	void *item;
+
+	list_init(&stale_list, list->item_free);
+	list_for_each(list, item)
+		list_append(&stale_list, item);
+	list_clear(list);
+}
+
+/**
+ * @brief Releases devices which have not been found again.
+ */
+static void _stale_end(void)
+{
+	list_erase(&stale_list);
+}
+
+/**
+ * @brief Takes a device found by the previous scan.
+ *
+ * This is internal function of sysfs module. The function looks for a stale
+ * device with the given path and moves it to the list if the controller of
+ * the device is not due to be refreshed. The path is expected to be the first
+ * field of device structure.
+ *
+ * @param[in]      list           List the device is moved to.
+ * @param[in]      path           Canonical sysfs path to the device.
+ * @param[in]      cntrl_path     Sysfs path to controller of the device.
+ * @param[in]      type           Type of controller of the device.
+ *
+ * @return Pointer to the device if it has been kept, otherwise NULL.
+ */
+static void *_stale_keep(struct list *list, const char *path,
+			 const char *cntrl_path, enum cntrl_type type)
+{
+	struct node *node;
+	void *item;
+
+	list_for_each_node(&stale_list, node) {
+		item = node->item;
+		if (strcmp(*(char **)item, path) != 0)
+			continue;
+		if (!cntrl_path || cadence_due(cntrl_path, type))
+			return NULL;
+		list_remove(node);
+		free(node);
+		list_append(list, item);
+		return item;
+	}
+	return NULL;
+}
+
 /**
  */
 static void _block_add(const char *path)
 {
-	struct block_device *device = block_device_init(&cntrl_list, path);
+	struct cntrl_device *cntrl;
+	struct block_device *device;
+	char link[PATH_MAX];
+
+	if (realpath(path, link)) {
+		cntrl = block_get_controller(&cntrl_list, link);
+		device = _stale_keep(&sysfs_block_list, link,
+				     cntrl ? cntrl->sysfs_path : NULL,
+				     cntrl ? cntrl->cntrl_type : CNTRL_TYPE_UNKNOWN);
+		if (device) {
+			/* RAID state is determined again by this scan */
+			device->ibpi = IBPI_PATTERN_UNKNOWN;
+			device->ibpi_mask = 0;
+			device->timestamp = timestamp;
+			raid_device_fini(device->raid_dev);
+			device->raid_dev = NULL;
+			return;
+		}
+	}
+	device = block_device_init(&cntrl_list, path);
 	if (device)
 		list_append(&sysfs_block_list, device);
 }
@@ -327,18 +401,72 @@ static void _raid_add(const char *path)
  */
 static void _cntrl_add(const char *path)
 {
-	struct cntrl_device *device = cntrl_device_init(path);
-	if (device)
+	struct cntrl_device *device = NULL;
+	struct node *node;
+
+	list_for_each_node(&stale_list, node) {
+		device = node->item;
+		if (strcmp(device->sysfs_path, path) == 0)
+			break;
+		device = NULL;
+	}
+	if (device && _stale_keep(&cntrl_list, path, device->sysfs_path,
+				  device->cntrl_type))
+		return;
+	if (topology_trusted()) {
+		/* functions not listed in the manifest are not classified */
+		device = topology_cntrl(path);
+	} else {
+		device = cntrl_device_init(path);
+		topology_check_cntrl(path, device);
+	}
+	if (device) {
+		/* schedule the next refresh */
+		cadence_due(device->sysfs_path, device->cntrl_type);
 		list_append(&cntrl_list, device);
+	}
 }
 
 /**
  */
 static void _enclo_add(const char *path)
 {
-	struct enclosure_device *device = enclosure_device_init(path);
-	if (device)
+	struct enclosure_device *device;
+	struct cntrl_device *cntrl;
+	char temp[PATH_MAX];
+
+	str_cpy(temp, path, sizeof(temp));
+	cntrl = block_get_controller(&cntrl_list, temp);
+	if (_stale_keep(&enclo_list, path, cntrl ? cntrl->sysfs_path : NULL,
+			cntrl ? cntrl->cntrl_type : CNTRL_TYPE_UNKNOWN))
+		return;
+	device = topology_enclosure(path);
+	if (!device) {
+		device = enclosure_device_init(path);
+		if (device)
+			topology_check_enclosure(device);
+	}
+	if (device) {
+		/* block devices have to be linked to the new enclosure */
+		if (cntrl)
+			cadence_expire(cntrl->sysfs_path);
 		list_append(&enclo_list, device);
+	}
+}
+
+/**
+ * @brief Refreshes controllers of enclosures which have disappeared.
+ */
+static void _enclo_expire_stale(void)
+{
+	struct enclosure_device *device;
+	struct cntrl_device *cntrl;
+
+	list_for_each(&stale_list, device) {
+		cntrl = block_get_controller(&cntrl_list, device->sysfs_path);
+		if (cntrl)
+			cadence_expire(cntrl->sysfs_path);
+	}
 }
 
 /**
@@ -370,11 +498,23 @@ static void _check_cntrl(const char *path)
 
 /**
  */
-static void _check_enclo(const char *path)
+static void _read_enclo_paths(void)
 {
-	char link[PATH_MAX];
-	if (realpath(path, link) != NULL)
-		_enclo_add(link);
+	struct list dir;
+	const char *dir_path;
+	char *link;
+
+	if (enclo_paths_read)
+		return;
+	enclo_paths_read = 1;
+	if (scan_dir(SYSFS_CLASS_ENCLOSURE, &dir) != 0)
+		return;
+	list_for_each(&dir, dir_path) {
+		link = realpath(dir_path, NULL);
+		if (link)
+			list_append(&enclo_paths, link);
+	}
+	list_erase(&dir);
 }
 
 static void _scan_block(void)
@@ -421,26 +561,76 @@ static void _scan_slave(void)
 		_link_raid_device(device, DEVICE_TYPE_VOLUME);
 	list_for_each(&cntnr_list, device)
 		_link_raid_device(device, DEVICE_TYPE_CONTAINER);
-	if (conf.raid_members_only) {
-		struct node *node;
+}
 
-		list_for_each_node(&sysfs_block_list, node) {
-			if (_is_non_raid_device(node->item))
-				list_delete(node);
+/**
+ * @brief Adds block devices of RAID members.
+ *
+ * This is internal function of sysfs module. The function goes through the
+ * member directories (md/dev-*) of given RAID device and initializes block
+ * device of each member which is not on the list yet.
+ *
+ * @param[in]      device         Pointer to RAID device structure.
+ *
+ * @return The function does not return a value.
+ */
+static void _add_raid_members(struct raid_device *device)
+{
+	char temp[PATH_MAX];
+	char link[PATH_MAX];
+	struct block_device *block;
+	struct list dir;
+	const char *dir_path;
+
+	snprintf(temp, sizeof(temp), "%s/md", device->sysfs_path);
+	if (scan_dir(temp, &dir) != 0)
+		return;
+
+	list_for_each(&dir, dir_path) {
+		const char *t = strrchr(dir_path, '/');
+
+		if (!t || strncmp(t + 1, "dev-", 4) != 0)
+			continue;
+		if (slave_get_block_path(dir_path, link))
+			continue;
+		block = NULL;
+		list_for_each(&sysfs_block_list, block) {
+			if (strcmp(block->sysfs_path, link) == 0)
+				break;
+			block = NULL;
 		}
+		if (!block)
+			_block_add(link);
 	}
+	list_erase(&dir);
+}
+
+/**
+ * @brief Scans block devices of RAID members only.
+ *
+ * This is internal function of sysfs module. It is used instead of
+ * _scan_block() if only RAID members are monitored, so block devices which
+ * are not members of any RAID device are not initialized at all.
+ *
+ * @return The function does not return a value.
+ */
+static void _scan_raid_members(void)
+{
+	struct raid_device *device;
+
+	list_for_each(&volum_list, device)
+		_add_raid_members(device);
+	list_for_each(&cntnr_list, device)
+		_add_raid_members(device);
 }
 
 static void _scan_enclo(void)
 {
-	struct list dir;
-	if (scan_dir(SYSFS_CLASS_ENCLOSURE, &dir) == 0) {
-		const char *dir_path;
+	const char *path;
 
-		list_for_each(&dir, dir_path)
-			_check_enclo(dir_path);
-		list_erase(&dir);
-	}
+	_read_enclo_paths();
+	list_for_each(&enclo_paths, path)
+		_enclo_add(path);
 }
 
 static void _scan_slots(void)
@@ -488,8 +678,7 @@ static void _set_block_state(struct block_device *block, enum ibpi_pattern ibpi)
 	debug_dev = debug_dev ? debug_dev + 1 : block->sysfs_path;
 	log_debug("(%s): device: %s, state: %s", __func__, debug_dev,
 		  ibpi2str(ibpi));
-	if (block->ibpi < ibpi)
-		block->ibpi = ibpi;
+	block_add_indication(block, ibpi);
 }
 
 /**
@@ -576,6 +765,7 @@ void sysfs_init(void)
 	list_init(&cntnr_list, (item_free_t)raid_device_fini);
 	list_init(&enclo_list, (item_free_t)enclosure_device_fini);
 	list_init(&slots_list, (item_free_t)pci_slot_fini);
+	list_init(&enclo_paths, NULL);
 }
 
 void sysfs_reset(void)
@@ -587,20 +777,110 @@ void sysfs_reset(void)
 	list_erase(&cntnr_list);
 	list_erase(&enclo_list);
 	list_erase(&slots_list);
+	list_erase(&enclo_paths);
+	enclo_paths_read = 0;
 }
 
-void sysfs_scan(void)
+/**
+ * @brief Runs single phase of sysfs scan surrounded by probes.
+ */
+static void _scan_phase(const char *phase, void (*scan)(void))
 {
-	_scan_enclo();
-	_scan_cntrl();
-	_scan_slots();
-	_scan_block();
-	_scan_raid();
-	_scan_slave();
+	PROBE1(scan_start, phase);
+	scan();
+	PROBE1(scan_end, phase);
+}
+
+/**
+ * Bit mask of controller types. It is used to declare types of controllers
+ * which depend on the result of a scan phase.
+ */
+#define CNTRL_MASK(type)	(1u << (type))
 
+/**
+ * @brief Runs scan phase only if a controller which depends on it is present.
+ *
+ * This is internal function of sysfs module. Controllers have to be scanned
+ * before the function is called.
+ *
+ * @param[in]      phase          Name of the phase.
+ * @param[in]      scan           Function scanning the phase.
+ * @param[in]      needed_by      Mask of controller types using the phase.
+ *
+ * @return The function does not return a value.
+ */
+static void _scan_phase_for(const char *phase, void (*scan)(void),
+			    unsigned int needed_by)
+{
+	struct cntrl_device *cntrl;
+
+	list_for_each(&cntrl_list, cntrl) {
+		if (needed_by & CNTRL_MASK(cntrl->cntrl_type)) {
+			_scan_phase(phase, scan);
+			return;
+		}
+	}
+	log_debug("Scan phase %s skipped, no controller depends on it.", phase);
+}
+
+static void _scan_determine_slaves(void)
+{
 	_determine_slaves(&slave_list);
 }
 
+static void _topology_block_add(const char *path)
+{
+	struct block_device *device = block_device_init(&cntrl_list, path);
+
+	if (device)
+		list_append(&sysfs_block_list, device);
+}
+
+void sysfs_scan_topology(void)
+{
+	sysfs_reset();
+	topology_for_each(TOPOLOGY_KIND_CNTRL, _cntrl_add);
+	topology_for_each(TOPOLOGY_KIND_ENCLOSURE, _enclo_add);
+	/* PCI slots are not listed in the snapshot */
+	_scan_phase_for("slots", _scan_slots, CNTRL_MASK(CNTRL_TYPE_VMD));
+	topology_for_each(TOPOLOGY_KIND_BLOCK, _topology_block_add);
+}
+
+void sysfs_scan(void)
+{
+	/* RAID devices and slots are always scanned again */
+	list_erase(&volum_list);
+	list_erase(&slave_list);
+	list_erase(&cntnr_list);
+	list_erase(&slots_list);
+	list_erase(&enclo_paths);
+	enclo_paths_read = 0;
+
+	cadence_begin();
+	topology_scan_begin();
+	_stale_begin(&cntrl_list);
+	_scan_phase("cntrl", _scan_cntrl);
+	_stale_end();
+	/* enclosures and slots which are not scanned are released */
+	_stale_begin(&enclo_list);
+	_scan_phase_for("enclo", _scan_enclo, CNTRL_MASK(CNTRL_TYPE_SCSI));
+	_enclo_expire_stale();
+	_stale_end();
+	_scan_phase_for("slots", _scan_slots, CNTRL_MASK(CNTRL_TYPE_VMD));
+	_stale_begin(&sysfs_block_list);
+	if (conf.raid_members_only) {
+		_scan_phase("raid", _scan_raid);
+		_scan_phase("raid_members", _scan_raid_members);
+	} else {
+		_scan_phase("block", _scan_block);
+		_scan_phase("raid", _scan_raid);
+	}
+	_stale_end();
+	_scan_phase("slave", _scan_slave);
+	_scan_phase("determine_slaves", _scan_determine_slaves);
+	topology_scan_end();
+}
+
 /*
  * The function reutrns list of enclosure devices attached to SAS/SCSI storage
  * controller(s).
@@ -642,11 +922,11 @@ const struct list *sysfs_get_pci_slots(void)
  */
 int sysfs_enclosure_attached_to_cntrl(const char *path)
 {
-	struct enclosure_device *device;
+	const char *enclo_path;
 
-	list_for_each(&enclo_list, device) {
-		if ((device->sysfs_path != NULL) &&
-		    (strncmp(device->sysfs_path, path, strlen(path)) == 0))
+	_read_enclo_paths();
+	list_for_each(&enclo_paths, enclo_path) {
+		if (strncmp(enclo_path, path, strlen(path)) == 0)
 			return 1;
 	}
 	return 0;
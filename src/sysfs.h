@@ -43,9 +43,21 @@ void sysfs_reset(void);
  * This function scans sysfs tree for storage controllers, block devices, RAID
  * devices, container devices, slave devices and enclosure devices registered
  * in the system. Only supported block and controller devices are put on a list.
+ * Controllers, enclosures and block devices found by the previous scan are
+ * kept unless their controller is due to be refreshed, see cadence.h.
  */
 void sysfs_scan(void);
 
+/**
+ * @brief Populates internal lists from trusted topology snapshot.
+ *
+ * This function takes controllers, enclosures and block devices listed in the
+ * loaded topology snapshot instead of discovering them, see topology.h. Block
+ * devices which cannot be initialized are skipped. RAID devices are not
+ * scanned.
+ */
+void sysfs_scan_topology(void);
+
 /**
  * The function returns list of enclosure devices attached to SAS/SCSI storage
  * controller(s).
@@ -0,0 +1,251 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <time.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "list.h"
+#include "pidfile.h"
+#include "timed.h"
+#include "utils.h"
+
+/**
+ * @brief Pattern waiting in the timer wheel.
+ */
+struct timed_entry {
+	char *path;
+	enum ibpi_pattern ibpi;
+	/* full turns of the wheel left before the pattern expires */
+	unsigned int rounds;
+};
+
+static struct list wheel[TIMED_WHEEL_SLOTS];
+static int wheel_ready;
+static int wheel_count;
+/* the last tick processed, in seconds of monotonic clock */
+static uint64_t wheel_tick;
+
+static void _entry_free(struct timed_entry *entry)
+{
+	free(entry->path);
+	free(entry);
+}
+
+static void _wheel_init(void)
+{
+	int i;
+
+	for (i = 0; i < TIMED_WHEEL_SLOTS; i++)
+		list_init(&wheel[i], (item_free_t)_entry_free);
+	wheel_tick = get_monotonic_ms() / 1000;
+	wheel_count = 0;
+	wheel_ready = 1;
+}
+
+static void _wheel_remove(const char *path)
+{
+	struct timed_entry *entry;
+	struct node *node;
+	int i;
+
+	for (i = 0; i < TIMED_WHEEL_SLOTS && wheel_count; i++) {
+		list_for_each_node(&wheel[i], node) {
+			entry = node->item;
+			if (strcmp(entry->path, path) == 0) {
+				list_delete(node);
+				wheel_count--;
+				return;
+			}
+		}
+	}
+}
+
+static void _wheel_add(const char *path, enum ibpi_pattern ibpi,
+		       uint64_t tick)
+{
+	struct timed_entry *entry;
+
+	_wheel_remove(path);
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+	if (tick <= wheel_tick)
+		tick = wheel_tick + 1;
+	entry->path = str_dup(path);
+	entry->ibpi = ibpi;
+	entry->rounds = (tick - wheel_tick - 1) / TIMED_WHEEL_SLOTS;
+	list_append(&wheel[tick % TIMED_WHEEL_SLOTS], entry);
+	wheel_count++;
+}
+
+status_t timed_submit(const char * const *paths, const enum ibpi_pattern *ibpis,
+		      int count, int seconds)
+{
+	status_t status = STATUS_SUCCESS;
+	time_t expiry = time(NULL) + seconds;
+	pid_t pid;
+	FILE *f;
+	int fd, i;
+
+	if (pidfile_check("ledmon", &pid) != STATUS_SUCCESS)
+		return STATUS_INVALID_STATE;
+
+	fd = run_file_open(TIMED_REQUEST_FILE, O_WRONLY | O_APPEND | O_CREAT);
+	if (fd < 0)
+		return STATUS_FILE_OPEN_ERROR;
+	f = fdopen(fd, "a");
+	if (!f) {
+		close(fd);
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	if (flock(fd, LOCK_EX)) {
+		fclose(f);
+		return STATUS_FILE_LOCK_ERROR;
+	}
+	for (i = 0; i < count; i++)
+		fprintf(f, "%s\t%d\t%lld\n", paths[i], (int)ibpis[i],
+			(long long)expiry);
+	if (fflush(f))
+		status = STATUS_FILE_WRITE_ERROR;
+	fclose(f);
+
+	if (status == STATUS_SUCCESS && kill(pid, SIGUSR1))
+		status = STATUS_INVALID_STATE;
+	return status;
+}
+
+int timed_load(void)
+{
+	char line[PATH_MAX + 64], *path, *sep;
+	long long expiry;
+	uint64_t now;
+	time_t wall;
+	int fd, ibpi, loaded = 0;
+	FILE *f;
+
+	/* requests of other users are never loaded, see run_file_open() */
+	fd = run_file_open(TIMED_REQUEST_FILE, O_RDWR);
+	if (fd < 0)
+		return 0;
+	f = fdopen(fd, "r");
+	if (!f) {
+		close(fd);
+		return 0;
+	}
+	if (flock(fd, LOCK_EX)) {
+		fclose(f);
+		return 0;
+	}
+	if (!wheel_ready)
+		_wheel_init();
+	now = get_monotonic_ms();
+	wall = time(NULL);
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\n")] = '\0';
+		path = line;
+		sep = strchr(line, '\t');
+		if (!sep || sscanf(sep + 1, "%d\t%lld", &ibpi, &expiry) != 2 ||
+		    ibpi < 0 || ibpi >= ibpi_pattern_count) {
+			log_warning("timed: invalid request '%s'.", line);
+			continue;
+		}
+		*sep = '\0';
+		/* requests carry wall clock time, the wheel runs on monotonic */
+		_wheel_add(path, ibpi,
+			   expiry > wall ? (now / 1000) + (expiry - wall) : 0);
+		log_info("TIMED %s: '%s' expires in %lld s.", path,
+			 ibpi2str(ibpi), expiry > wall ? expiry - wall : 0);
+		loaded++;
+	}
+	if (ftruncate(fd, 0))
+		log_warning("timed: unable to clear %s: %s", TIMED_REQUEST_FILE,
+			    strerror(errno));
+	fclose(f);
+	return loaded;
+}
+
+uint64_t timed_next(void)
+{
+	struct timed_entry *entry;
+	uint64_t tick;
+
+	if (!wheel_ready || !wheel_count)
+		return 0;
+	for (tick = wheel_tick + 1; tick <= wheel_tick + TIMED_WHEEL_SLOTS;
+	     tick++) {
+		list_for_each(&wheel[tick % TIMED_WHEEL_SLOTS], entry) {
+			if (entry->rounds == 0)
+				return tick * 1000;
+		}
+	}
+	/* patterns beyond one turn, wake up to count the turn down */
+	return (wheel_tick + TIMED_WHEEL_SLOTS) * 1000;
+}
+
+int timed_expire(uint64_t now,
+		 void (*expired)(const char *path, enum ibpi_pattern ibpi))
+{
+	struct timed_entry *entry;
+	struct node *node;
+	int count = 0;
+
+	if (!wheel_ready)
+		return 0;
+	while (wheel_tick < now / 1000 && wheel_count) {
+		wheel_tick++;
+		list_for_each_node(&wheel[wheel_tick % TIMED_WHEEL_SLOTS], node) {
+			entry = node->item;
+			if (entry->rounds) {
+				entry->rounds--;
+				continue;
+			}
+			expired(entry->path, entry->ibpi);
+			list_delete(node);
+			wheel_count--;
+			count++;
+		}
+	}
+	/* nothing is pending, so the wheel simply jumps to the current tick */
+	if (wheel_tick < now / 1000)
+		wheel_tick = now / 1000;
+	return count;
+}
+
+void timed_fini(void)
+{
+	int i;
+
+	if (!wheel_ready)
+		return;
+	for (i = 0; i < TIMED_WHEEL_SLOTS; i++)
+		list_erase(&wheel[i]);
+	wheel_ready = 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _TIMED_H_INCLUDED_
+#define _TIMED_H_INCLUDED_
+
+#include <stdint.h>
+
+#include "ibpi.h"
+#include "status.h"
+#include "utils.h"
+
+/*
+ * Timed patterns.
+ *
+ * ledctl sets a pattern given with --duration as usual and submits the
+ * devices to ledmon by appending lines to TIMED_REQUEST_FILE, then it sends
+ * SIGUSR1 to ledmon. Each line has tab separated fields: canonical sysfs path
+ * of the block device, IBPI pattern number and expiry time in seconds since
+ * the Epoch.
+ *
+ * ledmon keeps the patterns in a timer wheel with one second ticks and wakes
+ * up only when the nearest pattern expires. Expired devices are reverted to
+ * the state computed by ledmon.
+ */
+
+/**
+ * File ledctl submits timed patterns to.
+ */
+#define TIMED_REQUEST_FILE	LEDMON_RUN_DIR "/timed"
+
+/**
+ * Number of slots of the timer wheel. Each slot is one second wide.
+ */
+#define TIMED_WHEEL_SLOTS	256
+
+/**
+ * @brief Submits timed patterns to ledmon.
+ *
+ * @param[in]    paths           - canonical sysfs paths of block devices.
+ * @param[in]    ibpis           - patterns set on the devices.
+ * @param[in]    count           - number of devices.
+ * @param[in]    seconds         - duration of the patterns.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t timed_submit(const char * const *paths, const enum ibpi_pattern *ibpis,
+		      int count, int seconds);
+
+/**
+ * @brief Puts requests submitted by ledctl into the timer wheel.
+ *
+ * A new request for a device replaces the pending one.
+ *
+ * @return Number of requests loaded.
+ */
+int timed_load(void);
+
+/**
+ * @brief Gets time of the nearest tick with a pattern to expire.
+ *
+ * @return Time in milliseconds of monotonic clock or 0 if the wheel is empty.
+ */
+uint64_t timed_next(void);
+
+/**
+ * @brief Advances the timer wheel.
+ *
+ * The function is called for each pattern which has expired.
+ *
+ * @param[in]    now             - current time in milliseconds of monotonic
+ *                                 clock.
+ * @param[in]    expired         - function called with sysfs path of the device
+ *                                 and the pattern which has expired.
+ *
+ * @return Number of expired patterns.
+ */
+int timed_expire(uint64_t now,
+		 void (*expired)(const char *path, enum ibpi_pattern ibpi));
+
+/**
+ * @brief Releases all pending patterns.
+ *
+ * @return The function does not return a value.
+ */
+void timed_fini(void);
+
+#endif				/* _TIMED_H_INCLUDED_ */
@@ -0,0 +1,50 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <string.h>
+
+#include "token.h"
+
+static int _is_trailing(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+int token_lookup(const struct token *table, size_t count, const char *s,
+		 size_t len)
+{
+	size_t i;
+
+	while (len && _is_trailing(s[len - 1]))
+		len--;
+	if (len == 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		if (table[i].len == len && table[i].name[0] == s[0] &&
+		    memcmp(table[i].name, s, len) == 0)
+			return table[i].value;
+	}
+	return -1;
+}
+
+int token_find(const struct token *table, size_t count, const char *s)
+{
+	return token_lookup(table, count, s, strlen(s));
+}
@@ -0,0 +1,74 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _TOKEN_H_INCLUDED_
+#define _TOKEN_H_INCLUDED_
+
+#include <stddef.h>
+
+/**
+ * @brief Entry of token table.
+ *
+ * Length of the name is computed at compile time, so lookup compares lengths
+ * first and touches the text only for entries of matching length.
+ */
+struct token {
+	const char *name;
+	size_t len;
+	int value;
+};
+
+/**
+ * Defines token table entry. The name has to be a string literal.
+ */
+#define TOKEN(name, value)	{ name, sizeof(name) - 1, value }
+
+/**
+ * Number of entries of token table.
+ */
+#define TOKEN_COUNT(table)	(sizeof(table) / sizeof((table)[0]))
+
+/**
+ * @brief Looks up a token of known length.
+ *
+ * Trailing white spaces and new line characters are ignored. At most len
+ * characters of the text are read.
+ *
+ * @param[in]    table           - token table.
+ * @param[in]    count           - number of entries of the table.
+ * @param[in]    s               - text to look up.
+ * @param[in]    len             - length of the text.
+ *
+ * @return Value of matching token or -1 if there is no match.
+ */
+int token_lookup(const struct token *table, size_t count, const char *s,
+		 size_t len);
+
+/**
+ * @brief Looks up a null terminated token.
+ *
+ * @param[in]    table           - token table.
+ * @param[in]    count           - number of entries of the table.
+ * @param[in]    s               - text to look up.
+ *
+ * @return Value of matching token or -1 if there is no match.
+ */
+int token_find(const struct token *table, size_t count, const char *s);
+
+#endif				/* _TOKEN_H_INCLUDED_ */
@@ -0,0 +1,843 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "block.h"
+#include "cadence.h"
+#include "list.h"
+#include "sysfs.h"
+#include "topology.h"
+#include "utils.h"
+
+/**
+ * Maximum number of tab separated fields of manifest line.
+ */
+#define TOPOLOGY_MAX_FIELDS	6
+
+/**
+ * @brief Controller listed in the manifest.
+ */
+struct topology_cntrl {
+	char *path;
+	enum cntrl_type type;
+	int isci_present;
+	struct _host_type *hosts;
+	int seen;
+};
+
+/**
+ * @brief Enclosure listed in the manifest.
+ */
+struct topology_encl {
+	char *path;
+	uint64_t sas_address;
+	char *dev_path;
+};
+
+/**
+ * @brief Enclosure slot of block device listed in the manifest.
+ */
+struct topology_slot {
+	char *path;
+	int encl_index;
+};
+
+/**
+ * @brief Block device listed in the snapshot.
+ */
+struct topology_block {
+	char *path;
+	char *cntrl_path;
+	int host_id;
+	int phy_index;
+	int encl_index;
+};
+
+/**
+ * State of the manifest.
+ */
+enum topology_state {
+	TOPOLOGY_NONE = 0,
+	TOPOLOGY_TRUSTED,
+	TOPOLOGY_VALIDATE,
+};
+
+static enum topology_state state;
+static char *topology_path;
+static struct list cntrls;
+static struct list enclos;
+static struct list slots;
+static struct list blocks;
+static unsigned long long generation;
+
+/* the last snapshot published by ledmon */
+static char *published;
+static size_t published_len;
+static unsigned long long published_generation;
+
+static void _cntrl_free(struct topology_cntrl *cntrl)
+{
+	free(cntrl->path);
+	free_hosts(cntrl->hosts);
+	free(cntrl);
+}
+
+static void _encl_free(struct topology_encl *encl)
+{
+	free(encl->path);
+	free(encl->dev_path);
+	free(encl);
+}
+
+static void _slot_free(struct topology_slot *slot)
+{
+	free(slot->path);
+	free(slot);
+}
+
+static void _block_free(struct topology_block *block)
+{
+	free(block->path);
+	free(block->cntrl_path);
+	free(block);
+}
+
+/**
+ * @brief Looks for an item of the list by path.
+ *
+ * The path is expected to be the first field of the item.
+ */
+static void *_find(const struct list *list, const char *path)
+{
+	void *item;
+
+	list_for_each(list, item) {
+		if (strcmp(*(char **)item, path) == 0)
+			return item;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Drops the manifest after a mismatch with the discovered topology.
+ */
+static void _mismatch(const char *fmt, ...)
+{
+	char buf[BUFSIZ];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	log_warning("topology: %s does not match the system: %s. Regenerate it with ledctl --dump-topology.",
+		    topology_path, buf);
+	topology_fini();
+}
+
+static int _count(const struct list *list)
+{
+	const void *item;
+	int n = 0;
+
+	list_for_each(list, item)
+		n++;
+	return n;
+}
+
+static int _parse_int(const char *s, int *value)
+{
+	char *end;
+	long v;
+
+	errno = 0;
+	v = strtol(s, &end, 10);
+	if (errno || end == s || *end || v < INT_MIN || v > INT_MAX)
+		return -1;
+	*value = (int)v;
+	return 0;
+}
+
+/**
+ * @brief Parses port to phy map in format "port:phy,port:phy".
+ */
+static int _parse_port_phys(char *s, struct _host_type *host)
+{
+	struct _port_phy *map;
+	char *item;
+	int port_id, phy_index;
+
+	if (strcmp(s, "-") == 0)
+		return 0;
+	while ((item = strsep(&s, ","))) {
+		if (sscanf(item, "%d:%d", &port_id, &phy_index) != 2)
+			return -1;
+		map = realloc(host->port_phys,
+			      (host->port_phys_len + 1) * sizeof(*map));
+		if (!map)
+			return -1;
+		map[host->port_phys_len].port_id = port_id;
+		map[host->port_phys_len].phy_index = phy_index;
+		host->port_phys = map;
+		host->port_phys_len++;
+	}
+	return 0;
+}
+
+static int _load_cntrl(char **field, int n)
+{
+	struct topology_cntrl *cntrl;
+	enum cntrl_type type;
+	int isci;
+
+	if (n != 4 || _parse_int(field[2], &isci))
+		return -1;
+	type = cntrl_type_lookup(field[1], strlen(field[1]));
+	if (type == CNTRL_TYPE_UNKNOWN || _find(&cntrls, field[3]))
+		return -1;
+	cntrl = calloc(1, sizeof(*cntrl));
+	if (!cntrl)
+		return -1;
+	cntrl->path = str_dup(field[3]);
+	cntrl->type = type;
+	cntrl->isci_present = isci;
+	list_append(&cntrls, cntrl);
+	return 0;
+}
+
+static int _load_host(char **field, int n)
+{
+	struct topology_cntrl *cntrl;
+	struct _host_type *host, **tail;
+	int host_id, ports;
+
+	if (n != 5 || _parse_int(field[2], &host_id) ||
+	    _parse_int(field[3], &ports))
+		return -1;
+	cntrl = _find(&cntrls, field[1]);
+	if (!cntrl || cntrl->type != CNTRL_TYPE_SCSI)
+		return -1;
+	/* hosts are kept in the order of the manifest */
+	for (tail = &cntrl->hosts; *tail; tail = &(*tail)->next)
+		;
+	host = alloc_host(host_id, NULL);
+	if (!host)
+		return -1;
+	*tail = host;
+	host->ports = ports;
+	return _parse_port_phys(field[4], host);
+}
+
+static int _load_encl(char **field, int n)
+{
+	struct topology_encl *encl;
+	char *end;
+
+	if (n != 4 || _find(&enclos, field[1]))
+		return -1;
+	encl = calloc(1, sizeof(*encl));
+	if (!encl)
+		return -1;
+	encl->path = str_dup(field[1]);
+	if (strcmp(field[2], "-") != 0)
+		encl->dev_path = str_dup(field[2]);
+	list_append(&enclos, encl);
+	errno = 0;
+	encl->sas_address = strtoull(field[3], &end, 16);
+	return (errno || end == field[3] || *end) ? -1 : 0;
+}
+
+static int _load_slot(char **field, int n)
+{
+	struct topology_slot *slot;
+	int encl_index;
+
+	if (n != 3 || _parse_int(field[2], &encl_index) || encl_index < 0 ||
+	    _find(&slots, field[1]))
+		return -1;
+	slot = calloc(1, sizeof(*slot));
+	if (!slot)
+		return -1;
+	slot->path = str_dup(field[1]);
+	slot->encl_index = encl_index;
+	list_append(&slots, slot);
+	return 0;
+}
+
+static int _load_block(char **field, int n)
+{
+	struct topology_block *block;
+	char *slot[3];
+
+	if (n != 6 || _find(&blocks, field[1]))
+		return -1;
+	block = calloc(1, sizeof(*block));
+	if (!block)
+		return -1;
+	block->path = str_dup(field[1]);
+	block->cntrl_path = str_dup(field[2]);
+	list_append(&blocks, block);
+	if (_parse_int(field[3], &block->host_id) ||
+	    _parse_int(field[4], &block->phy_index) ||
+	    _parse_int(field[5], &block->encl_index))
+		return -1;
+	if (block->encl_index < 0)
+		return 0;
+	/* the slot mapping is used as given by SLOT line */
+	slot[0] = field[0];
+	slot[1] = field[1];
+	slot[2] = field[5];
+	return _load_slot(slot, 3);
+}
+
+static int _load_generation(char **field, int n)
+{
+	char *end;
+
+	if (n != 2)
+		return -1;
+	errno = 0;
+	generation = strtoull(field[1], &end, 10);
+	return (errno || end == field[1] || *end) ? -1 : 0;
+}
+
+static int _load_line(char *line)
+{
+	char *field[TOPOLOGY_MAX_FIELDS + 1];
+	int n = 0;
+
+	while (n <= TOPOLOGY_MAX_FIELDS && (field[n] = strsep(&line, "\t")))
+		n++;
+	if (n > TOPOLOGY_MAX_FIELDS)
+		return -1;
+	if (strcmp(field[0], "CNTRL") == 0)
+		return _load_cntrl(field, n);
+	if (strcmp(field[0], "HOST") == 0)
+		return _load_host(field, n);
+	if (strcmp(field[0], "ENCLOSURE") == 0)
+		return _load_encl(field, n);
+	if (strcmp(field[0], "SLOT") == 0)
+		return _load_slot(field, n);
+	if (strcmp(field[0], "BLOCK") == 0)
+		return _load_block(field, n);
+	if (strcmp(field[0], "GENERATION") == 0)
+		return _load_generation(field, n);
+	return -1;
+}
+
+status_t topology_load(const char *path)
+{
+	char line[BUFSIZ];
+	int line_no = 0;
+	FILE *f;
+
+	topology_fini();
+	f = fopen(path, "re");
+	if (!f) {
+		log_warning("topology: unable to open %s: %s", path,
+			    strerror(errno));
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	list_init(&cntrls, (item_free_t)_cntrl_free);
+	list_init(&enclos, (item_free_t)_encl_free);
+	list_init(&slots, (item_free_t)_slot_free);
+	list_init(&blocks, (item_free_t)_block_free);
+	topology_path = str_dup(path);
+	generation = 0;
+	state = TOPOLOGY_TRUSTED;
+
+	while (fgets(line, sizeof(line), f)) {
+		line_no++;
+		line[strcspn(line, "\n")] = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+		if (_load_line(line)) {
+			log_warning("topology: %s:%d: invalid line, manifest ignored.",
+				    path, line_no);
+			fclose(f);
+			topology_fini();
+			return STATUS_INVALID_FORMAT;
+		}
+	}
+	fclose(f);
+	log_info("topology: %d controllers, %d enclosures and %d slots loaded from %s.",
+		 _count(&cntrls), _count(&enclos), _count(&slots), path);
+	if (generation)
+		log_debug("topology: snapshot generation %llu.", generation);
+	return STATUS_SUCCESS;
+}
+
+void topology_fini(void)
+{
+	if (state == TOPOLOGY_NONE)
+		return;
+	list_erase(&cntrls);
+	list_erase(&enclos);
+	list_erase(&slots);
+	list_erase(&blocks);
+	free(topology_path);
+	topology_path = NULL;
+	state = TOPOLOGY_NONE;
+}
+
+int topology_trusted(void)
+{
+	return state == TOPOLOGY_TRUSTED;
+}
+
+void topology_scan_begin(void)
+{
+	struct topology_cntrl *cntrl;
+
+	if (state != TOPOLOGY_VALIDATE)
+		return;
+	list_for_each(&cntrls, cntrl)
+		cadence_expire(cntrl->path);
+}
+
+void topology_scan_end(void)
+{
+	struct topology_cntrl *cntrl;
+
+	switch (state) {
+	case TOPOLOGY_TRUSTED:
+		state = TOPOLOGY_VALIDATE;
+		break;
+	case TOPOLOGY_VALIDATE:
+		list_for_each(&cntrls, cntrl) {
+			if (!cntrl->seen) {
+				_mismatch("controller %s not found",
+					  cntrl->path);
+				return;
+			}
+		}
+		log_info("topology: %s validated.", topology_path);
+		topology_fini();
+		break;
+	default:
+		break;
+	}
+}
+
+struct cntrl_device *topology_cntrl(const char *path)
+{
+	struct topology_cntrl *cntrl;
+	struct cntrl_device *device;
+	struct _host_type *h, *host, **tail;
+
+	if (state != TOPOLOGY_TRUSTED)
+		return NULL;
+	cntrl = _find(&cntrls, path);
+	if (!cntrl)
+		return NULL;
+	device = calloc(1, sizeof(*device));
+	if (!device)
+		return NULL;
+	device->sysfs_path = str_dup(cntrl->path);
+	device->cntrl_type = cntrl->type;
+	device->isci_present = cntrl->isci_present;
+	tail = &device->hosts;
+	for (h = cntrl->hosts; h; h = h->next) {
+		host = alloc_host(h->host_id, NULL);
+		if (!host)
+			break;
+		host->ports = h->ports;
+		if (h->port_phys_len) {
+			host->port_phys = malloc(h->port_phys_len *
+						 sizeof(*h->port_phys));
+			if (host->port_phys) {
+				memcpy(host->port_phys, h->port_phys,
+				       h->port_phys_len * sizeof(*h->port_phys));
+				host->port_phys_len = h->port_phys_len;
+			}
+		}
+		*tail = host;
+		tail = &host->next;
+	}
+	return device;
+}
+
+/**
+ * @brief Checks SCSI generic device of enclosure against sysfs.
+ *
+ * The device recorded in the manifest must be listed in scsi_generic
+ * directory of the enclosure, sg devices are renumbered on reboot or rescan.
+ * An enclosure without the device must have no such directory.
+ *
+ * @return 1 if the device matches sysfs, otherwise 0.
+ */
+static int _encl_sg_valid(const char *path, const char *dev_path)
+{
+	char buf[PATH_MAX];
+	const char *name;
+
+	if (!dev_path) {
+		snprintf(buf, sizeof(buf), "%s/device/scsi_generic", path);
+		return access(buf, F_OK) != 0;
+	}
+	if (strncmp(dev_path, "/dev/", 5))
+		return 0;
+	name = dev_path + 5;
+	if (!*name || strchr(name, '/'))
+		return 0;
+	snprintf(buf, sizeof(buf), "%s/device/scsi_generic/%s", path, name);
+	return access(buf, F_OK) == 0;
+}
+
+struct enclosure_device *topology_enclosure(const char *path)
+{
+	struct topology_encl *encl;
+	struct enclosure_device *device;
+
+	if (state != TOPOLOGY_TRUSTED)
+		return NULL;
+	encl = _find(&enclos, path);
+	if (!encl)
+		return NULL;
+	if (!_encl_sg_valid(encl->path, encl->dev_path)) {
+		log_debug("topology: sg device of %s changed.", encl->path);
+		return NULL;
+	}
+	device = calloc(1, sizeof(*device));
+	if (!device)
+		return NULL;
+	device->sysfs_path = str_dup(encl->path);
+	device->sas_address = encl->sas_address;
+	if (encl->dev_path)
+		device->dev_path = str_dup(encl->dev_path);
+	return device;
+}
+
+void topology_for_each(enum topology_kind kind, void (*fn)(const char *path))
+{
+	const struct list *list;
+	void *item;
+
+	if (state != TOPOLOGY_TRUSTED)
+		return;
+	switch (kind) {
+	case TOPOLOGY_KIND_CNTRL:
+		list = &cntrls;
+		break;
+	case TOPOLOGY_KIND_ENCLOSURE:
+		list = &enclos;
+		break;
+	case TOPOLOGY_KIND_BLOCK:
+		list = &blocks;
+		break;
+	default:
+		return;
+	}
+	list_for_each(list, item)
+		fn(*(char **)item);
+}
+
+/**
+ * @brief Checks phy of block device against sysfs.
+ *
+ * The phy has to be linked in port-H:P directory of the port the device is
+ * attached to, the same port cntrl_init_smp() looks up.
+ */
+static int _phy_valid(const struct block_device *device)
+{
+	char buf[PATH_MAX];
+	const char *c;
+	int host_id, port_id;
+
+	if (device->phy_index < 0)
+		return 1;
+	c = strstr(device->sysfs_path, "port-");
+	if (!c || sscanf(c, "port-%d:%d", &host_id, &port_id) != 2)
+		return 0;
+	snprintf(buf, sizeof(buf), "%.*s/phy-%d:%d",
+		 (int)(c - device->sysfs_path + strcspn(c, "/")),
+		 device->sysfs_path, host_id, device->phy_index);
+	return access(buf, F_OK) == 0;
+}
+
+/**
+ * @brief Checks enclosure slot of block device against sysfs.
+ *
+ * The slot is read from the enclosure component the device is linked to. If
+ * the kernel does not provide it, the slot taken from the snapshot cannot be
+ * confirmed.
+ */
+static int _slot_valid(const struct block_device *device)
+{
+	if (device->encl_index < 0)
+		return 1;
+	return get_int(device->cntrl_path, -1, "slot") == device->encl_index;
+}
+
+int topology_block_valid(const struct block_device *device)
+{
+	struct topology_block *block;
+
+	if (state != TOPOLOGY_TRUSTED)
+		return 0;
+	block = _find(&blocks, device->sysfs_path);
+	return block && device->cntrl_path &&
+	       strcmp(block->cntrl_path, device->cntrl_path) == 0 &&
+	       block->host_id == device->host_id &&
+	       block->phy_index == device->phy_index &&
+	       block->encl_index == device->encl_index &&
+	       _phy_valid(device) && _slot_valid(device);
+}
+
+int topology_snapshot_current(void)
+{
+	char line[BUFSIZ];
+	char *field[2];
+	char *s;
+	int fd, ret = 0;
+	FILE *f;
+
+	if (state != TOPOLOGY_TRUSTED || !generation)
+		return 0;
+	fd = run_file_open(TOPOLOGY_SNAPSHOT_FILE, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	f = fdopen(fd, "r");
+	if (!f) {
+		close(fd);
+		return 0;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#')
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+		s = line;
+		field[0] = strsep(&s, "\t");
+		field[1] = s;
+		if (strcmp(field[0], "GENERATION") == 0 && field[1])
+			ret = strtoull(field[1], NULL, 10) == generation;
+		break;
+	}
+	fclose(f);
+	return ret;
+}
+
+int topology_slot(const char *path, int *encl_index)
+{
+	struct topology_slot *slot;
+
+	if (state != TOPOLOGY_TRUSTED)
+		return 0;
+	slot = _find(&slots, path);
+	if (!slot)
+		return 0;
+	*encl_index = slot->encl_index;
+	return 1;
+}
+
+static int _hosts_equal(const struct _host_type *a, const struct _host_type *b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		if (a->host_id != b->host_id || a->ports != b->ports ||
+		    a->port_phys_len != b->port_phys_len)
+			return 0;
+		if (a->port_phys_len &&
+		    memcmp(a->port_phys, b->port_phys,
+			   a->port_phys_len * sizeof(*a->port_phys)))
+			return 0;
+	}
+	return !a && !b;
+}
+
+void topology_check_cntrl(const char *path, const struct cntrl_device *device)
+{
+	struct topology_cntrl *cntrl;
+
+	if (state != TOPOLOGY_VALIDATE)
+		return;
+	cntrl = _find(&cntrls, path);
+	if (!cntrl) {
+		if (device)
+			_mismatch("controller %s not listed", path);
+		return;
+	}
+	cntrl->seen = 1;
+	if (!device)
+		_mismatch("controller %s not found", path);
+	else if (device->cntrl_type != cntrl->type ||
+		 device->isci_present != cntrl->isci_present)
+		_mismatch("controller %s has changed type", path);
+	else if (!_hosts_equal(device->hosts, cntrl->hosts))
+		_mismatch("hosts of controller %s have changed", path);
+}
+
+void topology_check_enclosure(const struct enclosure_device *device)
+{
+	struct topology_encl *encl;
+
+	if (state != TOPOLOGY_VALIDATE)
+		return;
+	encl = _find(&enclos, device->sysfs_path);
+	if (!encl)
+		_mismatch("enclosure %s not listed", device->sysfs_path);
+	else if (encl->sas_address != device->sas_address ||
+		 strcmp(encl->dev_path ? encl->dev_path : "",
+			device->dev_path ? device->dev_path : "") != 0)
+		_mismatch("enclosure %s has changed", device->sysfs_path);
+}
+
+void topology_check_slot(const char *path, int encl_index)
+{
+	struct topology_slot *slot;
+
+	if (state != TOPOLOGY_VALIDATE)
+		return;
+	slot = _find(&slots, path);
+	/* block devices come and go, only mapping of listed ones is checked */
+	if (slot && slot->encl_index != encl_index)
+		_mismatch("slot of %s has changed", path);
+}
+
+static void _dump_hosts(FILE *f, const struct cntrl_device *device)
+{
+	const struct _host_type *host;
+	int i;
+
+	for (host = device->hosts; host; host = host->next) {
+		fprintf(f, "HOST\t%s\t%d\t%d\t", device->sysfs_path,
+			host->host_id, host->ports);
+		for (i = 0; i < host->port_phys_len; i++)
+			fprintf(f, "%s%d:%d", i ? "," : "",
+				host->port_phys[i].port_id,
+				host->port_phys[i].phy_index);
+		fprintf(f, "%s\n", host->port_phys_len ? "" : "-");
+	}
+}
+
+static void _dump(FILE *f)
+{
+	struct cntrl_device *cntrl;
+	struct enclosure_device *encl;
+	struct block_device *block;
+
+	list_for_each(sysfs_get_cntrl_devices(), cntrl) {
+		fprintf(f, "CNTRL\t%s\t%d\t%s\n",
+			cntrl_type_name(cntrl->cntrl_type),
+			cntrl->isci_present, cntrl->sysfs_path);
+		_dump_hosts(f, cntrl);
+	}
+	list_for_each(sysfs_get_enclosure_devices(), encl) {
+		fprintf(f, "ENCLOSURE\t%s\t%s\t%" PRIx64 "\n", encl->sysfs_path,
+			encl->dev_path ? encl->dev_path : "-",
+			encl->sas_address);
+	}
+	list_for_each(sysfs_get_block_devices(), block) {
+		fprintf(f, "BLOCK\t%s\t%s\t%d\t%d\t%d\n", block->sysfs_path,
+			block->cntrl_path, block->host_id, block->phy_index,
+			block->enclosure ? block->encl_index : -1);
+	}
+}
+
+status_t topology_dump(FILE *f)
+{
+	fprintf(f, "# ledmon topology manifest, generated by ledctl --dump-topology\n");
+	_dump(f);
+	if (fflush(f) || ferror(f))
+		return STATUS_FILE_WRITE_ERROR;
+	return STATUS_SUCCESS;
+}
+
+status_t topology_publish(void)
+{
+	char tmp[PATH_MAX];
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f;
+	int fd, err;
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return STATUS_OUT_OF_MEMORY;
+	_dump(f);
+	if (fclose(f)) {
+		free(buf);
+		return STATUS_OUT_OF_MEMORY;
+	}
+	if (published && len == published_len &&
+	    memcmp(buf, published, len) == 0) {
+		free(buf);
+		return STATUS_SUCCESS;
+	}
+
+	/* readers see either the previous or the new snapshot */
+	fd = run_file_create(TOPOLOGY_SNAPSHOT_FILE, tmp, sizeof(tmp));
+	if (fd < 0) {
+		free(buf);
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	f = fdopen(fd, "w");
+	if (!f) {
+		close(fd);
+		unlink(tmp);
+		free(buf);
+		return STATUS_FILE_OPEN_ERROR;
+	}
+	/* ledctl run by other users may read the snapshot */
+	fchmod(fd, 0644);
+	/* a restarted ledmon must not repeat generations of the previous one */
+	if (!published_generation)
+		published_generation = (unsigned long long)time(NULL);
+	fprintf(f, "# ledmon topology snapshot\nGENERATION\t%llu\n",
+		published_generation + 1);
+	fwrite(buf, 1, len, f);
+	err = ferror(f);
+	if (fclose(f) || err || rename(tmp, TOPOLOGY_SNAPSHOT_FILE)) {
+		log_warning("topology: unable to publish %s: %s",
+			    TOPOLOGY_SNAPSHOT_FILE, strerror(errno));
+		unlink(tmp);
+		free(buf);
+		return STATUS_FILE_WRITE_ERROR;
+	}
+	free(published);
+	published = buf;
+	published_len = len;
+	published_generation++;
+	log_debug("topology: snapshot generation %llu published.",
+		  published_generation);
+	return STATUS_SUCCESS;
+}
+
+void topology_unpublish(void)
+{
+	if (!published)
+		return;
+	unlink(TOPOLOGY_SNAPSHOT_FILE);
+	free(published);
+	published = NULL;
+	published_len = 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _TOPOLOGY_H_INCLUDED_
+#define _TOPOLOGY_H_INCLUDED_
+
+#include <stdio.h>
+
+#include "block.h"
+#include "cntrl.h"
+#include "enclosure.h"
+#include "status.h"
+#include "utils.h"
+
+/*
+ * Topology manifest.
+ *
+ * The manifest lists controllers with their types and hosts, enclosures and
+ * slot mappings of block devices. It is generated by ledctl --dump-topology.
+ * If ledmon is given a manifest, the first scan takes controllers, enclosures
+ * and slots from it, so PCI functions are not classified, SAS hosts are not
+ * walked and SES pages are not read to map block devices to slots. The second
+ * scan discovers all controllers again and compares them with the manifest.
+ * A mismatch is logged and the manifest is not used anymore, so the full
+ * discovery of the second scan takes over.
+ *
+ * ledmon publishes the topology found by each scan as a snapshot in the same
+ * format. Block devices are listed with their controllers, hosts, phys and
+ * slots, and a generation number is incremented each time the topology
+ * changes. While ledmon is running, ledctl takes devices from the snapshot
+ * instead of discovering them and checks only the devices it has been asked
+ * about. If any of them is missing or has changed, or the generation of the
+ * snapshot has changed meanwhile, ledctl discovers everything with
+ * sysfs_scan().
+ */
+
+/**
+ * Path to the snapshot published by ledmon. The snapshot is used only if it
+ * is owned by root, see run_file_open().
+ */
+#define TOPOLOGY_SNAPSHOT_FILE	LEDMON_RUN_DIR "/topology"
+
+/**
+ * Kinds of devices listed in the manifest.
+ */
+enum topology_kind {
+	TOPOLOGY_KIND_CNTRL,
+	TOPOLOGY_KIND_ENCLOSURE,
+	TOPOLOGY_KIND_BLOCK,
+};
+
+/**
+ * @brief Loads the manifest.
+ *
+ * @param[in]    path            - path to the manifest file.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t topology_load(const char *path);
+
+/**
+ * @brief Releases the manifest.
+ *
+ * @return The function does not return a value.
+ */
+void topology_fini(void);
+
+/**
+ * @brief Checks if the manifest is trusted in current scan.
+ *
+ * @return 1 if the manifest is trusted, otherwise 0.
+ */
+int topology_trusted(void);
+
+/**
+ * @brief Starts a scan.
+ *
+ * The validating scan makes all controllers taken from the manifest due, so
+ * they are discovered again. It has to be called after cadence_begin().
+ *
+ * @return The function does not return a value.
+ */
+void topology_scan_begin(void);
+
+/**
+ * @brief Ends a scan.
+ *
+ * The trusting scan is followed by the validating one. At the end of the
+ * validating scan the manifest is released.
+ *
+ * @return The function does not return a value.
+ */
+void topology_scan_end(void);
+
+/**
+ * @brief Creates controller device described by the manifest.
+ *
+ * @param[in]    path            - canonical sysfs path to PCI function.
+ *
+ * @return Pointer to controller device or NULL if the function is not listed.
+ */
+struct cntrl_device *topology_cntrl(const char *path);
+
+/**
+ * @brief Creates enclosure device described by the manifest.
+ *
+ * @param[in]    path            - canonical sysfs path to the enclosure.
+ *
+ * @return Pointer to enclosure device or NULL if the enclosure is not listed
+ *         or its SCSI generic device does not match sysfs.
+ */
+struct enclosure_device *topology_enclosure(const char *path);
+
+/**
+ * @brief Calls the function for each device of given kind.
+ *
+ * The function does nothing if the manifest is not trusted.
+ *
+ * @param[in]    kind            - kind of devices.
+ * @param[in]    fn              - function called with path to the device.
+ *
+ * @return The function does not return a value.
+ */
+void topology_for_each(enum topology_kind kind, void (*fn)(const char *path));
+
+/**
+ * @brief Checks block device against the snapshot.
+ *
+ * @param[in]    device          - block device initialized from sysfs.
+ *
+ * The phy and the slot have to be confirmed by sysfs as well.
+ *
+ * @return 1 if the device is listed with the same controller, host, phy and
+ *         slot, otherwise 0.
+ */
+int topology_block_valid(const struct block_device *device);
+
+/**
+ * @brief Checks whether the loaded snapshot has not been replaced.
+ *
+ * @return 1 if TOPOLOGY_SNAPSHOT_FILE still has the generation of the loaded
+ *         snapshot, otherwise 0.
+ */
+int topology_snapshot_current(void);
+
+/**
+ * @brief Gets slot mapping of block device from the manifest.
+ *
+ * @param[in]    path            - canonical sysfs path to block device.
+ * @param[out]   encl_index      - index of enclosure slot.
+ *
+ * @return 1 if the manifest is trusted and the device is listed, otherwise 0.
+ */
+int topology_slot(const char *path, int *encl_index);
+
+/**
+ * @brief Compares discovered controller with the manifest.
+ *
+ * @param[in]    path            - canonical sysfs path to PCI function.
+ * @param[in]    device          - discovered controller or NULL.
+ *
+ * @return The function does not return a value.
+ */
+void topology_check_cntrl(const char *path, const struct cntrl_device *device);
+
+/**
+ * @brief Compares discovered enclosure with the manifest.
+ *
+ * @param[in]    device          - discovered enclosure.
+ *
+ * @return The function does not return a value.
+ */
+void topology_check_enclosure(const struct enclosure_device *device);
+
+/**
+ * @brief Compares discovered slot mapping with the manifest.
+ *
+ * @param[in]    path            - canonical sysfs path to block device.
+ * @param[in]    encl_index      - index of enclosure slot.
+ *
+ * @return The function does not return a value.
+ */
+void topology_check_slot(const char *path, int encl_index);
+
+/**
+ * @brief Writes the manifest of devices found by sysfs_scan().
+ *
+ * @param[in]    f               - output stream.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t topology_dump(FILE *f);
+
+/**
+ * @brief Publishes devices found by sysfs_scan() as snapshot.
+ *
+ * The snapshot is written to TOPOLOGY_SNAPSHOT_FILE only if the topology has
+ * changed since the previous call, then its generation is incremented.
+ *
+ * @return STATUS_SUCCESS if successful, otherwise a valid status_t status code.
+ */
+status_t topology_publish(void);
+
+/**
+ * @brief Removes the published snapshot.
+ *
+ * @return The function does not return a value.
+ */
+void topology_unpublish(void);
+
+#endif				/* _TOPOLOGY_H_INCLUDED_ */
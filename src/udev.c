@@ -23,9 +23,12 @@
 #include <string.h>
 
 #include "block.h"
+#include "feed.h"
 #include "ibpi.h"
+#include "probes.h"
 #include "status.h"
 #include "sysfs.h"
+#include "token.h"
 #include "udev.h"
 #include "utils.h"
 
@@ -117,15 +120,17 @@ static int _check_raid(const char *path)
 	return strncmp(t + 1, "md", 2) == 0;
 }
 
+static const struct token udev_action_tokens[] = {
+	TOKEN("add",    UDEV_ACTION_ADD),
+	TOKEN("remove", UDEV_ACTION_REMOVE),
+};
+
 static enum udev_action _get_udev_action(const char *action)
 {
-	enum udev_action ret = UDEV_ACTION_UNKNOWN;
+	int ret = token_find(udev_action_tokens,
+			     TOKEN_COUNT(udev_action_tokens), action);
 
-	if (strncmp(action, "add", 3) == 0)
-		ret = UDEV_ACTION_ADD;
-	else if (strncmp(action, "remove", 6) == 0)
-		ret = UDEV_ACTION_REMOVE;
-	return ret;
+	return ret < 0 ? UDEV_ACTION_UNKNOWN : ret;
 }
 
 static void _clear_raid_dev_info(struct block_device *block, char *raid_dev)
@@ -149,64 +154,67 @@ static void _clear_raid_dev_info(struct block_device *block, char *raid_dev)
 
 }
 
-int handle_udev_event(struct list *ledmon_block_list)
+int handle_udev_action(struct list *ledmon_block_list, const char *action,
+		       const char *syspath)
 {
-	struct udev_device *dev;
-	int status = -1;
+	enum udev_action act = _get_udev_action(action);
+	struct block_device *block = NULL;
 
-	dev = udev_monitor_receive_device(udev_monitor);
-	if (dev) {
-		const char *action = udev_device_get_action(dev);
-		enum udev_action act = _get_udev_action(action);
-		const char *syspath = udev_device_get_syspath(dev);
-		struct block_device *block = NULL;
-
-		if (act == UDEV_ACTION_UNKNOWN) {
-			status = 1;
-			goto exit;
-		}
+	PROBE2(udev_event, action, syspath);
+	if (act == UDEV_ACTION_UNKNOWN)
+		return 1;
 
-		list_for_each(ledmon_block_list, block) {
-			if (_compare(block, syspath))
-				break;
-			block = NULL;
-		}
+	list_for_each(ledmon_block_list, block) {
+		if (_compare(block, syspath))
+			break;
+		block = NULL;
+	}
+
+	if (!block) {
+		if (act == UDEV_ACTION_REMOVE && _check_raid(syspath)) {
+			/*ledmon is interested about removed arrays*/
+			char *dev_name;
 
-		if (!block) {
-			if (act == UDEV_ACTION_REMOVE && _check_raid(syspath)) {
-				/*ledmon is interested about removed arrays*/
-				char *dev_name;
-
-				dev_name = strrchr(syspath, '/') + 1;
-				log_debug("REMOVED %s", dev_name);
-				list_for_each(ledmon_block_list, block)
-					_clear_raid_dev_info(block, dev_name);
-				status = 0;
-				goto exit;
-			}
-			status = 1;
-			goto exit;
+			dev_name = strrchr(syspath, '/') + 1;
+			log_debug("REMOVED %s", dev_name);
+			list_for_each(ledmon_block_list, block)
+				_clear_raid_dev_info(block, dev_name);
+			return 0;
 		}
+		return 1;
+	}
 
-		if (act == UDEV_ACTION_ADD) {
-			log_debug("ADDED %s", block->sysfs_path);
-			if (block->ibpi == IBPI_PATTERN_FAILED_DRIVE ||
-				block->ibpi == IBPI_PATTERN_REMOVED)
-				block->ibpi = IBPI_PATTERN_ADDED;
-		} else if (act == UDEV_ACTION_REMOVE) {
-			log_debug("REMOVED %s", block->sysfs_path);
-			block->ibpi = IBPI_PATTERN_REMOVED;
-		} else {
-			/* not interesting event */
-			status = 1;
-			goto exit;
+	if (act == UDEV_ACTION_ADD) {
+		log_debug("ADDED %s", block->sysfs_path);
+		if (block->ibpi == IBPI_PATTERN_FAILED_DRIVE ||
+			block->ibpi == IBPI_PATTERN_REMOVED) {
+			feed_publish(block->sysfs_path, block->ibpi,
+				     IBPI_PATTERN_ADDED, "udev");
+			block->ibpi = IBPI_PATTERN_ADDED;
 		}
-		status = 0;
+	} else if (act == UDEV_ACTION_REMOVE) {
+		log_debug("REMOVED %s", block->sysfs_path);
+		feed_publish(block->sysfs_path, block->ibpi,
+			     IBPI_PATTERN_REMOVED, "udev");
+		block->ibpi = IBPI_PATTERN_REMOVED;
 	} else {
-		return -1;
+		/* not interesting event */
+		return 1;
 	}
+	return 0;
+}
+
+int handle_udev_event(struct list *ledmon_block_list)
+{
+	struct udev_device *dev;
+	int status;
 
-exit:
+	dev = udev_monitor_receive_device(udev_monitor);
+	if (!dev)
+		return -1;
+	status = handle_udev_action(ledmon_block_list,
+				    udev_device_get_action(dev),
+				    udev_device_get_syspath(dev));
 	udev_device_unref(dev);
 	return status;
 }
@@ -62,4 +62,21 @@ int get_udev_monitor(void);
  */
 int handle_udev_event(struct list *ledmon_block_list);
 
+/**
+ * @brief Handles action of udev event.
+ *
+ *        This function is called by handle_udev_event() for each event
+ *        received from udev monitor.
+ *
+ * @param[in]    ledmon_block_list    list containing block devices, it is
+ *                                    used to match device from udev event.
+ * @param[in]    action               action of the event, e.g. 'remove'.
+ * @param[in]    syspath              sysfs path of the device of the event.
+ *
+ * @return 0 if 'add' or 'remove' event handled successfully;
+ *         1 if registered event is not 'add' or 'remove'.
+ */
+int handle_udev_action(struct list *ledmon_block_list, const char *action,
+		       const char *syspath);
+
 #endif                         /* _UDEV_H_INCLUDED_ */
@@ -123,6 +123,37 @@ int get_int(const char *path, int defval, const char *name)
 	return defval;
 }
 
+/*
+ * Converts a string to an integer within the given range.
+ * See utils.h for details.
+ */
+int str_toi(const char *s, int *value, int min, int max)
+{
+	char *end;
+	long v;
+
+	errno = 0;
+	v = strtol(s, &end, 10);
+	if (end == s || *end || errno || v < min || v > max)
+		return -1;
+	*value = v;
+	return 0;
+}
+
+/*
+ * Splits an entry in format key:value. See utils.h for details.
+ */
+int str_entry(const char *entry, size_t *key_len, int *value, int min,
+	      int max)
+{
+	const char *sep = strrchr(entry, ':');
+
+	if (!sep || sep == entry || str_toi(sep + 1, value, min, max))
+		return -1;
+	*key_len = sep - entry;
+	return 0;
+}
+
 /**
  */
 int scan_dir(const char *path, struct list *result)
@@ -434,6 +465,79 @@ int match_string(const char *string, const char *pattern)
 	return 1;
 }
 
+uint64_t get_monotonic_ms(void)
+{
+	return get_monotonic_us() / 1000;
+}
+
+uint64_t get_monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Creates LEDMON_RUN_DIR.
+ *
+ * @return 0 if the directory is owned by root and only root can write to it,
+ *         otherwise -1.
+ */
+static int _run_dir_create(void)
+{
+	struct stat st;
+
+	if (mkdir(LEDMON_RUN_DIR, 0755) && errno != EEXIST)
+		return -1;
+	if (lstat(LEDMON_RUN_DIR, &st))
+		return -1;
+	if (!S_ISDIR(st.st_mode) || st.st_uid != 0 ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		log_warning("%s is not owned by root, runtime files not used.",
+			    LEDMON_RUN_DIR);
+		errno = EPERM;
+		return -1;
+	}
+	return 0;
+}
+
+int run_file_open(const char *path, int flags)
+{
+	struct stat st;
+	int fd;
+
+	if ((flags & O_CREAT) && _run_dir_create())
+		return -1;
+	fd = open(path, flags | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_uid != 0 ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		log_debug("%s is not owned by root, ignored.", path);
+		close(fd);
+		errno = EPERM;
+		return -1;
+	}
+	return fd;
+}
+
+int run_file_create(const char *path, char *tmp, size_t size)
+{
+	int fd;
+
+	if (_run_dir_create())
+		return -1;
+	if (snprintf(tmp, size, "%s.XXXXXX", path) >= (int)size) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = mkstemp(tmp);
+	if (fd >= 0)
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+}
+
 int get_log_fd(void)
 {
 	if (s_log)
@@ -519,6 +623,11 @@ struct option longopt_all[] = {
 	[OPT_LIST_CTRL]    = {"list-controllers", no_argument, NULL, 'L'},
 	[OPT_LISTED_ONLY]  = {"listed-only", no_argument, NULL, 'x'},
 	[OPT_FOREGROUND]   = {"foreground", no_argument, NULL, '\0'},
+	[OPT_DUMP_TOPOLOGY] = {"dump-topology", no_argument, NULL, '\0'},
+	[OPT_DURATION]     = {"duration", required_argument, NULL, '\0'},
+	[OPT_DRY_RUN]      = {"dry-run", no_argument, NULL, '\0'},
+	[OPT_ONCE]         = {"once", no_argument, NULL, '\0'},
+	[OPT_BENCH]        = {"bench", required_argument, NULL, '\0'},
 	[OPT_NULL_ELEMENT] = {NULL, no_argument, NULL, '\0'}
 };
 
@@ -620,6 +729,50 @@ status_t set_verbose_level(int log_level)
 	return STATUS_CMDLINE_ERROR;
 }
 
+#ifndef _TEST_CONFIG
+const struct token ibpi_tokens[] = {
+	TOKEN("locate",         IBPI_PATTERN_LOCATE),
+	TOKEN("locate_off",     IBPI_PATTERN_LOCATE_OFF),
+	TOKEN("normal",         IBPI_PATTERN_NORMAL),
+	TOKEN("off",            IBPI_PATTERN_NORMAL),
+	TOKEN("ica",            IBPI_PATTERN_DEGRADED),
+	TOKEN("degraded",       IBPI_PATTERN_DEGRADED),
+	TOKEN("rebuild",        IBPI_PATTERN_REBUILD),
+	TOKEN("ifa",            IBPI_PATTERN_FAILED_ARRAY),
+	TOKEN("failed_array",   IBPI_PATTERN_FAILED_ARRAY),
+	TOKEN("hotspare",       IBPI_PATTERN_HOTSPARE),
+	TOKEN("pfa",            IBPI_PATTERN_PFA),
+	TOKEN("failure",        IBPI_PATTERN_FAILED_DRIVE),
+	TOKEN("disk_failed",    IBPI_PATTERN_FAILED_DRIVE),
+	TOKEN("ses_abort",      SES_REQ_ABORT),
+	TOKEN("ses_rebuild",    SES_REQ_REBUILD),
+	TOKEN("ses_ifa",        SES_REQ_IFA),
+	TOKEN("ses_ica",        SES_REQ_ICA),
+	TOKEN("ses_cons_check", SES_REQ_CONS_CHECK),
+	TOKEN("ses_hotspare",   SES_REQ_HOSTSPARE),
+	TOKEN("ses_rsvd_dev",   SES_REQ_RSVD_DEV),
+	TOKEN("ses_ok",         SES_REQ_OK),
+	TOKEN("ses_ident",      SES_REQ_IDENT),
+	TOKEN("ses_rm",         SES_REQ_RM),
+	TOKEN("ses_insert",     SES_REQ_INS),
+	TOKEN("ses_missing",    SES_REQ_MISSING),
+	TOKEN("ses_dnr",        SES_REQ_DNR),
+	TOKEN("ses_active",     SES_REQ_ACTIVE),
+	TOKEN("ses_enable_bb",  SES_REQ_EN_BB),
+	TOKEN("ses_enable_ba",  SES_REQ_EN_BA),
+	TOKEN("ses_devoff",     SES_REQ_DEV_OFF),
+	TOKEN("ses_fault",      SES_REQ_FAULT),
+	TOKEN("ses_prdfail",    SES_REQ_PRDFAIL),
+};
+
+const size_t ibpi_tokens_count = TOKEN_COUNT(ibpi_tokens);
+
+int str2ibpi(const char *name)
+{
+	return token_find(ibpi_tokens, ibpi_tokens_count, name);
+}
+#endif
+
 const char *ibpi2str(enum ibpi_pattern ibpi)
 {
 #ifdef _TEST_CONFIG
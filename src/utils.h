@@ -28,6 +28,7 @@
 #include "status.h"
 #include "syslog.h"
 #include "ibpi.h"
+#include "token.h"
 
 /**
  * Value is intentionally unused.
@@ -46,6 +47,12 @@
  */
 #define WRITE_BUFFER_SIZE   1024
 
+/**
+ * Directory of runtime files shared by ledmon and ledctl. It is owned by root
+ * and only root can write to it, so the files cannot be planted by other users.
+ */
+#define LEDMON_RUN_DIR      "/run/ledmon"
+
 /**
  * This structure describes a device identifier. It consists of major and minor
  * attributes of device.
@@ -94,6 +101,38 @@ extern char *progname;
  */
 int get_int(const char *path, int defval, const char *name);
 
+/**
+ * @brief Converts a string to an integer within the given range.
+ *
+ * Unlike sscanf() the whole string has to be a decimal number, so values like
+ * "10m" are rejected.
+ *
+ * @param[in]      s              string to be converted.
+ * @param[out]     value          converted value, unchanged on error.
+ * @param[in]      min            the lowest acceptable value.
+ * @param[in]      max            the highest acceptable value.
+ *
+ * @return 0 if successful, otherwise -1.
+ */
+int str_toi(const char *s, int *value, int min, int max);
+
+/**
+ * @brief Splits an entry in format key:value.
+ *
+ * The key ends at the last colon, because paths contain colons as well. The
+ * value is converted with str_toi().
+ *
+ * @param[in]      entry          entry to be split.
+ * @param[out]     key_len        length of the key.
+ * @param[out]     value          converted value.
+ * @param[in]      min            the lowest acceptable value.
+ * @param[in]      max            the highest acceptable value.
+ *
+ * @return 0 if successful, otherwise -1.
+ */
+int str_entry(const char *entry, size_t *key_len, int *value, int min,
+	      int max);
+
 /**
  * @brief Reads 64-bit unsigned integer from a text file.
  *
@@ -271,10 +310,27 @@ void log_close(void);
  */
 void _log(enum log_level_enum loglevel, const char *buf, ...);
 
-#define log_error(buf, ...)	_log(LOG_LEVEL_ERROR, buf, ##__VA_ARGS__)
-#define log_debug(buf, ...)	_log(LOG_LEVEL_DEBUG, buf, ##__VA_ARGS__)
-#define log_info(buf, ...)	_log(LOG_LEVEL_INFO, buf, ##__VA_ARGS__)
-#define log_warning(buf, ...)	_log(LOG_LEVEL_WARNING, buf, ##__VA_ARGS__)
+/**
+ * @brief Checks if messages of given level are logged.
+ *
+ * It can be used to skip code which only prepares data for a message.
+ */
+#define log_enabled(loglevel)	(conf.log_level >= (loglevel))
+
+/*
+ * The level is checked at the call site, so arguments of messages which are
+ * not logged are not evaluated.
+ */
+#define _log_at(loglevel, buf, ...) \
+	do { \
+		if (log_enabled(loglevel)) \
+			_log(loglevel, buf, ##__VA_ARGS__); \
+	} while (0)
+
+#define log_error(buf, ...)	_log_at(LOG_LEVEL_ERROR, buf, ##__VA_ARGS__)
+#define log_debug(buf, ...)	_log_at(LOG_LEVEL_DEBUG, buf, ##__VA_ARGS__)
+#define log_info(buf, ...)	_log_at(LOG_LEVEL_INFO, buf, ##__VA_ARGS__)
+#define log_warning(buf, ...)	_log_at(LOG_LEVEL_WARNING, buf, ##__VA_ARGS__)
 /**
  */
 void set_invocation_name(char *invocation_name);
@@ -322,6 +378,49 @@ char *get_path_hostN(const char *path);
 
 int match_string(const char *string, const char *pattern);
 
+/**
+ * @brief Gets the current time of monotonic clock.
+ *
+ * @return Number of milliseconds elapsed since an unspecified starting point.
+ */
+uint64_t get_monotonic_ms(void);
+
+/**
+ * @brief Gets the current time of monotonic clock.
+ *
+ * @return Number of microseconds elapsed since an unspecified starting point.
+ */
+uint64_t get_monotonic_us(void);
+
+/**
+ * @brief Opens a runtime file of ledmon.
+ *
+ * Symbolic links are not followed. A file which is not a regular file owned by
+ * root or which can be written by other users is refused. LEDMON_RUN_DIR is
+ * created if the file is created.
+ *
+ * @param[in]      path           Path to the file.
+ * @param[in]      flags          Flags of open(). The file is created with
+ *                                mode 0600.
+ *
+ * @return File descriptor if successful, otherwise -1 and errno is set.
+ */
+int run_file_open(const char *path, int flags);
+
+/**
+ * @brief Creates a temporary file next to a runtime file of ledmon.
+ *
+ * The file is created with mode 0600 by mkstemp(), so it is written and then
+ * renamed over the runtime file.
+ *
+ * @param[in]      path           Path to the runtime file.
+ * @param[out]     tmp            Buffer for path to the temporary file.
+ * @param[in]      size           Size of the buffer.
+ *
+ * @return File descriptor if successful, otherwise -1 and errno is set.
+ */
+int run_file_create(const char *path, char *tmp, size_t size);
+
 /**
  */
 int get_log_fd(void);
@@ -353,6 +452,11 @@ enum opt {
 	OPT_LIST_CTRL,
 	OPT_LISTED_ONLY,
 	OPT_FOREGROUND,
+	OPT_DUMP_TOPOLOGY,
+	OPT_DURATION,
+	OPT_DRY_RUN,
+	OPT_ONCE,
+	OPT_BENCH,
 	OPT_NULL_ELEMENT
 };
 
@@ -364,4 +468,21 @@ status_t set_verbose_level(int log_level);
 
 const char *ibpi2str(enum ibpi_pattern ibpi);
 
+/**
+ * Pattern names accepted on command line of ledctl.
+ */
+extern const struct token ibpi_tokens[];
+extern const size_t ibpi_tokens_count;
+
+/**
+ * @brief Converts pattern name to IBPI pattern.
+ *
+ * Trailing white spaces and new line characters are ignored.
+ *
+ * @param[in]    name            - name of the pattern, e.g. 'locate'.
+ *
+ * @return IBPI pattern or -1 if the name is unknown.
+ */
+int str2ibpi(const char *name);
+
 #endif				/* _UTILS_H_INCLUDED_ */
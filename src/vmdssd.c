@@ -27,6 +27,8 @@
 #include "config.h"
 #include "list.h"
 #include "pci_slot.h"
+#include "plan.h"
+#include "probes.h"
 #include "status.h"
 #include "sysfs.h"
 #include "utils.h"
@@ -126,6 +128,7 @@ int vmdssd_write(struct block_device *device, enum ibpi_pattern ibpi)
 	char buf[WRITE_BUFFER_SIZE];
 	uint16_t val;
 	struct pci_slot *slot;
+	ssize_t status;
 	char *short_name = strrchr(device->sysfs_path, '/');
 
 	if (short_name)
@@ -133,7 +136,7 @@ int vmdssd_write(struct block_device *device, enum ibpi_pattern ibpi)
 	else
 		short_name = device->sysfs_path;
 
-	if (ibpi == device->ibpi_prev)
+	if (!block_state_changed(device, ibpi))
 		return 0;
 
 	if ((ibpi < IBPI_PATTERN_NORMAL) || (ibpi > IBPI_PATTERN_LOCATE_OFF))
@@ -151,7 +154,17 @@ int vmdssd_write(struct block_device *device, enum ibpi_pattern ibpi)
 	get_ctrl(ibpi, &val);
 	snprintf(buf, WRITE_BUFFER_SIZE, "%u", val);
 	snprintf(attention_path, PATH_MAX, "%s/attention", slot->sysfs_path);
-	if (buf_write(attention_path, buf) != (ssize_t) strlen(buf)) {
+	if (plan_xfer("vmd_attention", attention_path, strlen(buf), 1)) {
+		status = strlen(buf);
+	} else {
+		uint64_t start = get_monotonic_us();
+
+		PROBE2(xfer_start, "vmd_attention", attention_path);
+		status = buf_write(attention_path, buf);
+		PROBE3(xfer_end, "vmd_attention", attention_path, status);
+		plan_stat("vmd_attention", start);
+	}
+	if (status != (ssize_t) strlen(buf)) {
 		log_error("%s write error: %d\n", slot->sysfs_path, errno);
 		return -1;
 	}
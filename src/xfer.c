@@ -0,0 +1,149 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if _HAVE_DMALLOC_H
+#include <dmalloc.h>
+#endif
+
+#include "list.h"
+#include "utils.h"
+#include "xfer.h"
+
+/**
+ * Time in microseconds after which a held gate is considered abandoned.
+ */
+#define XFER_GATE_TIMEOUT	1000000
+
+/**
+ * Time in microseconds to wait for a gate held by other device.
+ */
+#define XFER_GATE_POLL		1000
+
+struct xfer_gate {
+	char *key;
+	char *owner;
+	uint64_t time;
+	void *ctx;
+};
+
+static struct list gates;
+static int gates_ready;
+
+static void _gate_free(struct xfer_gate *gate)
+{
+	free(gate->key);
+	free(gate->owner);
+	free(gate->ctx);
+	free(gate);
+}
+
+static struct xfer_gate *_gate_get(const char *key, size_t ctx_size)
+{
+	struct xfer_gate *gate;
+
+	if (!gates_ready) {
+		list_init(&gates, (item_free_t)_gate_free);
+		gates_ready = 1;
+	}
+	list_for_each(&gates, gate) {
+		if (strcmp(gate->key, key) == 0)
+			return gate;
+	}
+	gate = calloc(1, sizeof(*gate));
+	if (!gate)
+		return NULL;
+	gate->key = str_dup(key);
+	gate->ctx = calloc(1, ctx_size ? ctx_size : 1);
+	if (!gate->key || !gate->ctx) {
+		_gate_free(gate);
+		return NULL;
+	}
+	list_append(&gates, gate);
+	return gate;
+}
+
+void xfer_wait(struct block_device *device, int step, uint64_t time)
+{
+	device->xfer_step = step;
+	device->xfer_time = time ? time : 1;
+}
+
+void xfer_done(struct block_device *device)
+{
+	device->xfer_step = 0;
+	device->xfer_time = 0;
+}
+
+int xfer_pending(const struct block_device *device)
+{
+	return device->xfer_time != 0;
+}
+
+int xfer_flushing(const struct block_device *device)
+{
+	return xfer_pending(device) && (device->xfer_step & XFER_FLUSH);
+}
+
+void *xfer_gate_acquire(const char *key, const char *owner, size_t ctx_size,
+			xfer_abandon_t abandon, uint64_t *busy_until)
+{
+	struct xfer_gate *gate = _gate_get(key, ctx_size);
+	uint64_t now = get_monotonic_us();
+
+	if (!gate) {
+		*busy_until = now + XFER_GATE_POLL;
+		return NULL;
+	}
+	if (gate->owner) {
+		if (strcmp(gate->owner, owner) == 0) {
+			gate->time = now;
+			return gate->ctx;
+		}
+		if (now - gate->time < XFER_GATE_TIMEOUT) {
+			*busy_until = now + XFER_GATE_POLL;
+			return NULL;
+		}
+		log_warning("Transaction of %s abandoned.", gate->owner);
+		if (abandon)
+			abandon(gate->ctx);
+		free(gate->owner);
+		gate->owner = NULL;
+	} else if (gate->time > now) {
+		*busy_until = gate->time;
+		return NULL;
+	}
+	gate->owner = str_dup(owner);
+	gate->time = now;
+	memset(gate->ctx, 0, ctx_size ? ctx_size : 1);
+	return gate->ctx;
+}
+
+void xfer_gate_release(const char *key, unsigned int hold)
+{
+	struct xfer_gate *gate = _gate_get(key, 0);
+
+	if (!gate)
+		return;
+	free(gate->owner);
+	gate->owner = NULL;
+	gate->time = get_monotonic_us() + hold;
+}
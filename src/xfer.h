@@ -0,0 +1,126 @@
+/*
+ * Intel(R) Enclosure LED Utilities
+ * Copyright (C) 2009-2019 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _XFER_H_INCLUDED_
+#define _XFER_H_INCLUDED_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "block.h"
+
+/*
+ * Multi-step hardware transactions.
+ *
+ * A send function which would have to wait between the steps of a
+ * transaction records the next step and the time it may continue with
+ * xfer_wait() and returns 0. The caller invokes the send function again, with
+ * the same device, once the time has come. The transaction is complete when
+ * the send function returns without a pending step, see xfer_pending().
+ * A flush function may leave a step pending the same way; such steps are
+ * marked with XFER_FLUSH and they are continued by the flush function.
+ *
+ * Steps which must not interleave with transactions of other devices, e.g.
+ * because they share controller registers, are serialized with a gate. The
+ * gate is held by a single device and stays closed for the given time after
+ * it has been released, so the hardware can process the last message.
+ */
+
+/**
+ * Flag of steps which are continued by flush function.
+ */
+#define XFER_FLUSH	0x100
+
+/**
+ * @brief Schedules the next step of a transaction.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ * @param[in]    step            - backend specific step to continue with.
+ * @param[in]    time            - time in microseconds of monotonic clock.
+ *
+ * @return The function does not return a value.
+ */
+void xfer_wait(struct block_device *device, int step, uint64_t time);
+
+/**
+ * @brief Marks the transaction of the device as complete.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ *
+ * @return The function does not return a value.
+ */
+void xfer_done(struct block_device *device);
+
+/**
+ * @brief Checks if the transaction of the device waits for the next step.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ *
+ * @return 1 if a step is pending, otherwise 0.
+ */
+int xfer_pending(const struct block_device *device);
+
+/**
+ * @brief Checks if the pending step belongs to flush function.
+ *
+ * @param[in]    device          - pointer to block device structure.
+ *
+ * @return 1 if a flush step is pending, otherwise 0.
+ */
+int xfer_flushing(const struct block_device *device);
+
+/**
+ * @brief Cleans up backend context of a transaction which has been abandoned.
+ */
+typedef void (*xfer_abandon_t)(void *ctx);
+
+/**
+ * @brief Tries to take the gate.
+ *
+ * The gate identified by the key is created on first use together with a
+ * zeroed backend context of the given size; all users of the key have to pass
+ * the same size. The context is cleared whenever the gate changes hands.
+ * The owner which already holds
+ * the gate gets it again. A gate held for more than a second is considered
+ * abandoned, e.g. because its owner has been removed, and it is taken over;
+ * the abandon function cleans up the context left by the previous owner.
+ *
+ * @param[in]    key             - gate identifier, e.g. controller path.
+ * @param[in]    owner           - identifier of the device.
+ * @param[in]    ctx_size        - size of backend context.
+ * @param[in]    abandon         - function called on takeover, may be NULL.
+ * @param[out]   busy_until      - time in microseconds of monotonic clock
+ *                                 when the gate should be tried again.
+ *
+ * @return Backend context if the gate has been taken, otherwise NULL.
+ */
+void *xfer_gate_acquire(const char *key, const char *owner, size_t ctx_size,
+			xfer_abandon_t abandon, uint64_t *busy_until);
+
+/**
+ * @brief Releases the gate.
+ *
+ * @param[in]    key             - gate identifier.
+ * @param[in]    hold            - time in microseconds the gate stays closed.
+ *
+ * @return The function does not return a value.
+ */
+void xfer_gate_release(const char *key, unsigned int hold);
+
+#endif				/* _XFER_H_INCLUDED_ */